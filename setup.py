@@ -74,6 +74,16 @@ if 'linux' in sys.platform:
     else:
         hdf5_extra_link_args = [pkg_config_out]
 
+# OpenMP for the parallel loops in libstfio and libstfnum:
+if os.name == "nt":
+    openmp_compile_args = ["/openmp"]
+    openmp_link_args = []
+elif 'linux' in sys.platform:
+    openmp_compile_args = ["-fopenmp"]
+    openmp_link_args = ["-fopenmp"]
+else:
+    openmp_compile_args = []
+    openmp_link_args = []
 
 if os.name == "nt":
     biosig_define_macros = [('WITH_BIOSIG2', None)]
@@ -166,9 +176,9 @@ stfio_module = Extension(
     define_macros=np_define_macros + biosig_define_macros +
     win_define_macros,
     extra_compile_args=np_extra_compile_args + hdf5_extra_compile_args +
-    win_compile_args,
+    win_compile_args + openmp_compile_args,
     extra_link_args=np_extra_link_args + hdf5_extra_link_args +
-    win_link_args,
+    win_link_args + openmp_link_args,
     include_dirs=win_include_dirs,
     sources=[
         'src/libstfio/abf/abflib.cpp',
@@ -208,7 +218,10 @@ stfio_module = Extension(
 	'src/libstfio/intan/streams.cpp',
         'src/libstfio/recording.cpp',
         'src/libstfio/section.cpp',
+        'src/libstfio/sectionstore.cpp',
+        'src/libstfio/runningaverage.cpp',
         'src/libstfio/stfio.cpp',
+        'src/libstfnum/batch.cpp',
         'src/libstfnum/fit.cpp',
         'src/libstfnum/funclib.cpp',
         'src/libstfnum/levmar/Axb.c',
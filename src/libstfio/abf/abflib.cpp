@@ -18,6 +18,7 @@
 #include <iomanip>
 #include <vector>
 #include <sstream>
+#include <algorithm>
 
 #if !defined(_MSC_VER) || defined(__STF__)
 #include "./axon/Common/axodefn.h"
@@ -43,6 +44,49 @@ std::string stfio::ABF1Error(const std::string& fName, int nError) {
     return std::string( &errorMsg[0] );
 }
 
+// Gap-free recordings with at least this many samples are mapped into
+// memory rather than read:
+static const ABFLONG ABF2_MAP_THRESHOLD = 16*1024*1024;
+
+// Maps the data section of a gap-free ABF2 file. Returns an empty pointer
+// if the file can't be mapped so that it is read conventionally instead.
+static FileMappingPtr mapABF2Data(const std::string& fName, const ABF2FileHeader* pFH) {
+    std::size_t sampleSize = (pFH->nDataFormat == ABF2_INTEGERDATA) ? sizeof(short) : sizeof(float);
+    unsigned long long offset = (unsigned long long)pFH->lDataSectionPtr * ABF2_BLOCKSIZE +
+        (unsigned long long)pFH->nNumPointsIgnored * sampleSize;
+    try {
+        return FileMappingPtr(new FileMapping(fName, offset, (std::size_t)pFH->lActualAcqLength * sampleSize));
+    }
+    catch (const std::runtime_error&) {
+        return FileMappingPtr();
+    }
+}
+
+// Creates a store for one channel of a mapped gap-free ABF2 file, applying
+// the same scaling as ABF2_ReadChannel().
+static SectionStorePtr mapABF2Channel(const FileMappingPtr& mapping, const ABF2FileHeader* pFH,
+                                      int nChannel, std::size_t size)
+{
+    int nADCChannel = pFH->nADCSamplingSeq[nChannel];
+    UINT uChannelOffset = 0;
+    if (!ABF2H_GetChannelOffset(pFH, nADCChannel, &uChannelOffset)) {
+        return SectionStorePtr();
+    }
+    float fScale = 1.0f, fShift = 0.0f;
+    stfio::storagetype type = stfio::float32;
+    if (pFH->nDataFormat == ABF2_INTEGERDATA) {
+        ABF2H_GetADCtoUUFactors(pFH, nADCChannel, &fScale, &fShift);
+        type = stfio::int16;
+    }
+    try {
+        return SectionStorePtr(new MappedSectionStore(mapping, type, uChannelOffset,
+                                                      pFH->nADCNumChannels, size, fScale, fShift));
+    }
+    catch (const std::exception&) {
+        return SectionStorePtr();
+    }
+}
+
 void stfio::importABFFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
     ABF2_FileInfo fileInfo;
 
@@ -107,6 +151,129 @@ void stfio::importABFFile(const std::string &fName, Recording &ReturnData, Progr
 }
 
 
+// Adapters that let readABFEpisodes() handle ABF1 and ABF2 files alike:
+static BOOL ABFGetNumSamples(int hFile, const ABFFileHeader* pFH, DWORD dwEpisode, UINT* puNumSamples, int* pnError) {
+    return ABF_GetNumSamples(hFile, pFH, dwEpisode, puNumSamples, pnError);
+}
+
+static BOOL ABFGetNumSamples(int hFile, const ABF2FileHeader* pFH, DWORD dwEpisode, UINT* puNumSamples, int* pnError) {
+    return ABF2_GetNumSamples(hFile, pFH, dwEpisode, puNumSamples, pnError);
+}
+
+static BOOL ABFMultiplexRead(int hFile, const ABFFileHeader* pFH, DWORD dwEpisode, void* pvBuffer,
+                             UINT uBufferSize, UINT* puSizeInSamples, int* pnError) {
+    return ABF_MultiplexRead(hFile, pFH, dwEpisode, pvBuffer, uBufferSize, puSizeInSamples, pnError);
+}
+
+static BOOL ABFMultiplexRead(int hFile, const ABF2FileHeader* pFH, DWORD dwEpisode, void* pvBuffer,
+                             UINT uBufferSize, UINT* puSizeInSamples, int* pnError) {
+    return ABF2_MultiplexRead(hFile, pFH, dwEpisode, pvBuffer, uBufferSize, puSizeInSamples, pnError);
+}
+
+static void ABFChannelScaling(const ABFFileHeader* pFH, int nADCChannel, UINT* puOffset, float* pfScale, float* pfShift) {
+    ABFH_GetChannelOffset(pFH, nADCChannel, puOffset);
+    ABFH_GetADCtoUUFactors(pFH, nADCChannel, pfScale, pfShift);
+}
+
+static void ABFChannelScaling(const ABF2FileHeader* pFH, int nADCChannel, UINT* puOffset, float* pfScale, float* pfShift) {
+    ABF2H_GetChannelOffset(pFH, nADCChannel, puOffset);
+    ABF2H_GetADCtoUUFactors(pFH, nADCChannel, pfScale, pfShift);
+}
+
+// Reads every episode once and de-interleaves all channels from the same
+// buffer. Reading channel by channel instead would read every episode once
+// per channel because the ABF library only caches a single episode.
+// If concatenate is true, the episodes are chunks of a gap-free recording
+// that are joined into a single section of grandsize data points per channel.
+// Throws std::runtime_error; the caller has to close the file.
+template <class FileHeader>
+static void readABFEpisodes(int hFile, const FileHeader* pFH, const std::string& fName,
+                            ABFLONG numberSections, bool concatenate, std::size_t grandsize,
+                            Recording& ReturnData, stfio::ProgressInfo& progDlg)
+{
+    int numberChannels = pFH->nADCNumChannels;
+    // ABF_INTEGERDATA and ABF2_INTEGERDATA are both 0:
+    bool integerData = (pFH->nDataFormat == ABF2_INTEGERDATA);
+    std::size_t sampleSize = integerData ? sizeof(short) : sizeof(float);
+    std::vector<char> episode(pFH->lNumSamplesPerEpisode * sampleSize);
+
+    std::vector<SampleLayout> layouts(numberChannels);
+    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+        UINT uOffset = 0;
+        float fScale = 1.0f, fShift = 0.0f;
+        ABFChannelScaling(pFH, pFH->nADCSamplingSeq[nChannel], &uOffset, &fScale, &fShift);
+        layouts[nChannel].type = integerData ? stfio::int16 : stfio::float32;
+        layouts[nChannel].first = &episode[0] + uOffset * sampleSize;
+        layouts[nChannel].stride = numberChannels;
+        layouts[nChannel].scale = integerData ? fScale : 1.0;
+        layouts[nChannel].shift = integerData ? fShift : 0.0;
+
+        ReturnData[nChannel].resize(concatenate ? 1 : numberSections);
+        if (concatenate) {
+            std::ostringstream label;
+            label << fName << ", gapfree section";
+            ReturnData[nChannel][0].resize(grandsize);
+            ReturnData[nChannel][0].SetSectionDescription(label.str());
+        }
+    }
+
+    std::size_t nStored = 0;
+    std::size_t position = 0;
+    for (DWORD dwEpisode=1; dwEpisode <= (DWORD)numberSections; ++dwEpisode) {
+        std::ostringstream progStr;
+        progStr << "Reading section #" << dwEpisode << " of " << numberSections;
+        progDlg.Update((int)((double)(dwEpisode-1)/(double)numberSections*100.0), progStr.str());
+
+        int nError = 0;
+        UINT uNumSamples = 0;
+        if (!concatenate && !ABFGetNumSamples(hFile, pFH, dwEpisode, &uNumSamples, &nError)) {
+            std::ostringstream errorMsg;
+            errorMsg << "Exception while calling ABF_GetNumSamples() "
+                     << "for episode # " << dwEpisode << "\n"
+                     << stfio::ABF1Error(fName, nError);
+            throw std::runtime_error(errorMsg.str());
+        }
+        UINT uSizeInSamples = 0;
+        if (!ABFMultiplexRead(hFile, pFH, dwEpisode, &episode[0], (UINT)pFH->lNumSamplesPerEpisode,
+                              &uSizeInSamples, &nError))
+        {
+            std::string errorMsg("Exception while calling ABF_MultiplexRead():\n");
+            errorMsg += stfio::ABF1Error(fName, nError);
+            throw std::runtime_error(errorMsg);
+        }
+        std::size_t nSamples = std::min<std::size_t>(uSizeInSamples, pFH->lNumSamplesPerEpisode) / numberChannels;
+
+        if (concatenate) {
+            // clip the last chunk to the size of the section:
+            std::size_t nCopy = (position < grandsize) ? std::min(nSamples, grandsize-position) : 0;
+            for (int nChannel=0; nChannel < numberChannels && nCopy > 0; ++nChannel) {
+                stfio::ConvertSamples(layouts[nChannel], 0, nCopy,
+                                      &ReturnData[nChannel][0].get_w()[position]);
+            }
+            position += nSamples;
+        } else if (uNumSamples > 0) {
+            if (nSamples != uNumSamples) {
+                throw std::runtime_error("Exception while calling ABF_MultiplexRead()");
+            }
+            std::ostringstream label;
+            label << fName << ", Section # " << dwEpisode;
+            for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                Section& sec = ReturnData[nChannel][nStored];
+                sec.resize(nSamples);
+                sec.SetSectionDescription(label.str());
+                stfio::ConvertSamples(layouts[nChannel], 0, nSamples, &sec.get_w()[0]);
+            }
+            ++nStored;
+        }
+    }
+    if (!concatenate) {
+        // episodes without samples are dropped:
+        for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+            ReturnData[nChannel].resize(nStored);
+        }
+    }
+}
+
 void stfio::importABF2File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
 
     CABF2ProtocolReader abf2;
@@ -152,7 +319,6 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
     
     int numberChannels = pFH->nADCNumChannels;
     ABFLONG numberSections = pFH->lActualEpisodes;
-    ABFLONG finalSections = numberSections;
     int hFile = abf2.GetFileNumber();
     bool gapfree = (pFH->nOperationMode == ABF2_GAPFREEFILE);
     if (gapfree) {
@@ -165,144 +331,66 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
             ABF_Close(hFile,&nError);
             throw std::runtime_error(errorMsg.str());
         }
-        finalSections = 1;
     }
-    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
-        int progbar = (int)(((double)nChannel/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Memory allocation");
-        ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
-        std::ostringstream label;
-        label  
-               << fName
-               << ", gapfree section";
-        if (gapfree) {
-            grandsize = pFH->lActualAcqLength / numberChannels;
-            Vector_double test_size(0);
-            ABFLONG maxsize = test_size.max_size()
+    ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+    if (gapfree) {
+        grandsize = pFH->lActualAcqLength / numberChannels;
+        Vector_double test_size(0);
+        ABFLONG maxsize = test_size.max_size()
 #if defined(_MSC_VER)
-                // doesn't seem to return the correct size on Windows.
-                ;
+            // doesn't seem to return the correct size on Windows.
+            ;
 #else
-                ;
+            ;
 #endif
             
-            if (grandsize <= 0 || grandsize >= maxsize) {
-                    
-                progDlg.Update(progbar, "Gapfree file is too large for a single section." \
-                               "It will be segmented.\nFile opening may be very slow.");
+        if (grandsize <= 0 || grandsize >= maxsize) {
                 
-                gapfree=false;
-                grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
-                finalSections=numberSections;
-            }
-        }
-        Channel TempChannel(finalSections, grandsize);
-        Section TempSectionGrand(grandsize, label.str());
-        for (int nEpisode=1; nEpisode<=numberSections;++nEpisode) {
-            int progbar =
-                // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(nEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << nEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
+            progDlg.Update(0, "Gapfree file is too large for a single section." \
+                           "It will be segmented.\nFile opening may be very slow.");
             
-            UINT uNumSamples = 0;
-            if (gapfree) {
-                if (nEpisode == numberSections) {
-                    uNumSamples = grandsize - (nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels;
-#ifdef _STFDEBUG
-                    std::cout << "Last section size " << uNumSamples << std::endl;
-#endif
-                } else {
-                    uNumSamples = pFH->lNumSamplesPerEpisode / numberChannels;
-                }
-            } else {
-                if (!ABF2_GetNumSamples(hFile, pFH, nEpisode, &uNumSamples, &nError)) {
-                    std::ostringstream errorMsg;
-                    errorMsg << "Exception while calling ABF2_GetNumSamples() "
-                             << "for episode # "
-                             << nEpisode << "\n"
-                             << ABF1Error(fName, nError);
-                    ReturnData.resize(0);
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg.str());
-                }
-            }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            if (uNumSamples > 0) {
-                Vector_float TempSection(uNumSamples, 0.0);
-                unsigned int uNumSamplesW;
-                if (!ABF2_ReadChannel(hFile, pFH, pFH->nADCSamplingSeq[nChannel],nEpisode,TempSection,
-                                      &uNumSamplesW,&nError))
-                {
-                    std::string errorMsg("Exception while calling ABF2_ReadChannel():\n");
-                    errorMsg += ABF1Error(fName, nError);
-                    ReturnData.resize(0);
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg);
-                }
-                if (uNumSamples!=uNumSamplesW && !gapfree) {
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error("Exception while calling ABF2_ReadChannel()");
-                }
-                if (!gapfree) {
-                    std::ostringstream label;
-                    label
-                        << fName
-                        << ", Section # " << nEpisode;
-                    Section TempSectionT(TempSection.size(),label.str());
-                    std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-                    try {
-                        TempChannel.InsertSection(TempSectionT,nEpisode-1);
-                    }
-                    catch (...) {
-                        ABF_Close(hFile,&nError);
-                        throw;
-                    }
-                } else {
-                    if ((nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels + TempSection.size() <= TempSectionGrand.size()) {
-                        std::copy(TempSection.begin(),TempSection.end(),
-                                  &TempSectionGrand[(nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels]);
-                    }
-    #ifdef _STFDEBUG
-                    else {
-                        std::cout << "Overflow while copying gapfree sections" << std::endl;
-                    }
-    #endif
-                }
-            } else {
-                TempChannel.resize(TempChannel.size()-1);
-            }
+            gapfree=false;
+            grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
         }
-        if (gapfree) {
-            try {
-                TempChannel.InsertSection(TempSectionGrand,0);
-            }
-            catch (...) {
-                ABF_Close(hFile,&nError);
-                throw;
+    }
+    if ((int)ReturnData.size()<numberChannels) {
+        ReturnData.resize(numberChannels);
+    }
+
+    // Large gap-free files are mapped so that opening takes constant time
+    // and recordings larger than memory can be displayed:
+    std::vector<SectionStorePtr> stores;
+    if (gapfree && pFH->lActualAcqLength >= ABF2_MAP_THRESHOLD) {
+        FileMappingPtr mapping = mapABF2Data(fName, pFH);
+        for (int nChannel=0; nChannel < numberChannels && mapping; ++nChannel) {
+            SectionStorePtr store = mapABF2Channel(mapping, pFH, nChannel, grandsize);
+            if (!store) {
+                stores.clear();
+                break;
             }
+            stores.push_back(store);
         }
-        try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
+    }
+    try {
+        if (!stores.empty()) {
+            std::ostringstream label;
+            label << fName << ", gapfree section";
+            for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                ReturnData[nChannel].resize(1);
+                ReturnData[nChannel][0] = Section(stores[nChannel], label.str());
             }
-            ReturnData.InsertChannel(TempChannel,nChannel);
+        } else {
+            readABFEpisodes(hFile, pFH, fName, numberSections, gapfree, grandsize,
+                            ReturnData, progDlg);
         }
-        catch (...) {
-            ReturnData.resize(0);
-            ABF_Close(hFile,&nError);
-            throw;
-        }
-        
-        progbar = (int)(((double)(nChannel+1)/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Completing channel reading\n");
+    }
+    catch (...) {
+        ReturnData.resize(0);
+        ABF_Close(hFile,&nError);
+        throw;
+    }
 
+    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
         std::string channel_name( pFH->sADCChannelName[pFH->nADCSamplingSeq[nChannel]] );
         if (channel_name.find("  ")<channel_name.size()) {
             channel_name.erase(channel_name.begin()+channel_name.find("  "),channel_name.end());
@@ -315,6 +403,7 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
         }
         ReturnData[nChannel].SetYUnits(channel_units);
     }
+    progDlg.Update(100, "Completing channel reading\n");
 
     if (!ABF_Close(hFile,&nError)) {
         std::string errorMsg("Exception in importABFFile():\n");
@@ -387,70 +476,18 @@ void stfio::importABF1File(const std::string &fName, Recording &ReturnData, Prog
         throw std::runtime_error("Error while calling stfio::importABFFile():\n"
             "lActualEpisodes>dwMaxEpi");
     }
+    if ((int)ReturnData.size()<numberChannels) {
+        ReturnData.resize(numberChannels);
+    }
+    try {
+        readABFEpisodes(hFile, &FH, fName, numberSections, false, 0, ReturnData, progDlg);
+    }
+    catch (...) {
+        ReturnData.resize(0);
+        ABF_Close(hFile,&nError);
+        throw;
+    }
     for (int nChannel=0;nChannel<numberChannels;++nChannel) {
-        Channel TempChannel(numberSections);
-        for (DWORD dwEpisode=1;dwEpisode<=(DWORD)numberSections;++dwEpisode) {
-            int progbar = // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(dwEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << dwEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
-            
-            unsigned int uNumSamples=0;
-            if (!ABF_GetNumSamples(hFile,&FH,dwEpisode,&uNumSamples,&nError)) {
-                std::string errorMsg( "Exception while calling ABF_GetNumSamples():\n" );
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            Vector_float TempSection(uNumSamples, 0.0);
-            unsigned int uNumSamplesW=0;
-            if (!ABF_ReadChannel(hFile, &FH, FH.nADCSamplingSeq[nChannel], dwEpisode, TempSection,
-                                 &uNumSamplesW, &nError))
-            {
-                std::string errorMsg("Exception while calling ABF_ReadChannel():\n");
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            if (uNumSamples!=uNumSamplesW) {
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error("Exception while calling ABF_ReadChannel()");
-            }
-            std::ostringstream label;
-            label
-                << fName
-                << ", Section # " << dwEpisode;
-            Section TempSectionT(TempSection.size(),label.str());
-            std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-            try {
-                TempChannel.InsertSection(TempSectionT,dwEpisode-1);
-            }
-            catch (...) {
-                ABF_Close(hFile,&nError);
-                throw;
-            }
-        }
-        try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
-            }
-            ReturnData.InsertChannel(TempChannel,nChannel);
-        }
-        catch (...) {
-            ReturnData.resize(0);
-            ABF_Close(hFile,&nError);
-            throw;
-        }
-
         std::string channel_name( FH.sADCChannelName[FH.nADCSamplingSeq[nChannel]] );
         if (channel_name.find("  ")<channel_name.size()) {
             channel_name.erase(channel_name.begin()+channel_name.find("  "),channel_name.end());
@@ -78,15 +78,6 @@ BOOL GetNewFileDescriptor(CFileDescriptor **ppFI, int *pnFile, int *pnError)
     //   WPTRASSERT(pnFile);
     int nFile;
    
-    // Find an empty slot.
-    for (nFile=0; nFile < ABF_MAXFILES; nFile++)
-        if (g_FileData[nFile] == NULL)
-            break;
-   
-    // Return an error if no space left.   
-    if (nFile == ABF_MAXFILES)
-        return ErrorReturn(pnError, ABF_TOOMANYFILESOPEN);
-
     // Allocate a new descriptor.
     CFileDescriptor *pFI = new CFileDescriptor;
     if (pFI == NULL)
@@ -98,7 +89,27 @@ BOOL GetNewFileDescriptor(CFileDescriptor **ppFI, int *pnFile, int *pnError)
         return ErrorReturn(pnError, ABF_BADTEMPFILE);
     }
       
-    *ppFI = g_FileData[nFile] = pFI;
+    // Find an empty slot and take it, guarded so that several files
+    // can be opened from different threads (see stfio::importFiles).
+#ifdef _OPENMP
+#pragma omp critical (abf_file_table)
+#endif
+    {
+        for (nFile=0; nFile < ABF_MAXFILES; nFile++)
+            if (g_FileData[nFile] == NULL)
+                break;
+        if (nFile < ABF_MAXFILES)
+            g_FileData[nFile] = pFI;
+    }
+   
+    // Return an error if no space left.   
+    if (nFile == ABF_MAXFILES)
+    {
+        delete pFI;
+        return ErrorReturn(pnError, ABF_TOOMANYFILESOPEN);
+    }
+
+    *ppFI = pFI;
     *pnFile = nFile;
     return TRUE;
 }
@@ -131,8 +142,12 @@ BOOL GetFileDescriptor(CFileDescriptor **ppFI, int nFile, int *pnError)
 //
 void ReleaseFileDescriptor(int nFile)
 {
-    delete g_FileData[nFile];
+    CFileDescriptor *pFI = g_FileData[nFile];
+#ifdef _OPENMP
+#pragma omp critical (abf_file_table)
+#endif
     g_FileData[nFile] = NULL;
+    delete pFI;
 }
 
 //===============================================================================================
@@ -611,7 +611,9 @@ int getsBuf(ATF_FILEINFO *pATF, LPSTR pszString, DWORD dwBufSize)
 #if defined(_MSC_VER)
             if (!ReadFile(pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL))
 #else
-            if (!c_ReadFile((FILE*)pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL))
+            // Unlike ReadFile, c_ReadFile fails on the short read at the end of the file:
+            if (!c_ReadFile((FILE*)pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL) &&
+                ferror((FILE*)pATF->hFile))
 #endif
                 return GETS_ERROR;
 
@@ -117,26 +117,27 @@ void stf::importASCIIFile( const wxString& fName, int hLinesToSkip, int nColumns
     ReturnRec.resize(n_ch);
     std::vector<Channel> TempChannel(n_ch,Channel(n_sec));
     for (int n_insert=0;n_insert<nColumns-int(firstIsTime);++n_insert) {
-        Section TempSection(tempVec[n_insert].size());
-        std::copy(tempVec[n_insert].begin(),tempVec[n_insert].end(),&TempSection[0]);
+        // Take over the column instead of copying it:
+        Section TempSection;
+        TempSection.get_w().swap(tempVec[n_insert]);
         try {
             if (toSection) {
                 std::ostringstream label;
                 label << stf::noPath(fName) << ", Section # " << n_insert+1;
                 TempSection.SetSectionDescription(label.str());
-                TempChannel[0].InsertSection(TempSection,n_insert);
+                TempChannel[0].AdoptSection(TempSection,n_insert);
             } else {
                 std::ostringstream label;
                 label << fName << ", Section # 1";
                 TempSection.SetSectionDescription(label.str());
-                TempChannel[n_insert].InsertSection(TempSection,0);
+                TempChannel[n_insert].AdoptSection(TempSection,0);
             }
         }
         catch (...) {throw;}
     }
     for (std::size_t n_ch=0;n_ch<TempChannel.size();++n_ch) {
         try {
-            ReturnRec.InsertChannel(TempChannel[n_ch],n_ch);
+            ReturnRec.AdoptChannel(TempChannel[n_ch],n_ch);
         }
         catch (...) {throw;}
     }
@@ -14,6 +14,12 @@
 
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#if (__cplusplus >= 201703L) && defined(__has_include)
+  #if __has_include(<charconv>)
+    #include <charconv>
+  #endif
+#endif
 
 #include "./atflib.h"
 #include "../recording.h"
@@ -22,6 +28,42 @@ namespace stfio {
     std::string ATFError(const std::string& fName, int nError);
 }
 
+// Same size as the line buffer of the ATF library, so that any line that the
+// library accepts fits:
+static int ATFLineSize(int nColumns) {
+    int nSize = nColumns*50;
+    return (nSize < 1024 ? 1024 : nSize) + 1;
+}
+
+// Parses the next number from a data line, following the rules of the ATF
+// library: leading and trailing spaces are skipped, a token ends at white space
+// or a delimiter, one delimiter is consumed and missing numbers read as 0.
+// The line is null-terminated after the token. Returns the position of the
+// next token.
+static char* ATFNextNumber(char* ps, double& val) {
+    while (*ps==' ')
+        ++ps;
+    char* psStart = ps;
+    while (*ps && *ps!='\t' && *ps!='\r' && *ps!='\n' && *ps!=' ' && *ps!=',')
+        ++ps;
+    char* psEnd = ps;
+    while (*ps==' ')
+        ++ps;
+    if (*ps && *ps!='\r' && *ps!='\n')
+        *ps++ = '\0';
+    else
+        *ps = '\0';
+    *psEnd = '\0';
+
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result res = std::from_chars(psStart, psEnd, val);
+    if (res.ec == std::errc() && res.ptr == psEnd)
+        return ps;
+#endif
+    val = atof(psStart);
+    return ps;
+}
+
 std::string stfio::ATFError(const std::string& fName, int nError) {
     int nMaxLen=320;
     std::vector<char> errorMsg(nMaxLen);
@@ -159,52 +201,57 @@ void stfio::importATFFile(const std::string &fName, Recording &ReturnData, Progr
         timeInFirstColumn=1;
     }
     ReturnData.resize(1);
-    Channel TempChannel(nColumns-timeInFirstColumn);
-    for (int n_c=timeInFirstColumn;n_c<nColumns;++n_c) {
-        int progbar = (double)100.0*(n_c+1-timeInFirstColumn)/(double)(nColumns-timeInFirstColumn);
-
-        std::ostringstream progStr;
-        progStr << "Section #" << n_c+1-timeInFirstColumn << " of " << nColumns-timeInFirstColumn;
-        progDlg.Update(progbar, progStr.str());
+    int nSections = nColumns-timeInFirstColumn;
+    Channel TempChannel(nSections, sectionSize);
+    for (int n_s=0;n_s<nSections;++n_s) {
         std::ostringstream label;
         label
             << fName 
-            << ", Section # " << n_c-timeInFirstColumn+1;
-        Section TempSection(sectionSize,label.str());
-        for (int n_l=0;n_l<sectionSize;++n_l) {
-            if (!ATF_ReadDataColumn(nFileNum,n_c,&TempSection[n_l],&nError)) {
-                std::string errorMsg("Exception while calling ATF_ReadDataColumn():\n");
-                errorMsg+=ATFError(fName,nError);
-                ReturnData.resize(0);
-                throw std::runtime_error(errorMsg);
-            }
-        }
-        if (n_c-timeInFirstColumn==0) {
+            << ", Section # " << n_s+1;
+        TempChannel[n_s].SetSectionDescription(label.str());
+        if (n_s==0) {
             std::vector<char> unitsVec(nMaxText);
-            if (!ATF_GetColumnUnits(nFileNum,n_c,&unitsVec[0],nMaxText,&nError)) {
+            if (!ATF_GetColumnUnits(nFileNum,n_s+timeInFirstColumn,&unitsVec[0],nMaxText,&nError)) {
                 std::string errorMsg("Exception while calling ATF_GetColumnUnits():\n");
                 errorMsg+=ATFError(fName,nError);
                 ReturnData.resize(0);
                 throw std::runtime_error(errorMsg);
             }
-            ReturnData[0].SetYUnits(std::string(&unitsVec[0]));
-        }
-        try {
-            TempChannel.InsertSection(TempSection,n_c-timeInFirstColumn);
+            TempChannel.SetYUnits(std::string(&unitsVec[0]));
         }
-        catch (...) {
-            throw;
+    }
+
+    // Read the data in a single pass, filling all sections from each line:
+    std::vector<double*> columns(nSections);
+    for (int n_s=0;n_s<nSections;++n_s) {
+        columns[n_s] = sectionSize > 0 ? &TempChannel[n_s].get_w()[0] : NULL;
+    }
+    std::vector<char> lineVec(ATFLineSize(nColumns));
+    int nProgressStep = sectionSize/100 > 0 ? sectionSize/100 : 1;
+    for (long n_l=0;n_l<sectionSize;++n_l) {
+        if (n_l % nProgressStep == 0) {
+            int progbar = (int)(100.0*n_l/(double)sectionSize);
+            std::ostringstream progStr;
+            progStr << "Line #" << n_l+1 << " of " << sectionSize;
+            progDlg.Update(progbar, progStr.str());
         }
-        // Rewind file before reading next column:
-        if (!ATF_RewindFile(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_RewindFile():\n");
+        if (!ATF_ReadDataRecord(nFileNum,&lineVec[0],(int)lineVec.size(),&nError)) {
+            std::string errorMsg("Exception while calling ATF_ReadDataRecord():\n");
             errorMsg+=ATFError(fName,nError);
             ReturnData.resize(0);
             throw std::runtime_error(errorMsg);
         }
+        char* ps = &lineVec[0];
+        double val = 0.0;
+        if (timeInFirstColumn) {
+            ps = ATFNextNumber(ps, val);
+        }
+        for (int n_s=0;n_s<nSections;++n_s) {
+            ps = ATFNextNumber(ps, columns[n_s][n_l]);
+        }
     }
     try {
-        ReturnData.InsertChannel(TempChannel,0);
+        ReturnData.AdoptChannel(TempChannel,0);
     }
     catch (...) {
         ReturnData.resize(0);
@@ -84,7 +84,7 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
     //	AG_ReadFloatColumn reads column data into a float column structure.
     int numberOfChannels = 0;
 
-    std::vector< Section > section_list;
+    std::deque< Section > section_list;
     std::vector< std::string > channel_names;
     std::vector< std::string > channel_units;
     double xscale = 1.0;
@@ -115,8 +115,10 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
         if ( columnNumber == 0 ) {
             xscale = column.seriesArray.increment * 1.0e3;
         } else {
-            section_list.push_back( Section(column.points, column.title ) );
+            // Build the section in place instead of copying it into the list:
+            section_list.resize( section_list.size()+1 );
             std::size_t last = section_list.size()-1;
+            Section( column.points, column.title ).swap( section_list[last] );
 
             if (column.points<1) {
                 throw std::out_of_range("number of points too small");
@@ -165,10 +167,10 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
         }
         for (std::size_t n_s=n_c; (int)n_s < numberOfColumns-1; n_s += numberOfChannels) {
             if (factor != 1.0) {
-                section_list[n_s].get_w() = stfio::vec_scal_mul(section_list[n_s].get(), factor);
+                stfio::vec_affine(section_list[n_s].get_w(), factor, 0.0);
             }
             try {
-                TempChannel.InsertSection( section_list[n_s], (n_s-n_c)/numberOfChannels );
+                TempChannel.AdoptSection( section_list[n_s], (n_s-n_c)/numberOfChannels );
             }
             catch (...) {
                 ReturnData.resize(0);
@@ -182,7 +184,7 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
             if ((int)ReturnData.size()<numberOfChannels) {
                 ReturnData.resize(numberOfChannels);
             }
-            ReturnData.InsertChannel(TempChannel,n_c);
+            ReturnData.AdoptChannel(TempChannel,n_c);
         }
         catch (...) {
             ReturnData.resize(0);
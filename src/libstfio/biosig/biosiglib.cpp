@@ -203,7 +203,7 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
 			    TempSection.get_w().begin() );
 
             try {
-                TempChannel.InsertSection(TempSection, ns-1);
+                TempChannel.AdoptSection(TempSection, ns-1);
             }
             catch (...) {
                 ReturnData.resize(0);
@@ -214,7 +214,7 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
         try {
             if ((int)ReturnData.size() < numberOfChannels)
                 ReturnData.resize(numberOfChannels);
-            ReturnData.InsertChannel(TempChannel, NS++);
+            ReturnData.AdoptChannel(TempChannel, NS++);
         }
         catch (...) {
             ReturnData.resize(0);
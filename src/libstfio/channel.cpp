@@ -12,6 +12,8 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <utility>
+
 #include "./stfio.h"
 #include "./channel.h"
 
@@ -31,18 +33,39 @@ Channel::Channel(std::size_t c_n_sections, std::size_t section_size)
 : name("\0"), yunits( "\0" ),
 SectionArray(c_n_sections, Section(section_size)) {}
 
+#if (__cplusplus >= 201103)
+Channel::Channel(std::deque<Section>&& SectionList)
+: name("\0"), yunits( "\0" ),
+SectionArray(std::move(SectionList)) {}
+#endif
+
 Channel::~Channel(void) {}
 
 void Channel::InsertSection(const Section& c_Section, std::size_t pos) {
-    try {
-        if (SectionArray.at(pos).size() != c_Section.size()) {
-            SectionArray.at(pos).resize(c_Section.size());
-        }
-        SectionArray.at(pos) = c_Section;
-    }
-    catch (...) {
-        throw;
-    }
+    // no resizing beforehand: that would copy stored sections into memory
+    SectionArray.at(pos) = c_Section;
+}
+
+#if (__cplusplus >= 201103)
+void Channel::InsertSection(Section&& c_Section, std::size_t pos) {
+    SectionArray.at(pos) = std::move(c_Section);
+}
+#endif
+
+void Channel::AdoptSection(Section& c_Section, std::size_t pos) {
+    SectionArray.at(pos).swap(c_Section);
+}
+
+Section& Channel::EmplaceSection(std::size_t pos, std::size_t size, const std::string& label) {
+    Section& sec = SectionArray.at(pos);
+    Section(size, label).swap(sec);
+    return sec;
+}
+
+void Channel::swap(Channel& other) {
+    name.swap(other.name);
+    yunits.swap(other.yunits);
+    SectionArray.swap(other.SectionArray);
 }
 
 const Section& Channel::at(std::size_t at_) const {
@@ -67,4 +90,13 @@ Section& Channel::at(std::size_t at_) {
 
 void Channel::resize(std::size_t newSize) { SectionArray.resize(newSize); }
 
+void Channel::SetStorage(stfio::storagetype type) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int n_s=0; n_s < (int)SectionArray.size(); ++n_s) {
+        SectionArray[n_s].SetStorage(type);
+    }
+}
+
 void Channel::reserve(std::size_t resSize) { /* SectionArray.reserve(resSize); */ }
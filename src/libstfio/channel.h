@@ -54,6 +54,25 @@ public:
      */
     explicit Channel(std::size_t c_n_sections, std::size_t section_size = 0);
     
+#if (__cplusplus >= 201103)
+    //! Constructor that takes over the sections without copying them.
+    /*! \param SectionList A vector of Sections from which to construct the channel
+     */
+    explicit Channel(std::deque<Section>&& SectionList);
+
+    //! Copy constructor.
+    Channel(const Channel&) = default;
+
+    //! Move constructor. Takes over the sections without copying them.
+    Channel(Channel&&) = default;
+
+    //! Copy assignment.
+    Channel& operator=(const Channel&) = default;
+
+    //! Move assignment. Takes over the sections without copying them.
+    Channel& operator=(Channel&&) = default;
+#endif
+
     //! Destructor
     ~Channel();
 
@@ -127,6 +146,12 @@ public:
      */
     void SetYUnits( const std::string& value ) { yunits = value; }
 
+    //! Changes the type in which the data points of all sections are held.
+    /*! See Section::SetStorage().
+     *  \param type The new storage type.
+     */
+    void SetStorage(stfio::storagetype type);
+
     //misc--------------------------------------------------------
     
     //! Inserts a section at the given position, overwriting anything that's currently stored at that position
@@ -138,6 +163,40 @@ public:
      */
     void InsertSection(const Section& c_Section, std::size_t pos);
 
+#if (__cplusplus >= 201103)
+    //! Moves a section to the given position, overwriting anything that's currently stored at that position
+    /*! Same as InsertSection(const Section&, std::size_t), but the data points aren't copied.
+     *  \param c_Section The section to be inserted.
+     *  \param pos The position at which to insert the section.
+     */
+    void InsertSection(Section&& c_Section, std::size_t pos);
+#endif
+
+    //! Moves a section to the given position without copying its data points.
+    /*! Like InsertSection(), but \e c_Section is exchanged with the section
+     *  that is currently stored at \e pos, which is usually empty. Importers
+     *  use this so that each data point is held in memory only once.
+     *  Will throw std::out_of_range if out of range.
+     *  \param c_Section On entry, the section to be inserted. On exit, the
+     *         section that was previously stored at \e pos.
+     *  \param pos The position at which to insert the section.
+     */
+    void AdoptSection(Section& c_Section, std::size_t pos);
+
+    //! Replaces the section at the given position with a new one that can be filled in place.
+    /*! Will throw std::out_of_range if out of range.
+     *  \param pos The position of the section.
+     *  \param size Number of data points of the new section.
+     *  \param label An optional section label string.
+     *  \return The new section.
+     */
+    Section& EmplaceSection(std::size_t pos, std::size_t size, const std::string& label="\0");
+
+    //! Exchanges the contents with another channel without copying the sections.
+    /*! \param other The other channel.
+     */
+    void swap(Channel& other);
+
     //! Resize the section array.
     /*! \param newSize The new number of sections.
      */
@@ -21,6 +21,12 @@
 #include <cmath>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <set>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
 
 #include "./hdf5lib.h"
 #include "../recording.h"
@@ -45,9 +51,546 @@ typedef struct st {
     char yunits[UNITLEN];
 } st;
 
-bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg) {
-    
+// Maximal number of samples in a chunk of the hdf5_channels layout:
+const static hsize_t CHUNKLEN = 65536;
+
+// Files of the hdf5_channels layout that are larger than this number of
+// bytes are read section by section when the data points are accessed:
+const static hsize_t HDF5_LAZY_THRESHOLD = 64*1024*1024;
+
+#ifdef _OPENMP
+// The HDF5 library is usually built without thread safety. Sections of
+// lazily opened files may be read from any thread, so that all calls into
+// the library are serialized by a single lock. The lock is nestable because
+// the importers call each other and read sections while holding it.
+class HDF5Lock {
+public:
+    HDF5Lock() { omp_init_nest_lock(&lock); }
+    ~HDF5Lock() { omp_destroy_nest_lock(&lock); }
+    omp_nest_lock_t lock;
+};
+
+static HDF5Lock hdf5Lock;
+#endif
+
+stfio::HDF5Guard::HDF5Guard() {
+#ifdef _OPENMP
+    omp_set_nest_lock(&hdf5Lock.lock);
+#endif
+}
+
+stfio::HDF5Guard::~HDF5Guard() {
+#ifdef _OPENMP
+    // Thread-safe builds of the library keep one error stack per thread.
+    // Errors left on the stack of a worker thread that makes no further
+    // calls keep the library from closing at exit.
+    H5Eclear2(H5E_DEFAULT);
+    omp_unset_nest_lock(&hdf5Lock.lock);
+#endif
+}
+
+// Names of the files that are open for sections to read from; accessed
+// while holding the HDF5 lock:
+static std::multiset<std::string> openFiles;
+
+// A file of the hdf5_channels layout that stays open for as long as
+// sections read from it. The data sets are opened on first access.
+class HDF5File {
+public:
+    explicit HDF5File(const std::string& fName_)
+        : fName(fName_), file_id(-1), data_sets()
+    {
+        stfio::HDF5Guard guard;
+        file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file_id < 0) {
+            throw std::runtime_error("Couldn't open " + fName + " in stfio::openHDF5File");
+        }
+        openFiles.insert(fName);
+    }
+
+    ~HDF5File() {
+        stfio::HDF5Guard guard;
+        for (std::size_t n_c = 0; n_c < data_sets.size(); ++n_c) {
+            if (data_sets[n_c] >= 0) H5Dclose(data_sets[n_c]);
+        }
+        H5Fclose(file_id);
+        openFiles.erase(openFiles.find(fName));
+    }
+
+    // Reads n samples starting at begin from a row of the data set of a channel.
+    void ReadSamples(std::size_t n_c, std::size_t n_s, std::size_t begin, std::size_t n,
+                     float* out) const
+    {
+        if (n == 0) {
+            return;
+        }
+        stfio::HDF5Guard guard;
+        hid_t data_set = DataSet(n_c);
+        hsize_t offset[2] = { n_s, begin };
+        hsize_t count[2] = { 1, n };
+        hsize_t mem_dims = n;
+        hid_t file_space = H5Dget_space(data_set);
+        hid_t mem_space = H5Screate_simple(1, &mem_dims, NULL);
+        herr_t status = (file_space < 0 || mem_space < 0) ? -1 :
+            H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset, NULL, count, NULL);
+        if (status >= 0) {
+            status = H5Dread(data_set, H5T_NATIVE_FLOAT, mem_space, file_space, H5P_DEFAULT, out);
+        }
+        H5Sclose(mem_space);
+        H5Sclose(file_space);
+        if (status < 0) {
+            throw std::runtime_error("Exception while reading data in stfio::openHDF5File");
+        }
+    }
+
+private:
+    HDF5File(const HDF5File&);
+    HDF5File& operator=(const HDF5File&);
+
+    hid_t DataSet(std::size_t n_c) const {
+        if (n_c >= data_sets.size()) {
+            data_sets.resize(n_c+1, -1);
+        }
+        if (data_sets[n_c] < 0) {
+            std::ostringstream data_path;
+            data_path << "/ch" << n_c << "/data";
+            data_sets[n_c] = H5Dopen2(file_id, data_path.str().c_str(), H5P_DEFAULT);
+            if (data_sets[n_c] < 0) {
+                throw std::runtime_error("Exception while opening " + data_path.str() +
+                                         " in stfio::openHDF5File");
+            }
+        }
+        return data_sets[n_c];
+    }
+
+    std::string fName;
+    hid_t file_id;
+    mutable std::vector<hid_t> data_sets;
+};
+
+bool stfio::isHDF5FileOpen(const std::string& fName) {
+    stfio::HDF5Guard guard;
+    return openFiles.count(fName) > 0;
+}
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<const HDF5File> HDF5FilePtr;
+#else
+typedef std::shared_ptr<const HDF5File> HDF5FilePtr;
+#endif
+
+// Data points of one section that are read from an open file on demand.
+// Blocks are read directly from the file. Random access and the sample
+// layout need the whole section, which is then read once and cached.
+class HDF5SectionStore : public SectionStore {
+public:
+    HDF5SectionStore(const HDF5FilePtr& file_, std::size_t channel_, std::size_t section_,
+                     std::size_t n)
+        : file(file_), channel(channel_), section(section_), n_points(n),
+          cache(), loaded(false)
+    {}
+
+    virtual std::size_t size() const { return n_points; }
+
+    virtual double at(std::size_t at) const {
+        Load();
+        return cache[at];
+    }
+
+    virtual void Read(std::size_t begin, std::size_t n, double* out) const {
+        if (IsLoaded()) {
+            std::copy(cache.begin()+begin, cache.begin()+begin+n, out);
+            return;
+        }
+        Vector_float samples(n);
+        file->ReadSamples(channel, section, begin, n, samples.empty() ? NULL : &samples[0]);
+        std::copy(samples.begin(), samples.end(), out);
+    }
+
+    virtual SampleLayout Layout() const {
+        Load();
+        SampleLayout layout = { stfio::float32, cache.empty() ? NULL : (const char*)&cache[0],
+                                1, 1.0, 0.0 };
+        return layout;
+    }
+
+private:
+    bool IsLoaded() const {
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+        return loaded;
+    }
+
+    // Reads the whole section unless it's already cached.
+    void Load() const {
+        if (IsLoaded()) {
+            return;
+        }
+        stfio::HDF5Guard guard;
+        if (!loaded) {
+            Vector_float samples(n_points);
+            file->ReadSamples(channel, section, 0, n_points, samples.empty() ? NULL : &samples[0]);
+            cache.swap(samples);
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+            loaded = true;
+        }
+    }
+
+    HDF5FilePtr file;
+    std::size_t channel, section, n_points;
+    mutable Vector_float cache;
+    mutable bool loaded;
+};
+
+// Closes the file before throwing.
+static void hdf5Error(hid_t file_id, const std::string& errorMsg) {
+    H5Fclose(file_id);
+    throw std::runtime_error(errorMsg);
+}
+
+static void setStringAttribute(hid_t file_id, const std::string& path, const char* name,
+                               const std::string& value)
+{
+    if (H5LTset_attribute_string(file_id, path.c_str(), name, value.c_str()) < 0) {
+        hdf5Error(file_id, std::string("Exception while writing attribute ") + name +
+                  " in stfio::exportHDF5File");
+    }
+}
+
+static std::string getStringAttribute(hid_t file_id, const std::string& path, const char* name) {
+    hsize_t dims = 0;
+    H5T_class_t class_id;
+    size_t type_size = 0;
+    if (H5LTget_attribute_info(file_id, path.c_str(), name, &dims, &class_id, &type_size) < 0) {
+        hdf5Error(file_id, std::string("Exception while reading attribute ") + name +
+                  " in stfio::importHDF5File");
+    }
+    std::vector<char> value(type_size+1, 0);
+    if (H5LTget_attribute_string(file_id, path.c_str(), name, &value[0]) < 0) {
+        hdf5Error(file_id, std::string("Exception while reading attribute ") + name +
+                  " in stfio::importHDF5File");
+    }
+    return std::string(&value[0]);
+}
+
+// Section descriptions are stored as fixed-length strings next to the
+// section sizes:
+static herr_t writeDescriptions(hid_t channel_group, const Channel& channel) {
+    std::size_t len = 1;
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        len = std::max(len, channel[n_s].GetSectionDescription().size());
+    }
+    std::vector<char> descriptions(channel.size()*len, '\0');
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        const std::string& desc = channel[n_s].GetSectionDescription();
+        std::copy(desc.begin(), desc.end(), descriptions.begin()+n_s*len);
+    }
+    hid_t string_type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(string_type, len);
+    H5Tset_strpad(string_type, H5T_STR_NULLPAD);
+    hsize_t dims[1] = { channel.size() };
+    hid_t desc_space = H5Screate_simple(1, dims, NULL);
+    hid_t desc_set = H5Dcreate2(channel_group, "descriptions", string_type, desc_space,
+                                H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = desc_set < 0 ? -1 :
+        H5Dwrite(desc_set, string_type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                 descriptions.empty() ? NULL : &descriptions[0]);
+    H5Dclose(desc_set);
+    H5Sclose(desc_space);
+    H5Tclose(string_type);
+    return status;
+}
+
+// Files written before the descriptions were stored get "secN":
+static herr_t readDescriptions(hid_t channel_group, std::vector<std::string>& descriptions) {
+    if (H5Lexists(channel_group, "descriptions", H5P_DEFAULT) <= 0) {
+        for (std::size_t n_s=0; n_s < descriptions.size(); ++n_s) {
+            std::ostringstream section_name;
+            section_name << "sec" << n_s;
+            descriptions[n_s] = section_name.str();
+        }
+        return 0;
+    }
+    hid_t desc_set = H5Dopen2(channel_group, "descriptions", H5P_DEFAULT);
+    if (desc_set < 0) {
+        return -1;
+    }
+    hid_t desc_space = H5Dget_space(desc_set);
+    hid_t file_type = H5Dget_type(desc_set);
+    std::size_t len = file_type < 0 ? 0 : H5Tget_size(file_type);
+    herr_t status = -1;
+    if (len > 0 && desc_space >= 0 &&
+        H5Sget_simple_extent_npoints(desc_space) == (hssize_t)descriptions.size())
+    {
+        hid_t string_type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(string_type, len);
+        H5Tset_strpad(string_type, H5T_STR_NULLPAD);
+        std::vector<char> buffer(descriptions.size()*len);
+        status = H5Dread(desc_set, string_type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                         buffer.empty() ? NULL : &buffer[0]);
+        H5Tclose(string_type);
+        for (std::size_t n_s=0; status >= 0 && n_s < descriptions.size(); ++n_s) {
+            const char* desc = &buffer[n_s*len];
+            descriptions[n_s] = std::string(desc, std::find(desc, desc+len, '\0'));
+        }
+    }
+    H5Tclose(file_type);
+    H5Sclose(desc_space);
+    H5Dclose(desc_set);
+    return status;
+}
+
+static void exportHDF5Channels(hid_t file_id, const Recording& WData, stfio::ProgressInfo& progDlg,
+                               int compression)
+{
+    int channels = WData.size();
+    double dt = WData.GetXScale();
+    int layout = stfio::hdf5_channels;
+    struct tm t = WData.GetDateTime();
+    char date[DATELEN], time[TIMELEN];
+    snprintf(date, DATELEN, "%04i-%02i-%02i", t.tm_year+1900, t.tm_mon+1, t.tm_mday);
+    snprintf(time, TIMELEN, "%02i:%02i:%02i", t.tm_hour, t.tm_min, t.tm_sec);
+    if (H5LTset_attribute_int(file_id, "/", "layout", &layout, 1) < 0 ||
+        H5LTset_attribute_int(file_id, "/", "channels", &channels, 1) < 0 ||
+        H5LTset_attribute_double(file_id, "/", "dt", &dt, 1) < 0)
+    {
+        hdf5Error(file_id, "Exception while writing description in stfio::exportHDF5File");
+    }
+    setStringAttribute(file_id, "/", "date", date);
+    setStringAttribute(file_id, "/", "time", time);
+    setStringAttribute(file_id, "/", "xunits", WData.GetXUnits());
+    setStringAttribute(file_id, "/", "description", WData.GetFileDescription());
+    setStringAttribute(file_id, "/", "comment", WData.GetComment());
+
+    bool deflate = compression > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0;
+
+    for (std::size_t n_c=0; n_c < WData.size(); ++n_c) {
+        const Channel& channel = WData[n_c];
+        std::ostringstream channel_path; channel_path << "/ch" << n_c;
+        hid_t channel_group = H5Gcreate2( file_id, channel_path.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (channel_group < 0) {
+            hdf5Error(file_id, "Exception while creating channel group for " + channel_path.str());
+        }
+        int n_sections = channel.size();
+        if (H5LTset_attribute_int(file_id, channel_path.str().c_str(), "sections", &n_sections, 1) < 0) {
+            hdf5Error(file_id, "Exception while writing channel description in stfio::exportHDF5File");
+        }
+        setStringAttribute(file_id, channel_path.str(), "name", channel.GetChannelName());
+        setStringAttribute(file_id, channel_path.str(), "yunits", channel.GetYUnits());
+
+        // Sections of different length are padded; their lengths are
+        // stored in an index.
+        std::vector<unsigned long long> sizes(channel.size());
+        hsize_t max_size = 0;
+        for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+            sizes[n_s] = channel[n_s].size();
+            max_size = std::max<hsize_t>(max_size, sizes[n_s]);
+        }
+        hsize_t sdims[1] = { sizes.size() };
+        hid_t sizes_space = H5Screate_simple(1, sdims, NULL);
+        hid_t sizes_set = H5Dcreate2(channel_group, "sizes", H5T_STD_U64LE, sizes_space,
+                                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        herr_t status = sizes_set < 0 ? -1 :
+            H5Dwrite(sizes_set, H5T_NATIVE_ULLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                     sizes.empty() ? NULL : &sizes[0]);
+        H5Dclose(sizes_set);
+        H5Sclose(sizes_space);
+        if (status < 0) {
+            hdf5Error(file_id, "Exception while writing section sizes in stfio::exportHDF5File");
+        }
+        if (writeDescriptions(channel_group, channel) < 0) {
+            hdf5Error(file_id, "Exception while writing section descriptions in stfio::exportHDF5File");
+        }
+
+        // One chunk holds up to CHUNKLEN samples of a single section, so
+        // that sections can be read without decompressing their neighbours.
+        hsize_t dims[2] = { channel.size(), max_size };
+        hid_t data_space = H5Screate_simple(2, dims, NULL);
+        hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+        if (dims[0] > 0 && dims[1] > 0) {
+            hsize_t chunk[2] = { 1, std::min(max_size, CHUNKLEN) };
+            H5Pset_chunk(plist, 2, chunk);
+            if (deflate) {
+                H5Pset_shuffle(plist);
+                H5Pset_deflate(plist, std::min(compression, 9));
+            }
+        }
+        hid_t data_set = H5Dcreate2(channel_group, "data", H5T_IEEE_F32LE, data_space,
+                                    H5P_DEFAULT, plist, H5P_DEFAULT);
+        H5Pclose(plist);
+        if (data_set < 0) {
+            H5Sclose(data_space);
+            hdf5Error(file_id, "Exception while creating data in stfio::exportHDF5File");
+        }
+
+        Vector_double buffer;
+        Vector_float data_cp; /* 32 bit */
+        for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+            int progbar =
+                // Channel contribution:
+                (int)(((double)n_c/(double)WData.size())*100.0+
+                      // Section contribution:
+                      (double)(n_s)/(double)channel.size()*(100.0/WData.size()));
+            std::ostringstream progStr;
+            progStr << "Writing channel #" << n_c + 1 << " of " << WData.size()
+                    << ", Section #" << n_s << " of " << channel.size();
+            progDlg.Update(progbar, progStr.str());
+
+            const Section& sec = channel[n_s];
+            if (sec.size() == 0) {
+                continue;
+            }
+            buffer.resize(sec.size());
+            sec.Read(0, sec.size(), &buffer[0]);
+            data_cp.resize(sec.size());
+            std::copy(buffer.begin(), buffer.end(), data_cp.begin());
+
+            hsize_t start[2] = { n_s, 0 }, count[2] = { 1, sec.size() };
+            H5Sselect_hyperslab(data_space, H5S_SELECT_SET, start, NULL, count, NULL);
+            hid_t mem_space = H5Screate_simple(2, count, NULL);
+            status = H5Dwrite(data_set, H5T_NATIVE_FLOAT, mem_space, data_space, H5P_DEFAULT, &data_cp[0]);
+            H5Sclose(mem_space);
+            if (status < 0) {
+                H5Dclose(data_set);
+                H5Sclose(data_space);
+                hdf5Error(file_id, "Exception while writing data in stfio::exportHDF5File");
+            }
+        }
+        H5Dclose(data_set);
+        H5Sclose(data_space);
+        H5Gclose(channel_group);
+    }
+}
+
+// Reads the sections from lazyFile on demand if it is set.
+static void importHDF5Channels(hid_t file_id, Recording& ReturnData, stfio::ProgressInfo& progDlg,
+                               const HDF5FilePtr& lazyFile)
+{
+    int layout = 0, numberChannels = 0;
+    double dt = 1.0;
+    if (H5LTget_attribute_int(file_id, "/", "layout", &layout) < 0 || layout != stfio::hdf5_channels) {
+        hdf5Error(file_id, "Unsupported layout in stfio::importHDF5File");
+    }
+    if (H5LTget_attribute_int(file_id, "/", "channels", &numberChannels) < 0 ||
+        H5LTget_attribute_double(file_id, "/", "dt", &dt) < 0)
+    {
+        hdf5Error(file_id, "Exception while reading description in stfio::importHDF5File");
+    }
+    std::string date = getStringAttribute(file_id, "/", "date");
+    std::string time = getStringAttribute(file_id, "/", "time");
+    if ( ReturnData.SetDate(date) || ReturnData.SetTime(time) ) {
+        std::cout << "Warning HDF5: could not decode date/time " << date << " " << time << std::endl;
+    }
+    ReturnData.SetFileDescription(getStringAttribute(file_id, "/", "description"));
+    ReturnData.SetComment(getStringAttribute(file_id, "/", "comment"));
+    std::string xunits = getStringAttribute(file_id, "/", "xunits");
+
+    ReturnData.resize(numberChannels);
+    for (int n_c=0; n_c < numberChannels; ++n_c) {
+        std::ostringstream progStr;
+        progStr << "Reading channel #" << n_c + 1 << " of " << numberChannels;
+        progDlg.Update((int)(100.0*n_c/numberChannels), progStr.str());
+
+        std::ostringstream channel_path; channel_path << "/ch" << n_c;
+        int n_sections = 0;
+        if (H5LTget_attribute_int(file_id, channel_path.str().c_str(), "sections", &n_sections) < 0) {
+            hdf5Error(file_id, "Exception while reading channel description in stfio::importHDF5File");
+        }
+        hid_t channel_group = H5Gopen2(file_id, channel_path.str().c_str(), H5P_DEFAULT );
+
+        std::vector<unsigned long long> sizes(n_sections);
+        hid_t sizes_set = H5Dopen2(channel_group, "sizes", H5P_DEFAULT);
+        herr_t status = sizes_set < 0 ? -1 :
+            H5Dread(sizes_set, H5T_NATIVE_ULLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                    sizes.empty() ? NULL : &sizes[0]);
+        H5Dclose(sizes_set);
+        if (status < 0) {
+            H5Gclose(channel_group);
+            hdf5Error(file_id, "Exception while reading section sizes in stfio::importHDF5File");
+        }
+        std::vector<std::string> descriptions(n_sections);
+        if (readDescriptions(channel_group, descriptions) < 0) {
+            H5Gclose(channel_group);
+            hdf5Error(file_id, "Exception while reading section descriptions in stfio::importHDF5File");
+        }
+
+        hid_t data_set = H5Dopen2(channel_group, "data", H5P_DEFAULT);
+        hid_t data_space = data_set < 0 ? -1 : H5Dget_space(data_set);
+        hsize_t dims[2] = { 0, 0 };
+        if (data_space < 0 || H5Sget_simple_extent_dims(data_space, dims, NULL) != 2 ||
+            dims[0] != sizes.size())
+        {
+            if (data_space >= 0) {
+                H5Sclose(data_space);
+            }
+            H5Dclose(data_set);
+            H5Gclose(channel_group);
+            hdf5Error(file_id, "Exception while reading data information in stfio::importHDF5File");
+        }
+
+        Channel TempChannel(n_sections);
+        TempChannel.SetChannelName(getStringAttribute(file_id, channel_path.str(), "name"));
+        TempChannel.SetYUnits(getStringAttribute(file_id, channel_path.str(), "yunits"));
+        for (int n_s=0; n_s < n_sections; ++n_s) {
+            if (sizes[n_s] > dims[1]) {
+                H5Sclose(data_space);
+                H5Dclose(data_set);
+                H5Gclose(channel_group);
+                hdf5Error(file_id, "Section size out of range in stfio::importHDF5File");
+            }
+            if (lazyFile) {
+                SectionStorePtr store(new HDF5SectionStore(lazyFile, n_c, n_s, sizes[n_s]));
+                TempChannel.InsertSection(Section(store, descriptions[n_s]), n_s);
+                continue;
+            }
+            // Only read the samples of each section, not the padding behind them:
+            Vector_double& section = TempChannel.EmplaceSection(n_s, sizes[n_s], descriptions[n_s]).get_w();
+            if (section.empty()) {
+                continue;
+            }
+            hsize_t start[2] = { (hsize_t)n_s, 0 }, count[2] = { 1, section.size() };
+            H5Sselect_hyperslab(data_space, H5S_SELECT_SET, start, NULL, count, NULL);
+            hid_t mem_space = H5Screate_simple(2, count, NULL);
+            status = H5Dread(data_set, H5T_NATIVE_DOUBLE, mem_space, data_space, H5P_DEFAULT, &section[0]);
+            H5Sclose(mem_space);
+            if (status < 0) {
+                H5Sclose(data_space);
+                H5Dclose(data_set);
+                H5Gclose(channel_group);
+                hdf5Error(file_id, "Exception while reading data in stfio::importHDF5File");
+            }
+        }
+        H5Sclose(data_space);
+        H5Dclose(data_set);
+        H5Gclose(channel_group);
+        ReturnData.AdoptChannel(TempChannel, n_c);
+    }
+    ReturnData.SetXScale(dt);
+    ReturnData.SetXUnits(xunits);
+}
+
+bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, stfio::ProgressInfo& progDlg,
+                           hdf5_layout layout, int compression) {
+    stfio::HDF5Guard guard;
+    if (isHDF5FileOpen(fName)) {
+        throw std::runtime_error("Can't overwrite " + fName + " while sections are still read from it"
+                                 " in stfio::exportHDF5File");
+    }
     hid_t file_id = H5Fcreate(fName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0) {
+        throw std::runtime_error("Couldn't create " + fName + " in stfio::exportHDF5File");
+    }
+
+    if (layout == hdf5_channels) {
+        exportHDF5Channels(file_id, WData, progDlg, compression);
+        if (H5Fclose(file_id) < 0) {
+            throw std::runtime_error("Exception while closing file in stfio::exportHDF5File");
+        }
+        return true;
+    }
     
     const int NRECORDS = 1;
     const int NFIELDS = 3;
@@ -85,11 +628,12 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     
     herr_t status = H5TBmake_table( desc.str().c_str(), file_id, "description", (hsize_t)NFIELDS, (hsize_t)NRECORDS, sizeof(rt),
                                     field_names, rt_offset, field_type, 10, NULL, 0, &p_data  );
+    H5Tclose(string_type1);
+    H5Tclose(string_type2);
 
     if (status < 0) {
         std::string errorMsg("Exception while writing description in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
 
@@ -105,7 +649,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     if (status < 0) {
         std::string errorMsg("Exception while writing description in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
 
@@ -118,7 +661,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     if (status < 0) {
         std::string errorMsg("Exception while writing comment in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
     H5Gclose(comment_group);
@@ -145,10 +687,10 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         std::copy(channel_name[n_c].begin(),channel_name[n_c].end(), datac.begin());
         std::ostringstream desc_path; desc_path << "/channels/ch" << (n_c);
         status = H5LTmake_dataset(file_id, desc_path.str().c_str(), 1, dimsc, string_typec, &datac[0]);
+        H5Tclose(string_typec);
         if (status < 0) {
             std::string errorMsg("Exception while writing channel name in stfio::exportHDF5File");
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg);
         }
 
@@ -159,7 +701,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             errorMsg << "Exception while creating channel group for "
                      << channel_path.str().c_str();
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg.str());
         }
 
@@ -179,7 +720,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         if (status < 0) {
             std::string errorMsg("Exception while writing channel description in stfio::exportHDF5File");
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg);
         }
 
@@ -232,7 +772,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             if (status < 0) {
                 std::string errorMsg("Exception while writing data in stfio::exportHDF5File");
                 H5Fclose(file_id);
-                H5close();
                 throw std::runtime_error(errorMsg);
             }
 
@@ -273,10 +812,11 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             sdesc << "Description of " << section_name.str();
             status = H5TBmake_table( sdesc.str().c_str(), section_group, "description", (hsize_t)NSFIELDS, (hsize_t)NSRECORDS, st_size,
                                      sfield_names, st_offset, sfield_type, 10, NULL, 0, &s_data  );
+            H5Tclose(string_type4);
+            H5Tclose(string_type5);
             if (status < 0) {
                 std::string errorMsg("Exception while writing section description in stfio::exportHDF5File");
                 H5Fclose(file_id);
-                H5close();
                 throw std::runtime_error(errorMsg);
             }
             H5Gclose(section_group);
@@ -292,19 +832,48 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         throw std::runtime_error(errorMsg);
     }
 
-    /* Release all hdf5 resources */
-    status = H5close();
-    if (status < 0) {
-        std::string errorMsg("Exception while closing file in stfio::exportHDF5File");
-        throw std::runtime_error(errorMsg);
-    }
     
     return (status >= 0);
 }
 
+void stfio::openHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
+    stfio::HDF5Guard guard;
+    hid_t file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        throw std::runtime_error("Couldn't open " + fName + " in stfio::openHDF5File");
+    }
+    if (H5Aexists(file_id, "layout") <= 0) {
+        // Sections of the hdf5_sections layout are read at once:
+        H5Fclose(file_id);
+        importHDF5File(fName, ReturnData, progDlg);
+        return;
+    }
+    importHDF5Channels(file_id, ReturnData, progDlg, HDF5FilePtr(new HDF5File(fName)));
+    if (H5Fclose(file_id) < 0) {
+        throw std::runtime_error("Exception while closing file in stfio::openHDF5File");
+    }
+}
+
 void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
+    stfio::HDF5Guard guard;
     /* Create a new file using default properties. */
     hid_t file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        throw std::runtime_error("Couldn't open " + fName + " in stfio::importHDF5File");
+    }
+
+    if (H5Aexists(file_id, "layout") > 0) {
+        hsize_t file_size = 0;
+        HDF5FilePtr lazyFile;
+        if (H5Fget_filesize(file_id, &file_size) >= 0 && file_size >= HDF5_LAZY_THRESHOLD) {
+            lazyFile.reset(new HDF5File(fName));
+        }
+        importHDF5Channels(file_id, ReturnData, progDlg, lazyFile);
+        if (H5Fclose(file_id) < 0) {
+            throw std::runtime_error("Exception while closing file in stfio::importHDF5File");
+        }
+        return;
+    }
     
     /* H5TBread_table
        const int NRECORDS = 1;*/
@@ -365,6 +934,7 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
         }
     }
     ReturnData.SetComment(comment);
+    H5Gclose(group_id);
 
     double dt = 1.0;
     std::string yunits = "";
@@ -390,6 +960,7 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
         std::vector<char> szchannel_name(ctype_size);
         // szchannel_name.reset( new char[ctype_size] );
         status = H5LTread_dataset(file_id, desc_path.str().c_str(), string_typec, &szchannel_name[0] );
+        H5Tclose(string_typec);
         if (status < 0) {
             std::string errorMsg("Exception while reading channel name in stfio::importHDF5File");
             throw std::runtime_error(errorMsg);
@@ -461,17 +1032,9 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
                 throw std::runtime_error(errorMsg);
             }
 
-            Section TempSectionT(TempSection.size(), section_name.str());
-            for (std::size_t cp = 0; cp < TempSectionT.size(); ++cp) {
-                TempSectionT[cp] = double(TempSection[cp]);
-            }
-            // std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-            try {
-                TempChannel.InsertSection(TempSectionT,n_s);
-            }
-            catch (...) {
-                throw;
-            }
+            Vector_double& TempSectionT =
+                TempChannel.EmplaceSection(n_s, TempSection.size(), section_name.str()).get_w();
+            std::copy(TempSection.begin(),TempSection.end(),TempSectionT.begin());
 
 
             /* H5TBread_table
@@ -499,7 +1062,7 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
             if ((int)ReturnData.size()<numberChannels) {
                 ReturnData.resize(numberChannels);
             }
-            ReturnData.InsertChannel(TempChannel,n_c);
+            ReturnData.AdoptChannel(TempChannel,n_c);
             ReturnData[n_c].SetYUnits( yunits );
         }
         catch (...) {
@@ -516,12 +1079,6 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
         throw std::runtime_error(errorMsg);
     }
 
-    /* Release all hdf5 resources */
-    status = H5close();
-    if (status < 0) {
-        std::string errorMsg("Exception while closing file in stfio::exportHDF5File");
-        throw std::runtime_error(errorMsg);
-    }
     
 }
 
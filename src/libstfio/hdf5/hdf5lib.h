@@ -26,20 +26,81 @@ class Recording;
 
 namespace stfio {
 
+//! Holds a lock on the HDF5 library for as long as it exists.
+/*! The HDF5 library is usually built without thread safety, so that
+ *  libstfio serializes its calls into the library. Code that calls the
+ *  library directly while files may be read from other threads, e.g.
+ *  to write results, has to hold a guard. Guards can be nested.
+ */
+class StfioDll HDF5Guard {
+public:
+    //! Waits for and takes the lock.
+    HDF5Guard();
+    //! Clears the HDF5 error stack of the calling thread and releases the lock.
+    ~HDF5Guard();
+private:
+    HDF5Guard(const HDF5Guard&);
+    HDF5Guard& operator=(const HDF5Guard&);
+};
+
+//! Layouts of the data in HDF5 files.
+enum hdf5_layout {
+    hdf5_sections = 1, /*!< A group with a dataset and a description table per section. */
+    hdf5_channels = 2  /*!< A 2-D dataset (sections x samples) per channel, metadata in attributes. */
+};
+
 //! Open a HDF5 file and store its contents to a Recording object.
-/*! \param fName Full path to the file to be read.
+/*! Files of either stfio::hdf5_layout can be read. Files of the
+ *  stfio::hdf5_channels layout that are larger than 64 MB are opened
+ *  as with openHDF5File().
+ *  \param fName Full path to the file to be read.
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
  */
 void importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
 
+//! Open a HDF5 file without reading its data points.
+/*! For the stfio::hdf5_channels layout, only the metadata and the section
+ *  sizes are read; the sections of \e ReturnData keep the file open and
+ *  read the data points through hyperslab selections when they are
+ *  accessed. Section::Read() only reads the requested block, while Section::get()
+ *  reads the whole section. Files of the stfio::hdf5_sections layout are
+ *  read at once as with importHDF5File().
+ *  \param fName Full path to the file to be read.
+ *  \param ReturnData On entry, an empty Recording object. On exit,
+ *         the channels and sections stored in \e fName.
+ *  \param progress True if the progress dialog should be updated.
+ */
+StfioDll void openHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+
+//! Indicates whether sections still read from a file.
+/*! Large files are kept open by the sections read from them (see
+ *  openHDF5File()) until all of these sections have been copied into
+ *  memory with Section::get() or destroyed. Such a file can't be
+ *  overwritten in the meantime.
+ *  \param fName Full path to the file as passed to openHDF5File() or
+ *         importHDF5File().
+ *  \return true if sections still read from \e fName.
+ */
+StfioDll bool isHDF5FileOpen(const std::string& fName);
+
 //! Export a Recording to a HDF5 file.
-/*! \param fName Full path to the file to be written.
+/*! Throws std::runtime_error if isHDF5FileOpen() returns true for \e fName.
+ *  \param fName Full path to the file to be written.
  *  \param WData The data to be exported.
+ *  \param layout The layout of the file. stfio::hdf5_channels stores each
+ *         channel in a single chunked dataset, which is much faster to write
+ *         and read for many sections; files in this layout can't be read by
+ *         versions that predate it, so that it has to be requested
+ *         explicitly.
+ *  \param compression Deflate level (1-9) for stfio::hdf5_channels, combined
+ *         with the shuffle filter; 0 disables compression. Ignored if the
+ *         HDF5 library lacks the deflate filter.
  *  \return The HDF5 file handle.
  */
-StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg);
+StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg,
+                              hdf5_layout layout=hdf5_sections, int compression=0);
 
 }
 
@@ -822,8 +822,7 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                 RecordingInOut[nc].SetYUnits(tree.TraceList[nc].TrYUnit);
             }
             factor *=  tree.TraceList[nc].TrDataScaler;
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_mul(RecordingInOut[nc][ns].get(), factor);
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_plus(RecordingInOut[nc][ns].get(), tree.TraceList[nc].TrZeroData);
+            stfio::vec_affine(RecordingInOut[nc][ns].get_w(), factor, tree.TraceList[nc].TrZeroData);
         }
         RecordingInOut[nc].SetChannelName(tree.TraceList[nc].TrLabel);
         
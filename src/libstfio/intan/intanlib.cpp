@@ -276,6 +276,8 @@ void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, Pro
             ReturnData[nchan][nsec].resize(channels[nchan].size());
             std::copy(channels[nchan].begin(), channels[nchan].end(),
                       ReturnData[nchan][nsec].get_w().begin());
+            // Release the samples right away to keep the peak memory low:
+            std::vector<float>().swap(channels[nchan]);
         }
 
         // for (std::vector<Segment>::const_iterator it = hIntan.Settings.waveform.begin();
@@ -19,6 +19,8 @@
 #include <stdio.h>
 #include <ctime>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
 
 Recording::Recording(void)
     : ChannelArray(0)
@@ -62,6 +64,7 @@ void Recording::init() {
     cs = 0;
     selectedSections = std::vector<std::size_t>(0);
     selectBase = Vector_double(0);
+    trackAverage = false;
 	sectionMarker = std::vector<int>(0);
 }
 
@@ -171,25 +174,15 @@ void Recording::SetDateTime(int year, int month, int mday,int hour, int minute,
 }
 
 void Recording::InsertChannel(Channel& c_Channel, std::size_t pos) {
-    try {
-        if ( ChannelArray.at(pos).size() <= c_Channel.size() ) {
-            ChannelArray.at(pos).resize( c_Channel.size() );
-        }
-        // Resize sections if necessary:
-        std::size_t n_sec = 0;
-        for ( sec_it sit = c_Channel.get().begin(); sit != c_Channel.get().end(); ++sit ) {
-            if ( ChannelArray.at(pos).at(n_sec).size() <= sit->size() ) {
-                ChannelArray.at(pos).at(n_sec).get_w().resize( sit->size() );
-            }
-            n_sec++;
-        }
-    }
-    catch (...) {
-        throw;
-    }
+    // The assignment replaces all sections, so there's no need to resize
+    // them beforehand; doing so would copy stored sections into memory.
     ChannelArray.at(pos) = c_Channel;
 }
 
+void Recording::AdoptChannel(Channel& c_Channel, std::size_t pos) {
+    ChannelArray.at(pos).swap(c_Channel);
+}
+
 void Recording::CopyAttributes(const Recording& c_Recording) {
     file_description=c_Recording.file_description;
     global_section_description=c_Recording.global_section_description;
@@ -247,26 +240,50 @@ void Recording::SelectTrace(std::size_t sectionToSelect, std::size_t base_start,
     }
     selectedSections.push_back(sectionToSelect);
     double sumY=0;
-    if (curch()[sectionToSelect].size()==0) {
+    // Read-only, so that stored sections aren't copied into memory by
+    // several threads at once:
+    const Section& sec = curch()[sectionToSelect];
+    if (sec.size()==0) {
         selectBase.push_back(0);
     } else {
         int start = base_start;
         int end = base_end;
-        if (start > (int)curch()[sectionToSelect].size()-1)
-            start = curch()[sectionToSelect].size()-1;
+        if (start > (int)sec.size()-1)
+            start = sec.size()-1;
         if (start < 0) start = 0;
-        if (end > (int)curch()[sectionToSelect].size()-1)
-            end = curch()[sectionToSelect].size()-1;
+        if (end > (int)sec.size()-1)
+            end = sec.size()-1;
         if (end < 0) end = 0;
+        int n=(int)(end-start+1);
+        Vector_double buffer;
+        const double* y = NULL;
+        if (sec.IsStored()) {
+            buffer.resize(n);
+            sec.Read(start, n, &buffer[0]);
+            y = &buffer[0];
+        } else {
+            y = &sec.get()[start];
+        }
 #ifdef _OPENMP
 #pragma omp parallel for reduction(+:sumY)
 #endif
-        for (int i=start; i<=end; i++) {
-            sumY += curch()[sectionToSelect][i];
+        for (int i=0; i<n; i++) {
+            sumY += y[i];
         }
-        int n=(int)(end-start+1);
         selectBase.push_back(sumY/n);
     }
+    if (trackAverage) {
+        if (selectAverage.size() != ChannelArray.size()) {
+            // channels have been added or removed:
+            SetTrackAverage(true);
+            return;
+        }
+        for (std::size_t n_c = 0; n_c < ChannelArray.size(); ++n_c) {
+            if (sectionToSelect < ChannelArray[n_c].size()) {
+                selectAverage[n_c].Add(ChannelArray[n_c][sectionToSelect]);
+            }
+        }
+    }
 }
 
 bool Recording::UnselectTrace(std::size_t sectionToUnselect) {
@@ -290,6 +307,13 @@ bool Recording::UnselectTrace(std::size_t sectionToUnselect) {
         // resize vectors:
         selectedSections.resize(selectedSections.size()-1);
         selectBase.resize(selectBase.size()-1);
+        if (trackAverage) {
+            for (std::size_t n_c = 0; n_c < selectAverage.size() && n_c < ChannelArray.size(); ++n_c) {
+                if (sectionToUnselect < ChannelArray[n_c].size()) {
+                    selectAverage[n_c].Remove(ChannelArray[n_c][sectionToUnselect]);
+                }
+            }
+        }
         return true;
     } else {
         //msgbox
@@ -297,6 +321,37 @@ bool Recording::UnselectTrace(std::size_t sectionToUnselect) {
     }
 }
 
+void Recording::UnselectAll() {
+    selectedSections.clear();
+    selectBase.clear();
+    for (std::size_t n_c = 0; n_c < selectAverage.size(); ++n_c) {
+        selectAverage[n_c].Clear();
+    }
+}
+
+void Recording::SetTrackAverage(bool track) {
+    trackAverage = track;
+    selectAverage.clear();
+    if (!track) {
+        return;
+    }
+    selectAverage.resize(ChannelArray.size());
+    for (std::size_t n_c = 0; n_c < ChannelArray.size(); ++n_c) {
+        for (c_st_it cit = selectedSections.begin(); cit != selectedSections.end(); ++cit) {
+            if (*cit < ChannelArray[n_c].size()) {
+                selectAverage[n_c].Add(ChannelArray[n_c][*cit]);
+            }
+        }
+    }
+}
+
+const RunningAverage& Recording::GetSelectAverage(std::size_t channel) const {
+    if (!trackAverage || channel >= selectAverage.size()) {
+        throw std::out_of_range("Channel number out of range in Recording::GetSelectAverage");
+    }
+    return selectAverage[channel];
+}
+
 void Recording::SetXScale(double value) {
     dt=value;
     for (ch_it it1 = ChannelArray.begin(); it1 != ChannelArray.end(); it1++) {
@@ -306,6 +361,12 @@ void Recording::SetXScale(double value) {
     }
 }
 
+void Recording::SetStorage(stfio::storagetype type) {
+    for (ch_it it = ChannelArray.begin(); it != ChannelArray.end(); it++) {
+        it->SetStorage(type);
+    }
+}
+
 void Recording::MakeAverage(Section& AverageReturn,
         Section& SigReturn,
         std::size_t channel,
@@ -329,28 +390,58 @@ void Recording::MakeAverage(Section& AverageReturn,
         }
     }
 
-    for (unsigned int k=0; k < AverageReturn.size(); ++k) {
-        AverageReturn[k]=0.0;
-        //Calculate average
-        for (unsigned int l = 0; l < n_sections; ++l) {
-            AverageReturn[k] += 
-                ChannelArray[channel][section_index[l]][k+shift[l]];
-        }
-        AverageReturn[k] /= n_sections;
+    if (n_sections == 0) {
+        throw std::out_of_range("No sections in Recording::MakeAverage");
+    }
+
+    // set sample interval of averaged traces
+    AverageReturn.SetXScale(ChannelArray[channel][section_index[0]].GetXScale());
 
-        // set sample interval of averaged traces
-        AverageReturn.SetXScale(ChannelArray[channel][section_index[0]].GetXScale());
+    Vector_double& average = AverageReturn.get_w();
+    Vector_double* sig = isSig ? &SigReturn.get_w() : NULL;
+    const std::size_t n_points = average.size();
+    const std::size_t blockSize = 4096;
+    const int n_blocks = (int)((n_points + blockSize - 1) / blockSize);
 
+    // Sections are accumulated one after the other into blocks of data
+    // points that stay in the cache. Mean and variance are updated in a
+    // single pass (Welford's algorithm).
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n_b = 0; n_b < n_blocks; ++n_b) {
+        const std::size_t first = n_b*blockSize;
+        const std::size_t n = std::min(blockSize, n_points-first);
+        double* mean = &average[first];
+        Vector_double m2(isSig ? n : 0, 0.0), buffer;
+        std::fill(mean, mean+n, 0.0);
+        for (unsigned int l = 0; l < n_sections; ++l) {
+            const Section& sec = ChannelArray[channel][section_index[l]];
+            const double* x = NULL;
+            if (sec.IsStored()) {
+                buffer.resize(n);
+                sec.Read(first+shift[l], n, &buffer[0]);
+                x = &buffer[0];
+            } else {
+                x = &sec.get()[first+shift[l]];
+            }
+            const double weight = 1.0/(l+1);
+            if (isSig) {
+                for (std::size_t k = 0; k < n; ++k) {
+                    double delta = x[k]-mean[k];
+                    mean[k] += delta*weight;
+                    m2[k] += delta*(x[k]-mean[k]);
+                }
+            } else {
+                for (std::size_t k = 0; k < n; ++k) {
+                    mean[k] += (x[k]-mean[k])*weight;
+                }
+            }
+        }
         if (isSig) {
-            SigReturn[k]=0.0;
-            //Calculate variance
-            for (unsigned int l=0; l < n_sections; ++l) {
-                SigReturn[k] += 
-                    pow(ChannelArray[channel][section_index[l]][k+shift[l]] -
-                            AverageReturn[k], 2);
+            for (std::size_t k = 0; k < n; ++k) {
+                (*sig)[first+k] = sqrt(m2[k] / (n_sections - 1));
             }
-            SigReturn[k] /= (n_sections - 1);
-            SigReturn[k]=sqrt(SigReturn[k]);
         }
     }
 }
@@ -28,6 +28,7 @@
 #include <string.h>	// declaration of memcpy
 
 #include "./channel.h"
+#include "./runningaverage.h"
 // #include "./section.h"
 // #include "./stfio.h"
 
@@ -280,6 +281,12 @@ class StfioDll Recording {
      */
     void SetXScale(double value);
 
+    //! Changes the type in which the data points of all channels are held.
+    /*! See Section::SetStorage().
+     *  \param type The new storage type.
+     */
+    void SetStorage(stfio::storagetype type);
+
     //! Sets the index of the current channel.
     /*! \param value The index of the current channel.
      */
@@ -310,6 +317,17 @@ class StfioDll Recording {
      */
     virtual void InsertChannel(Channel& c_Channel, std::size_t pos);
 
+    //! Move a Channel to a given position without copying its sections.
+    /*! Like InsertChannel(), but \e c_Channel is exchanged with the channel
+     *  that is currently stored at \e pos, which is usually empty. Importers
+     *  use this so that each data point is held in memory only once.
+     *  Will throw std::out_of_range if range check fails.
+     *  \param c_Channel On entry, the Channel to be inserted. On exit, the
+     *         channel that was previously stored at \e pos.
+     *  \param pos The position at which to insert the channel (0-based).
+     */
+    virtual void AdoptChannel(Channel& c_Channel, std::size_t pos);
+
     //! Copy descriptive attributes from another Recording to this Recording.
     /*! This will copy the file and global section decription, the scaling, time, date, 
      *  comment and global y units strings and the x-scale.
@@ -352,6 +370,32 @@ class StfioDll Recording {
      *  \return true if the section was previously selected, false otherwise.
      */
     bool UnselectTrace(std::size_t sectionToUnselect);
+
+    //! Unselects all sections
+    void UnselectAll();
+
+    //! Turns the running average of the selected sections on or off.
+    /*! While it's on, SelectTrace(), UnselectTrace() and UnselectAll()
+     *  update the average of each channel by a single section. Modifying
+     *  the selection through GetSelectedSectionsW() or changing the data
+     *  requires calling this function again to recompute the averages.
+     *  \param track true to compute the averages of the current selection
+     *         and keep them up to date, false to discard them.
+     */
+    void SetTrackAverage(bool track);
+
+    //! Indicates whether the running average of the selected sections is kept up to date.
+    /*! \return true if the running average is on.
+     */
+    bool GetTrackAverage() const { return trackAverage; }
+
+    //! Retrieves the running average of the selected sections of a channel.
+    /*! Throws std::out_of_range if the running average is off or if
+     *  \e channel is out of range.
+     *  \param channel The channel index.
+     *  \return The average of the selected sections of \e channel.
+     */
+    const RunningAverage& GetSelectAverage(std::size_t channel) const;
     
     //operators------------------------------------------------------
 
@@ -410,6 +454,9 @@ class StfioDll Recording {
     std::vector<std::size_t> selectedSections;
     // Base line value for each selected trace
     Vector_double selectBase;
+    // Running average of the selected sections in each channel
+    bool trackAverage;
+    std::vector<RunningAverage> selectAverage;
     
     // defined when data is loaded
     const char* listOfMarkers[256];
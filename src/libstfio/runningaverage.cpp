@@ -0,0 +1,116 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "./stfio.h"
+#include "./runningaverage.h"
+
+#include <algorithm>
+#include <cmath>
+
+RunningAverage::RunningAverage()
+    : mean(0), m2(0), count(0)
+{}
+
+void RunningAverage::Add(const Section& section, int shift) {
+    if (shift < 0 || (std::size_t)shift > section.size()) {
+        throw std::out_of_range("Shift out of range in RunningAverage::Add");
+    }
+    std::size_t n_points = section.size()-shift;
+    if (count == 0) {
+        mean.assign(n_points, 0.0);
+        m2.assign(n_points, 0.0);
+    } else if (n_points < mean.size()) {
+        mean.resize(n_points);
+        m2.resize(n_points);
+    }
+    Update(section, shift, true);
+}
+
+void RunningAverage::Remove(const Section& section, int shift) {
+    if (count == 0) {
+        throw std::out_of_range("No sections in RunningAverage::Remove");
+    }
+    if (shift < 0 || mean.size() + shift > section.size()) {
+        throw std::out_of_range("Sampling point out of range in RunningAverage::Remove");
+    }
+    if (count == 1) {
+        Clear();
+        return;
+    }
+    Update(section, shift, false);
+}
+
+void RunningAverage::Clear() {
+    mean.clear();
+    m2.clear();
+    count = 0;
+}
+
+Vector_double RunningAverage::GetSD() const {
+    Vector_double sd(mean.size(), 0.0);
+    if (count < 2) {
+        return sd;
+    }
+    for (std::size_t k = 0; k < sd.size(); ++k) {
+        // Removing sections may leave tiny negative rounding errors:
+        sd[k] = m2[k] > 0 ? sqrt(m2[k] / (count - 1)) : 0.0;
+    }
+    return sd;
+}
+
+void RunningAverage::Update(const Section& section, int shift, bool add) {
+    const std::size_t n_points = mean.size();
+    const std::size_t blockSize = 4096;
+    const int n_blocks = (int)((n_points + blockSize - 1) / blockSize);
+    // count before the update when adding, after the update when removing:
+    const double weight = add ? 1.0/(count+1) : 1.0/(count-1);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (n_blocks > 1)
+#endif
+    for (int n_b = 0; n_b < n_blocks; ++n_b) {
+        const std::size_t first = n_b*blockSize;
+        const std::size_t n = std::min(blockSize, n_points-first);
+        Vector_double buffer;
+        const double* x = NULL;
+        if (section.IsStored()) {
+            buffer.resize(n);
+            section.Read(first+shift, n, &buffer[0]);
+            x = &buffer[0];
+        } else {
+            x = &section.get()[first+shift];
+        }
+        double* pm = &mean[first];
+        double* pm2 = &m2[first];
+        if (add) {
+            for (std::size_t k = 0; k < n; ++k) {
+                double delta = x[k]-pm[k];
+                pm[k] += delta*weight;
+                pm2[k] += delta*(x[k]-pm[k]);
+            }
+        } else {
+            for (std::size_t k = 0; k < n; ++k) {
+                // Inverse of the update above:
+                double old_mean = pm[k] + (pm[k]-x[k])*weight;
+                pm2[k] -= (x[k]-old_mean)*(x[k]-pm[k]);
+                pm[k] = old_mean;
+            }
+        }
+    }
+    if (add) {
+        ++count;
+    } else {
+        --count;
+    }
+}
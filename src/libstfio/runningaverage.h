@@ -0,0 +1,93 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file runningaverage.h
+ *  \brief Declares an average that sections can be added to and removed from.
+ */
+
+#ifndef _RUNNINGAVERAGE_H
+#define _RUNNINGAVERAGE_H
+
+class Section;
+
+/*! \addtogroup stfgen
+ *  @{
+ */
+
+//! Mean and variance of a varying set of sections.
+/*! Adding or removing a section updates the mean and the sum of squared
+ *  deviations of every data point (Welford's algorithm), so that keeping
+ *  the average of a selection up to date costs time proportional to the
+ *  length of a single section rather than to the whole selection.
+ *  The average covers the data points common to all sections that were
+ *  added since it was last empty: adding a section that is shorter than
+ *  the average truncates it. Removing a section doesn't extend it again.
+ */
+class StfioDll RunningAverage {
+public:
+    //! Default constructor. Creates an empty average.
+    RunningAverage();
+
+    //! Adds a section to the average.
+    /*! Throws std::out_of_range if \e shift exceeds the section.
+     *  \param section The section.
+     *  \param shift Number of data points that are skipped at the start of
+     *         the section, e.g. to align events.
+     */
+    void Add(const Section& section, int shift=0);
+
+    //! Removes a section that has been added before.
+    /*! The section and \e shift have to be the same as in the call to Add(),
+     *  otherwise the result is undefined. Throws std::out_of_range if the
+     *  average is empty or the section is too short.
+     *  \param section The section.
+     *  \param shift The shift that was passed to Add().
+     */
+    void Remove(const Section& section, int shift=0);
+
+    //! Removes all sections.
+    void Clear();
+
+    //! Retrieves the number of sections in the average.
+    /*! \return The number of sections.
+     */
+    std::size_t GetCount() const { return count; }
+
+    //! Retrieves the number of data points of the average.
+    /*! \return The number of data points.
+     */
+    std::size_t size() const { return mean.size(); }
+
+    //! Retrieves the average.
+    /*! \return The mean of each data point.
+     */
+    const Vector_double& GetMean() const { return mean; }
+
+    //! Computes the standard deviation.
+    /*! Uses the same normalization (n-1) as Recording::MakeAverage().
+     *  \return The standard deviation of each data point; zeros if there
+     *          are fewer than two sections.
+     */
+    Vector_double GetSD() const;
+
+private:
+    void Update(const Section& section, int shift, bool add);
+
+    Vector_double mean, m2;
+    std::size_t count;
+};
+
+/*@}*/
+
+#endif
@@ -12,6 +12,10 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+
 #include "./stfio.h"
 #include "./section.h"
 
@@ -21,35 +25,94 @@
 // within the constructor, see [1]248 and [2]28
 
 Section::Section(void)
-    : section_description(), x_scale(1.0), data(0)
+    : section_description(), x_scale(1.0), data(0), store(), pyramid()
 {}
 
 Section::Section( const Vector_double& valA, const std::string& label )
-    : section_description(label), x_scale(1.0), data(valA)
+    : section_description(label), x_scale(1.0), data(valA), store(), pyramid()
 {}
 
 Section::Section(std::size_t size, const std::string& label)
-    : section_description(label), x_scale(1.0), data(size)
+    : section_description(label), x_scale(1.0), data(size), store(), pyramid()
+{}
+
+Section::Section(const SectionStorePtr& store_, const std::string& label)
+    : section_description(label), x_scale(1.0), data(0), store(store_), pyramid()
 {}
 
+#if (__cplusplus >= 201103)
+Section::Section(Vector_double&& valA, const std::string& label)
+    : section_description(label), x_scale(1.0), data(std::move(valA)), store(), pyramid()
+{}
+#endif
+
 Section::~Section(void) {
 }
 
+void Section::swap(Section& other) {
+    section_description.swap(other.section_description);
+    std::swap(x_scale, other.x_scale);
+    data.swap(other.data);
+    store.swap(other.store);
+    pyramid.swap(other.pyramid);
+}
+
 
 double Section::at(std::size_t at_) const {
-    if (at_>=data.size()) {
+    if (at_>=size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
     }
-    return data[at_];
+    return (*this)[at_];
 }
 
 double& Section::at(std::size_t at_) {
-    if (at_>=data.size()) {
+    if (at_>=size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
     }
-    return data[at_];
+    return (*this)[at_];
+}
+
+void Section::Read(std::size_t begin, std::size_t n, double* out) const {
+    if (begin > size() || n > size()-begin) {
+        throw std::out_of_range("block out of range in Section::Read()");
+    }
+    if (store) {
+        store->Read(begin, n, out);
+    } else {
+        std::copy(data.begin()+begin, data.begin()+begin+n, out);
+    }
+}
+
+void Section::SetStorage(stfio::storagetype type) {
+    if (type == GetStorage()) {
+        return;
+    }
+    if (store) {
+        Materialize();
+    }
+    if (type != stfio::float64) {
+        store.reset(new CompactSectionStore(data, type));
+        Vector_double().swap(data);
+    }
+    pyramid.Clear();
+}
+
+void Section::Materialize() const {
+    Vector_double stored(store->size());
+    if (!stored.empty()) {
+        store->Read(0, stored.size(), &stored[0]);
+    }
+    data.swap(stored);
+    store.reset();
+}
+
+void Section::GetExtrema(std::size_t begin, std::size_t end, double& min, double& max) const {
+    if (!pyramid.IsBuilt() || pyramid.size()!=size()) {
+        pyramid.Build(*this);
+    }
+    pyramid.Extrema(*this, begin, end, min, max);
 }
 
 void Section::SetXScale( double value ) {
@@ -58,3 +121,124 @@ void Section::SetXScale( double value ) {
     else
         throw std::runtime_error( "Attempt to set x-scale <= 0" );
 }
+
+// Number of data points per block on the lowest pyramid level:
+static const std::size_t PYRAMID_BASE = 64;
+// Number of blocks that are combined on the next level:
+static const std::size_t PYRAMID_FANOUT = 4;
+
+MinMaxPyramid::MinMaxPyramid()
+    : built(false), n_data(0), mins(), maxs()
+{}
+
+void MinMaxPyramid::swap(MinMaxPyramid& other) {
+    std::swap(built, other.built);
+    std::swap(n_data, other.n_data);
+    mins.swap(other.mins);
+    maxs.swap(other.maxs);
+}
+
+void MinMaxPyramid::Build(const Section& sec) {
+    mins.clear();
+    maxs.clear();
+    n_data = sec.size();
+
+    // lowest level from the raw data, read in chunks so that stored
+    // sections don't have to be copied into memory:
+    std::size_t n_blocks = (n_data+PYRAMID_BASE-1)/PYRAMID_BASE;
+    if (n_blocks > 1) {
+        mins.push_back(Vector_double(n_blocks));
+        maxs.push_back(Vector_double(n_blocks));
+        Vector_double chunk(PYRAMID_BASE*1024);
+        for (std::size_t n_c=0; n_c<n_data; n_c+=chunk.size()) {
+            std::size_t c_size = std::min(chunk.size(), n_data-n_c);
+            sec.Read(n_c, c_size, &chunk[0]);
+            for (std::size_t n_o=0; n_o<c_size; n_o+=PYRAMID_BASE) {
+                std::size_t b_end = std::min(n_o+PYRAMID_BASE, c_size);
+                double b_min = chunk[n_o];
+                double b_max = b_min;
+                for (std::size_t n=n_o+1; n<b_end; ++n) {
+                    if (chunk[n] < b_min) b_min = chunk[n];
+                    if (chunk[n] > b_max) b_max = chunk[n];
+                }
+                mins.back()[(n_c+n_o)/PYRAMID_BASE] = b_min;
+                maxs.back()[(n_c+n_o)/PYRAMID_BASE] = b_max;
+            }
+        }
+    }
+
+    // combine blocks until a single one is left:
+    while (n_blocks > PYRAMID_FANOUT) {
+        std::size_t n_below = n_blocks;
+        n_blocks = (n_below+PYRAMID_FANOUT-1)/PYRAMID_FANOUT;
+        Vector_double l_min(n_blocks), l_max(n_blocks);
+        const Vector_double& b_mins = mins.back();
+        const Vector_double& b_maxs = maxs.back();
+        for (std::size_t n_b=0; n_b<n_blocks; ++n_b) {
+            std::size_t b_end = std::min((n_b+1)*PYRAMID_FANOUT, n_below);
+            l_min[n_b] = b_mins[n_b*PYRAMID_FANOUT];
+            l_max[n_b] = b_maxs[n_b*PYRAMID_FANOUT];
+            for (std::size_t n=n_b*PYRAMID_FANOUT+1; n<b_end; ++n) {
+                if (b_mins[n] < l_min[n_b]) l_min[n_b] = b_mins[n];
+                if (b_maxs[n] > l_max[n_b]) l_max[n_b] = b_maxs[n];
+            }
+        }
+        mins.push_back(l_min);
+        maxs.push_back(l_max);
+    }
+    built = true;
+}
+
+void MinMaxPyramid::Extrema(const Section& sec, std::size_t begin, std::size_t end,
+                            double& min, double& max) const
+{
+    if (begin >= end || end > n_data || end > sec.size()) {
+        throw std::out_of_range("Invalid range in MinMaxPyramid::Extrema()");
+    }
+    min = sec[begin];
+    max = sec[begin];
+
+    // whole blocks on the lowest level:
+    std::size_t b_lo = (begin+PYRAMID_BASE-1)/PYRAMID_BASE;
+    std::size_t b_hi = end/PYRAMID_BASE;
+    if (end==n_data) b_hi = (end+PYRAMID_BASE-1)/PYRAMID_BASE;
+    if (mins.empty() || b_lo >= b_hi) {
+        for (std::size_t n=begin+1; n<end; ++n) {
+            if (sec[n] < min) min = sec[n];
+            if (sec[n] > max) max = sec[n];
+        }
+        return;
+    }
+
+    // raw data points at the edges:
+    for (std::size_t n=begin+1; n<b_lo*PYRAMID_BASE; ++n) {
+        if (sec[n] < min) min = sec[n];
+        if (sec[n] > max) max = sec[n];
+    }
+    for (std::size_t n=b_hi*PYRAMID_BASE; n<end; ++n) {
+        if (sec[n] < min) min = sec[n];
+        if (sec[n] > max) max = sec[n];
+    }
+
+    // climb up the pyramid, taking unaligned blocks from both ends:
+    for (std::size_t n_l=0; n_l<mins.size() && b_lo<b_hi; ++n_l) {
+        const Vector_double& l_min = mins[n_l];
+        const Vector_double& l_max = maxs[n_l];
+        bool top = (n_l+1 == mins.size());
+        while (b_lo < b_hi && (top || b_lo%PYRAMID_FANOUT != 0)) {
+            if (l_min[b_lo] < min) min = l_min[b_lo];
+            if (l_max[b_lo] > max) max = l_max[b_lo];
+            ++b_lo;
+        }
+        while (b_lo < b_hi && b_hi%PYRAMID_FANOUT != 0 && b_hi != l_min.size()) {
+            --b_hi;
+            if (l_min[b_hi] < min) min = l_min[b_hi];
+            if (l_max[b_hi] > max) max = l_max[b_hi];
+        }
+        if (b_lo >= b_hi) break;
+        // a range that reaches the last block also covers the last parent:
+        bool last = (b_hi == l_min.size());
+        b_lo /= PYRAMID_FANOUT;
+        b_hi = last ? (b_hi+PYRAMID_FANOUT-1)/PYRAMID_FANOUT : b_hi/PYRAMID_FANOUT;
+    }
+}
@@ -27,10 +27,66 @@
 #ifndef _SECTION_H
 #define _SECTION_H
 
+#include "./sectionstore.h"
+
 /*! \addtogroup stfgen
  *  @{
  */
 
+class Section;
+
+//! Cached minima and maxima of a data vector at decreasing resolutions
+/*! Level 0 holds the extrema of blocks of 64 data points, and each further
+ *  level combines 4 blocks of the level below. The extrema of any range
+ *  of data points can then be found by visiting a handful of blocks per
+ *  level and at most 2x63 raw data points at the edges of the range.
+ *  The pyramid needs about 1/24 of the memory of the data.
+ */
+class StfioDll MinMaxPyramid {
+public:
+    //! Default constructor. Creates an empty pyramid.
+    MinMaxPyramid();
+
+    //! Builds the pyramid for \e sec, replacing all previous contents.
+    /*! \param sec The section.
+     */
+    void Build(const Section& sec);
+
+    //! Discards the pyramid.
+    void Clear() { if (built) { mins.clear(); maxs.clear(); built=false; n_data=0; } }
+
+    //! Exchanges the contents with another pyramid without copying.
+    /*! \param other The other pyramid.
+     */
+    void swap(MinMaxPyramid& other);
+
+    //! Indicates whether the pyramid has been built.
+    /*! \return true if Build() has been called since the last Clear().
+     */
+    bool IsBuilt() const { return built; }
+
+    //! Retrieve the number of data points that the pyramid was built for.
+    /*! \return The number of data points.
+     */
+    std::size_t size() const { return n_data; }
+
+    //! Finds the extrema in a range of data points.
+    /*! Throws std::out_of_range if the range is empty or exceeds the data.
+     *  \param sec The section that the pyramid was built for.
+     *  \param begin Index of the first data point.
+     *  \param end Index one past the last data point.
+     *  \param min On exit, the minimum in [begin, end).
+     *  \param max On exit, the maximum in [begin, end).
+     */
+    void Extrema(const Section& sec, std::size_t begin, std::size_t end,
+                 double& min, double& max) const;
+
+private:
+    bool built;
+    std::size_t n_data;
+    std::vector<Vector_double> mins, maxs;
+};
+
 //! Represents a continuously sampled sweep of data points
 class StfioDll Section {
 public:
@@ -56,21 +112,58 @@ public:
             const std::string& label="\0"
     );
 
+    //! Constructs a section that reads its data points from a store.
+    /*! The data points are converted to double on access. The first call
+     *  to get() or any write access copies all data points into memory
+     *  and releases the store.
+     *  \param store The store.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            const SectionStorePtr& store,
+            const std::string& label="\0"
+    );
+
+#if (__cplusplus >= 201103)
+    //! Constructor that takes over the data points without copying them.
+    /*! \param valA A vector of values that will make up the section.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            Vector_double&& valA,
+            const std::string& label="\0"
+    );
+
+    //! Copy constructor.
+    Section(const Section&) = default;
+
+    //! Move constructor. Takes over the data points without copying them.
+    Section(Section&&) = default;
+
+    //! Copy assignment.
+    Section& operator=(const Section&) = default;
+
+    //! Move assignment. Takes over the data points without copying them.
+    Section& operator=(Section&&) = default;
+#endif
+
     //! Destructor
     ~Section();
 
     // Operators--------------------------------------------------------------
     //! Unchecked access. Returns a non-const reference.
-    /*! \param at Data point index.
+    /*! Discards the extrema that GetExtrema() has cached. Read-only
+     *  callers should use a const Section& to keep them.
+     *  \param at Data point index.
      *  \return Copy of the data point with index at.
      */
-    double& operator[](std::size_t at) { return data[at]; }
+    double& operator[](std::size_t at) { if (store) Materialize(); pyramid.Clear(); return data[at]; }
 
     //! Unchecked access. Returns a copy.
     /*! \param at Data point index.
      *  \return Reference to the data point with index at.
      */
-    double operator[](std::size_t at) const { return data[at]; }
+    double operator[](std::size_t at) const { return store ? store->at(at) : data[at]; }
 
     // Public member functions------------------------------------------------
 
@@ -82,7 +175,8 @@ public:
     double at(std::size_t at_) const;
 
     //! Range-checked access. Returns a non-const reference.
-    /*! Throws std::out_of_range if out of range.
+    /*! Throws std::out_of_range if out of range. Like operator[](), this
+     *  discards the cached extrema.
      *  \param at_ Data point index.
      *  \return Reference to the data point at index at_
      */
@@ -90,29 +184,83 @@ public:
 
     //! Low-level access to the valarray (read-only).
     /*! An explicit function is used instead of implicit type conversion
-     *  to access the valarray.
+     *  to access the valarray. If the section has a store, the data points
+     *  are copied into memory first. This isn't thread-safe: threads that
+     *  share a stored section have to use Read() or the const operator[]().
      *  \return The valarray containing the data points.
      */
-    const Vector_double& get() const { return data; }
+    const Vector_double& get() const { if (store) Materialize(); return data; }
 
     //! Low-level access to the valarray (read and write).
     /*! An explicit function is used instead of implicit type conversion
      *  to access the valarray.
      *  \return The valarray containing the data points.
      */
-    Vector_double& get_w() { return data; }
+    Vector_double& get_w() { if (store) Materialize(); pyramid.Clear(); return data; }
 
     //! Resize the Section to a new number of data points; deletes all previously stored data when gcc is used.
     /*! Note that in the gcc implementation of std::vector, resizing will
      *  delete all the original data. This is different from std::vector::resize().
      *  \param new_size The new number of data points.
      */
-    void resize(std::size_t new_size) { data.resize(new_size); }
+    void resize(std::size_t new_size) { if (store) Materialize(); pyramid.Clear(); data.resize(new_size); }
 
     //! Retrieve the number of data points.
     /*! \return The number of data points.
      */
-    size_t size() const { return data.size(); }
+    size_t size() const { return store ? store->size() : data.size(); }
+
+    //! Copies a block of data points.
+    /*! Unlike get(), this reads directly from the store if the section has
+     *  one. Throws std::out_of_range if the block exceeds the section.
+     *  \param begin Index of the first data point.
+     *  \param n Number of data points.
+     *  \param out Receives \e n data points.
+     */
+    void Read(std::size_t begin, std::size_t n, double* out) const;
+
+    //! Indicates whether the data points are read from a store.
+    /*! \return true if the section is backed by a store and hasn't been
+     *          copied into memory yet.
+     */
+    bool IsStored() const { return (bool)store; }
+
+    //! Changes the type in which the data points are held in memory.
+    /*! stfio::float32 and stfio::int16 need a half or a quarter of the
+     *  memory of stfio::float64; int16 rounds the data points to 65535
+     *  levels across their range. Like any store, a compact store is
+     *  converted back to double by get() or write access.
+     *  \param type The new storage type.
+     */
+    void SetStorage(stfio::storagetype type);
+
+    //! Retrieves the type in which the data points are held.
+    /*! \return The storage type; stfio::float64 unless the section has a store.
+     */
+    stfio::storagetype GetStorage() const { return store ? store->Layout().type : stfio::float64; }
+
+    //! Retrieves the layout of the stored samples.
+    /*! Only valid if IsStored() returns true.
+     *  \return The sample layout.
+     */
+    SampleLayout Layout() const { return store->Layout(); }
+
+    //! Finds the extrema in a range of data points.
+    /*! Uses a MinMaxPyramid that is built on first use and discarded
+     *  whenever write access to the data is requested. Throws
+     *  std::out_of_range if the range is empty or exceeds the data.
+     *  \param begin Index of the first data point.
+     *  \param end Index one past the last data point.
+     *  \param min On exit, the minimum in [begin, end).
+     *  \param max On exit, the maximum in [begin, end).
+     */
+    void GetExtrema(std::size_t begin, std::size_t end, double& min, double& max) const;
+
+    //! Exchanges the contents with another section without copying the data points.
+    /*! Can be used to move sections in C++98, e.g. with Channel::AdoptSection().
+     *  \param other The other section.
+     */
+    void swap(Section& other);
 
     //! Sets the x scaling.
     /*! \param value The x scaling.
@@ -143,8 +291,17 @@ public:
     // The sampling interval:
     double x_scale;
 
+    // Copies all data points from the store into memory:
+    void Materialize() const;
+
     // The data:
-    Vector_double data;
+    mutable Vector_double data;
+
+    // Optional read-only source of the data, released by Materialize():
+    mutable SectionStorePtr store;
+
+    // Extrema of the data for fast plotting, built on demand:
+    mutable MinMaxPyramid pyramid;
 };
 
 /*@}*/
@@ -0,0 +1,273 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "./stfio.h"
+#include "./sectionstore.h"
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+
+SectionStore::~SectionStore() {
+}
+
+static std::size_t sampleSize(stfio::storagetype type) {
+    switch (type) {
+     case stfio::int16:
+         return sizeof(short);
+     case stfio::float32:
+         return sizeof(float);
+     default:
+         return sizeof(double);
+    }
+}
+
+template <typename T>
+static void convertSamples(const T* samples, std::size_t stride, std::size_t n,
+                           double scale, double shift, double* out)
+{
+    if (stride == 1) {
+        // separate loop with unit stride so that it gets vectorized:
+        for (std::size_t n_p = 0; n_p < n; ++n_p) {
+            out[n_p] = scale*samples[n_p] + shift;
+        }
+        return;
+    }
+    for (std::size_t n_p = 0; n_p < n; ++n_p) {
+        out[n_p] = scale*samples[n_p*stride] + shift;
+    }
+}
+
+void stfio::ConvertSamples(const SampleLayout& layout, std::size_t begin, std::size_t n, double* out) {
+    switch (layout.type) {
+     case stfio::int16:
+         convertSamples((const short*)layout.first + begin*layout.stride, layout.stride, n,
+                        layout.scale, layout.shift, out);
+         break;
+     case stfio::float32:
+         convertSamples((const float*)layout.first + begin*layout.stride, layout.stride, n,
+                        layout.scale, layout.shift, out);
+         break;
+     default:
+         convertSamples((const double*)layout.first + begin*layout.stride, layout.stride, n,
+                        layout.scale, layout.shift, out);
+    }
+}
+
+CompactSectionStore::CompactSectionStore(const Vector_double& data, stfio::storagetype type_)
+    : type(type_), floats(), shorts(), scale(1.0), shift(0.0)
+{
+    switch (type) {
+     case stfio::float32:
+         floats.assign(data.begin(), data.end());
+         break;
+     case stfio::int16: {
+         shorts.resize(data.size());
+         if (data.empty()) {
+             break;
+         }
+         double min = *std::min_element(data.begin(), data.end());
+         double max = *std::max_element(data.begin(), data.end());
+         shift = (max+min)/2.0;
+         if (max > min) {
+             scale = (max-min)/65534.0;
+         }
+         for (std::size_t n = 0; n < data.size(); ++n) {
+             double level = floor((data[n]-shift)/scale + 0.5);
+             if (level > 32767.0) level = 32767.0;
+             if (level < -32767.0) level = -32767.0;
+             shorts[n] = (short)level;
+         }
+         break;
+     }
+     default:
+         throw std::runtime_error("CompactSectionStore can't hold 64 bit floats");
+    }
+}
+
+CompactSectionStore::CompactSectionStore(Vector_float& samples)
+    : type(stfio::float32), floats(), shorts(), scale(1.0), shift(0.0)
+{
+    floats.swap(samples);
+}
+
+CompactSectionStore::CompactSectionStore(std::vector<short>& samples, double scale_, double shift_)
+    : type(stfio::int16), floats(), shorts(), scale(scale_), shift(shift_)
+{
+    shorts.swap(samples);
+}
+
+std::size_t CompactSectionStore::size() const {
+    return (type == stfio::int16) ? shorts.size() : floats.size();
+}
+
+double CompactSectionStore::at(std::size_t at) const {
+    if (type == stfio::int16) {
+        return scale*shorts[at] + shift;
+    } else {
+        return scale*floats[at] + shift;
+    }
+}
+
+void CompactSectionStore::Read(std::size_t begin, std::size_t n, double* out) const {
+    stfio::ConvertSamples(Layout(), begin, n, out);
+}
+
+SampleLayout CompactSectionStore::Layout() const {
+    SampleLayout layout;
+    layout.type = type;
+    if (type == stfio::int16) {
+        layout.first = shorts.empty() ? NULL : (const char*)&shorts[0];
+    } else {
+        layout.first = floats.empty() ? NULL : (const char*)&floats[0];
+    }
+    layout.stride = 1;
+    layout.scale = scale;
+    layout.shift = shift;
+    return layout;
+}
+
+FileMapping::FileMapping(const std::string& fName, unsigned long long offset, std::size_t length_)
+    : map_base(NULL), map_length(0), view(NULL), length(length_)
+#ifdef _WIN32
+    , hFile(NULL), hMapping(NULL)
+#endif
+{
+    if (length == 0) {
+        throw std::runtime_error("Attempt to map an empty file region");
+    }
+#ifdef _WIN32
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    unsigned long long granularity = sysInfo.dwAllocationGranularity;
+#else
+    unsigned long long granularity = (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+    // the start of a mapping has to be aligned:
+    unsigned long long map_offset = (offset/granularity)*granularity;
+    map_length = (std::size_t)(offset-map_offset) + length;
+
+#ifdef _WIN32
+    HANDLE hF = CreateFileA(fName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hF == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Couldn't open " + fName + " for mapping");
+    }
+    HANDLE hM = CreateFileMappingA(hF, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hM == NULL) {
+        CloseHandle(hF);
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+    map_base = MapViewOfFile(hM, FILE_MAP_READ, (DWORD)(map_offset >> 32),
+                             (DWORD)(map_offset & 0xFFFFFFFF), map_length);
+    if (map_base == NULL) {
+        CloseHandle(hM);
+        CloseHandle(hF);
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+    hFile = hF;
+    hMapping = hM;
+#else
+    int fd = open(fName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Couldn't open " + fName + " for mapping");
+    }
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    if (file_size < 0 || (unsigned long long)file_size < offset+length) {
+        close(fd);
+        throw std::runtime_error("Region to be mapped exceeds " + fName);
+    }
+    void* base = mmap(NULL, map_length, PROT_READ, MAP_SHARED, fd, (off_t)map_offset);
+    // the mapping stays valid after closing the file:
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+    map_base = base;
+#endif
+    view = (const char*)map_base + (offset-map_offset);
+}
+
+FileMapping::~FileMapping() {
+#ifdef _WIN32
+    UnmapViewOfFile(map_base);
+    CloseHandle((HANDLE)hMapping);
+    CloseHandle((HANDLE)hFile);
+#else
+    munmap(map_base, map_length);
+#endif
+}
+
+static bool hostIsLittleEndian() {
+    unsigned short one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+MappedSectionStore::MappedSectionStore(const FileMappingPtr& mapping_, stfio::storagetype type_,
+                                       std::size_t first_, std::size_t stride_, std::size_t n,
+                                       double scale_, double shift_)
+    : mapping(mapping_), type(type_), first(first_), stride(stride_), n_points(n),
+      scale(scale_), shift(shift_)
+{
+    if (!hostIsLittleEndian()) {
+        throw std::runtime_error("Mapped data are only supported on little-endian hosts");
+    }
+    if (stride == 0 || (n_points > 0 &&
+            (first + (n_points-1)*stride + 1) * sampleSize(type) > mapping->size())) {
+        throw std::out_of_range("Data points exceed the mapped region");
+    }
+}
+
+double MappedSectionStore::at(std::size_t at) const {
+    const char* sample = mapping->data() + (first + at*stride) * sampleSize(type);
+    if (type == stfio::int16) {
+        short value;
+        memcpy(&value, sample, sizeof(short));
+        return scale*value + shift;
+    } else if (type == stfio::float32) {
+        float value;
+        memcpy(&value, sample, sizeof(float));
+        return scale*value + shift;
+    } else {
+        double value;
+        memcpy(&value, sample, sizeof(double));
+        return scale*value + shift;
+    }
+}
+
+void MappedSectionStore::Read(std::size_t begin, std::size_t n, double* out) const {
+    stfio::ConvertSamples(Layout(), begin, n, out);
+}
+
+SampleLayout MappedSectionStore::Layout() const {
+    SampleLayout layout;
+    layout.type = type;
+    layout.first = mapping->data() + first*sampleSize(type);
+    layout.stride = stride;
+    layout.scale = scale;
+    layout.shift = shift;
+    return layout;
+}
@@ -0,0 +1,269 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file sectionstore.h
+ *  \brief Declares read-only sample stores that can back a Section.
+ */
+
+#ifndef _SECTIONSTORE_H
+#define _SECTIONSTORE_H
+
+#include <string>
+#include <vector>
+#if (__cplusplus < 201103)
+#  include <boost/shared_ptr.hpp>
+#else
+#  include <memory>
+#endif
+
+/*! \addtogroup stfgen
+ *  @{
+ */
+
+namespace stfio {
+
+//! Types in which the data points of a Section can be stored.
+enum storagetype {
+    float64, /*!< 64 bit floats (double), the default. */
+    float32, /*!< 32 bit floats. */
+    int16    /*!< 16 bit integers with a gain and an offset. */
+};
+
+}
+
+//! Location and scaling of the samples held by a SectionStore.
+/*! The data point with index \e i is \e scale * sample + \e shift, where
+ *  the sample of type \e type is found at element \e i * \e stride
+ *  counted from \e first.
+ */
+struct StfioDll SampleLayout {
+    stfio::storagetype type; /*!< The sample type. */
+    const char* first;       /*!< Address of the first sample. */
+    std::size_t stride;      /*!< Distance between consecutive samples in elements. */
+    double scale;            /*!< Scaling factor from samples to data points. */
+    double shift;            /*!< Offset that is added after scaling. */
+};
+
+namespace stfio {
+
+//! Converts samples to double.
+/*! Computes \e layout.scale * sample + \e layout.shift for \e n data points
+ *  starting at data point \e begin. Contiguous samples are converted by a
+ *  loop that the compiler can vectorize. Used by the stores and importers
+ *  that de-interleave multiplexed samples.
+ *  \param layout The layout of the samples.
+ *  \param begin Index of the first data point.
+ *  \param n Number of data points.
+ *  \param out Receives \e n data points.
+ */
+StfioDll void ConvertSamples(const SampleLayout& layout, std::size_t begin, std::size_t n, double* out);
+
+}
+
+//! Random-access view of stored samples of type \e T.
+/*! Can be passed to templated kernels such as stfnum::base() in place of
+ *  a Vector_double, so that compact samples are converted on the fly.
+ */
+template <typename T>
+class SampleArray {
+public:
+    //! Constructor
+    /*! \param layout The layout of the samples; layout.type has to match \e T.
+     *  \param n Number of data points.
+     */
+    SampleArray(const SampleLayout& layout, std::size_t n)
+        : first((const T*)layout.first), stride(layout.stride), n_points(n),
+          scale(layout.scale), shift(layout.shift)
+    {}
+
+    //! Unchecked access to a data point.
+    /*! \param at Data point index.
+     *  \return The data point converted to double.
+     */
+    double operator[](std::size_t at) const { return scale*first[at*stride] + shift; }
+
+    //! Retrieve the number of data points.
+    /*! \return The number of data points.
+     */
+    std::size_t size() const { return n_points; }
+
+private:
+    const T* first;
+    std::size_t stride, n_points;
+    double scale, shift;
+};
+
+//! Read-only source of data points that can back a Section.
+/*! A Section that is constructed from a store converts the data points to
+ *  double only when they are accessed, so that recordings larger than the
+ *  available memory can be displayed.
+ */
+class StfioDll SectionStore {
+public:
+    //! Destructor
+    virtual ~SectionStore();
+
+    //! Retrieve the number of data points.
+    /*! \return The number of data points.
+     */
+    virtual std::size_t size() const = 0;
+
+    //! Unchecked access to a single data point.
+    /*! \param at Data point index.
+     *  \return The data point converted to double.
+     */
+    virtual double at(std::size_t at) const = 0;
+
+    //! Converts a block of data points to double.
+    /*! No range checking is performed.
+     *  \param begin Index of the first data point.
+     *  \param n Number of data points.
+     *  \param out Receives \e n data points.
+     */
+    virtual void Read(std::size_t begin, std::size_t n, double* out) const = 0;
+
+    //! Retrieve the location and scaling of the samples.
+    /*! \return The sample layout.
+     */
+    virtual SampleLayout Layout() const = 0;
+};
+
+//! Data points held in memory as 32 bit floats or scaled 16 bit integers.
+/*! Needs a half or a quarter of the memory of a Vector_double.
+ */
+class StfioDll CompactSectionStore : public SectionStore {
+public:
+    //! Converts data points to a compact sample type.
+    /*! For stfio::int16, the gain and offset are chosen so that the range
+     *  of \e data is spread across 65535 levels; the data points are
+     *  rounded to the nearest level. Throws std::runtime_error if \e type
+     *  is stfio::float64.
+     *  \param data The data points.
+     *  \param type The sample type.
+     */
+    CompactSectionStore(const Vector_double& data, stfio::storagetype type);
+
+    //! Takes 32 bit float samples, e.g. as read from a file.
+    /*! \param samples The samples. The vector is swapped with an empty one.
+     */
+    explicit CompactSectionStore(Vector_float& samples);
+
+    //! Takes 16 bit integer samples, e.g. as read from a file.
+    /*! \param samples The samples. The vector is swapped with an empty one.
+     *  \param scale Scaling factor from samples to data points.
+     *  \param shift Offset that is added after scaling.
+     */
+    CompactSectionStore(std::vector<short>& samples, double scale, double shift);
+
+    virtual std::size_t size() const;
+
+    virtual double at(std::size_t at) const;
+
+    virtual void Read(std::size_t begin, std::size_t n, double* out) const;
+
+    virtual SampleLayout Layout() const;
+
+private:
+    stfio::storagetype type;
+    Vector_float floats;
+    std::vector<short> shorts;
+    double scale, shift;
+};
+
+//! Read-only memory mapping of a region of a file.
+class StfioDll FileMapping {
+public:
+    //! Constructor. Maps \e length bytes starting at \e offset.
+    /*! Throws std::runtime_error if the file can't be opened or mapped.
+     *  \param fName The file name.
+     *  \param offset Offset of the region in bytes.
+     *  \param length Length of the region in bytes.
+     */
+    FileMapping(const std::string& fName, unsigned long long offset, std::size_t length);
+
+    //! Destructor. Unmaps the region.
+    ~FileMapping();
+
+    //! Retrieves the mapped region.
+    /*! \return Pointer to the first byte of the region.
+     */
+    const char* data() const { return view; }
+
+    //! Retrieves the length of the mapped region.
+    /*! \return The length in bytes.
+     */
+    std::size_t size() const { return length; }
+
+private:
+    FileMapping(const FileMapping&);
+    FileMapping& operator=(const FileMapping&);
+
+    void* map_base;
+    std::size_t map_length;
+    const char* view;
+    std::size_t length;
+#ifdef _WIN32
+    void* hFile;
+    void* hMapping;
+#endif
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<const SectionStore> SectionStorePtr;
+typedef boost::shared_ptr<const FileMapping> FileMappingPtr;
+#else
+typedef std::shared_ptr<const SectionStore> SectionStorePtr;
+typedef std::shared_ptr<const FileMapping> FileMappingPtr;
+#endif
+
+//! Data points of one channel in a memory-mapped file region.
+/*! The channels may be multiplexed; the data point with index \e i is then
+ *  read from sample \e first + \e i * \e stride of the region and converted
+ *  to \e scale * sample + \e shift. Several stores can share a mapping.
+ */
+class StfioDll MappedSectionStore : public SectionStore {
+public:
+    //! Constructor
+    /*! Throws std::out_of_range if the data points exceed the mapped region
+     *  and std::runtime_error on big-endian hosts.
+     *  \param mapping The mapped file region.
+     *  \param type The sample type; samples are little-endian.
+     *  \param first Index of the first sample of this channel in the region.
+     *  \param stride Distance between consecutive samples of this channel.
+     *  \param n Number of data points.
+     *  \param scale Scaling factor from samples to data points.
+     *  \param shift Offset that is added after scaling.
+     */
+    MappedSectionStore(const FileMappingPtr& mapping, stfio::storagetype type,
+                       std::size_t first, std::size_t stride, std::size_t n,
+                       double scale=1.0, double shift=0.0);
+
+    virtual std::size_t size() const { return n_points; }
+
+    virtual double at(std::size_t at) const;
+
+    virtual void Read(std::size_t begin, std::size_t n, double* out) const;
+
+    virtual SampleLayout Layout() const;
+
+private:
+    FileMappingPtr mapping;
+    stfio::storagetype type;
+    std::size_t first, stride, n_points;
+    double scale, shift;
+};
+
+/*@}*/
+
+#endif
@@ -167,7 +167,7 @@ void stimfit::SON::importSONFile(const wxString& fName, Recording& ReturnData) {
 				Section TempSection(points,label.str());
 				std::copy(afData.begin(),afData.begin()+points,&TempSection[0]);
 				TempChannel.resize(n_s+1);
-				TempChannel.insert_section(TempSection,n_s++);
+				TempChannel.AdoptSection(TempSection,n_s++);
 			}
 			bTime = bTime + (points * SONChanDivide(sFh, chan));
 		}
@@ -176,7 +176,7 @@ void stimfit::SON::importSONFile(const wxString& fName, Recording& ReturnData) {
 		ReturnData.SetGlobalYUnits(n_c,units);
 		long lDivide = SONChanDivide(sFh, (long)n_c); /* get interval for channel 3 */
 		ReturnData.SetXScale(lDivide*(usPerTime*dTickLen)*1e3); /* frequency in kHz */
-		ReturnData.InsertChannel(TempChannel,n_c);
+		ReturnData.AdoptChannel(TempChannel,n_c);
 	}
 	SONCloseFile(sFh);
 }
@@ -25,6 +25,11 @@
 
 
 #include <sstream>
+#include <fstream>
+#include <deque>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
 
 #include "stfio.h"
 
@@ -138,12 +143,67 @@ stfio::findExtension(stfio::filetype ftype) {
     }
 }
 
-bool stfio::importFile(
+// Importers that can read several files at the same time. Builds with
+// biosig read every file through importBiosigFile() first, which holds
+// the biosig lock, so that they import one file after the other.
+static bool isReentrant(stfio::filetype type) {
+    switch (type) {
+     case stfio::abf:
+     case stfio::axg:
+     case stfio::intan:
+         return true;
+     default:
+         return false;
+    }
+}
+
+#ifdef _OPENMP
+// One lock per file type whose importer keeps global state:
+class ImportLocks {
+public:
+    ImportLocks() {
+        for (int n_t=0; n_t <= stfio::none; ++n_t) {
+            omp_init_lock(&locks[n_t]);
+        }
+    }
+    ~ImportLocks() {
+        for (int n_t=0; n_t <= stfio::none; ++n_t) {
+            omp_destroy_lock(&locks[n_t]);
+        }
+    }
+    omp_lock_t locks[stfio::none+1];
+};
+
+static ImportLocks importLocks;
+#endif
+
+// Holds the lock of a file type that can't be read concurrently for as long
+// as it exists, so that importFile() can be called from several threads.
+class ImportGuard {
+public:
+    explicit ImportGuard(stfio::filetype type) {
+#ifdef _OPENMP
+        lock = isReentrant(type) ? NULL : &importLocks.locks[type];
+        if (lock) omp_set_lock(lock);
+#endif
+    }
+    ~ImportGuard() {
+#ifdef _OPENMP
+        if (lock) omp_unset_lock(lock);
+#endif
+    }
+private:
+#ifdef _OPENMP
+    omp_lock_t* lock;
+#endif
+};
+
+static bool importRecording(
         const std::string& fName,
         stfio::filetype type,
         Recording& ReturnData,
         const stfio::txtImportSettings& txtImport,
-        ProgressInfo& progDlg
+        stfio::ProgressInfo& progDlg
 ) {
     try {
 
@@ -167,6 +227,7 @@ bool stfio::importFile(
 
        // if this point is reached, import ABF was not applied or not successful
         try {
+            ImportGuard guard(stfio::biosig);
             stfio::filetype type1 = stfio::importBiosigFile(fName, ReturnData, progDlg);
             switch (type1) {
             case stfio::biosig:
@@ -183,6 +244,7 @@ bool stfio::importFile(
         }
 #endif
 
+        ImportGuard guard(type);
         switch (type) {
         case stfio::hdf5: {
             stfio::importHDF5File(fName, ReturnData, progDlg);
@@ -267,6 +329,153 @@ bool stfio::importFile(
     return true;
 }
 
+bool stfio::importFile(
+        const std::string& fName,
+        stfio::filetype type,
+        Recording& ReturnData,
+        const stfio::txtImportSettings& txtImport,
+        ProgressInfo& progDlg,
+        stfio::storagetype storage
+) {
+    if (!importRecording(fName, type, ReturnData, txtImport, progDlg)) {
+        return false;
+    }
+    // float64 leaves lazily read sections in their file:
+    if (storage != stfio::float64) {
+        ReturnData.SetStorage(storage);
+    }
+    return true;
+}
+
+// Importers running on worker threads don't report progress, but they
+// see when the import has been cancelled. The flag is set by another
+// thread, so that it is re-read from memory on every update.
+class WorkerProgressInfo : public stfio::ProgressInfo {
+public:
+    explicit WorkerProgressInfo(const bool& cancel_)
+        : ProgressInfo("", "", 100, false), cancel(cancel_) {}
+    bool Update(int value, const std::string& newmsg="", bool* skip=NULL) {
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+        return !cancel;
+    }
+private:
+    const bool& cancel;
+};
+
+// Rough size of a recording once it has been read: 16 bit samples become doubles.
+static std::size_t estimateBytes(const std::string& fName) {
+    std::ifstream file(fName.c_str(), std::ios::binary | std::ios::ate);
+    if (!file) {
+        return 0;
+    }
+    return 4 * (std::size_t)file.tellg();
+}
+
+std::size_t stfio::importFiles(
+        const std::vector<std::string>& fNames,
+        stfio::filetype type,
+        ImportReceiver& receiver,
+        const stfio::txtImportSettings& txtImport,
+        stfio::ProgressInfo& progDlg,
+        int n_threads,
+        std::size_t max_bytes,
+        stfio::storagetype storage
+) {
+    std::size_t n_done = 0, n_ok = 0, in_flight = 0;
+    bool cancel = false;
+    // Files that don't fit into max_bytes yet, with their estimated size.
+    // They are read by the next worker that releases memory, so that no
+    // worker has to wait for another one.
+    std::deque< std::pair<int, std::size_t> > deferred;
+    WorkerProgressInfo workerProgress(cancel);
+#ifdef _OPENMP
+    if (n_threads <= 0) {
+        n_threads = omp_get_num_procs();
+    }
+#pragma omp parallel for schedule(dynamic) num_threads(n_threads)
+#endif
+    for (int n_f=0; n_f < (int)fNames.size(); ++n_f) {
+        std::size_t bytes = (max_bytes > 0) ? estimateBytes(fNames[n_f]) : 0;
+
+        // Reserve memory; a file that exceeds the limit on its own is read
+        // as soon as nothing else is in flight.
+        bool reserved = false;
+#ifdef _OPENMP
+#pragma omp critical (stfio_import_files)
+#endif
+        {
+            if (!cancel && (in_flight == 0 || max_bytes == 0 || in_flight + bytes <= max_bytes)) {
+                in_flight += bytes;
+                reserved = true;
+            } else if (!cancel) {
+                deferred.push_back(std::make_pair(n_f, bytes));
+            }
+        }
+
+        for (int n_next = reserved ? n_f : -1; n_next >= 0; ) {
+            const std::string& fName = fNames[n_next];
+            stfio::filetype fType = type;
+#ifndef TEST_MINIMAL
+            if (fType == stfio::none) {
+                std::size_t dot = fName.rfind('.');
+                if (dot != std::string::npos) {
+                    fType = stfio::findType("*" + fName.substr(dot));
+                }
+            }
+#endif
+            Recording data;
+            std::string error;
+            try {
+                stfio::importFile(fName, fType, data, txtImport, workerProgress, storage);
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+                if (error.empty()) {
+                    error = "Unknown error";
+                }
+                data.resize(0);
+            }
+
+#ifdef _OPENMP
+#pragma omp critical (stfio_import_files)
+#endif
+            {
+                if (!cancel && !receiver.Receive(n_next, data, error)) {
+                    cancel = true;
+                }
+                in_flight -= bytes;
+                ++n_done;
+                if (error.empty()) {
+                    ++n_ok;
+                }
+                std::ostringstream progStr;
+                progStr << "Read " << n_done << " of " << fNames.size() << " files";
+                if (!progDlg.Update((int)(100.0*n_done/fNames.size()), progStr.str())) {
+                    cancel = true;
+                }
+
+                // Take over the first deferred file that fits now:
+                n_next = -1;
+                if (cancel) {
+                    deferred.clear();
+                }
+                for (std::size_t n_d=0; n_d < deferred.size(); ++n_d) {
+                    if (in_flight == 0 || in_flight + deferred[n_d].second <= max_bytes) {
+                        n_next = deferred[n_d].first;
+                        bytes = deferred[n_d].second;
+                        in_flight += bytes;
+                        deferred.erase(deferred.begin()+n_d);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return n_ok;
+}
+
 bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
                        ProgressInfo& progDlg)
 {
@@ -307,29 +516,51 @@ bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Rec
 }
 
 Vector_double stfio::vec_scal_plus(const Vector_double& vec, double scalar) {
-    Vector_double ret_vec(vec.size(), scalar);
-    std::transform(vec.begin(), vec.end(), ret_vec.begin(), ret_vec.begin(), std::plus<double>());
+    Vector_double ret_vec(vec.size());
+    if (!vec.empty()) vec_affine(&vec[0], vec.size(), 1.0, scalar, &ret_vec[0]);
     return ret_vec;
 }
 
 Vector_double stfio::vec_scal_minus(const Vector_double& vec, double scalar) {
-    Vector_double ret_vec(vec.size(), scalar);
-    std::transform(vec.begin(), vec.end(), ret_vec.begin(), ret_vec.begin(), std::minus<double>());
+    Vector_double ret_vec(vec.size());
+    if (!vec.empty()) vec_affine(&vec[0], vec.size(), 1.0, -scalar, &ret_vec[0]);
     return ret_vec;
 }
 
 Vector_double stfio::vec_scal_mul(const Vector_double& vec, double scalar) {
-    Vector_double ret_vec(vec.size(), scalar);
-    std::transform(vec.begin(), vec.end(), ret_vec.begin(), ret_vec.begin(), std::multiplies<double>());
+    Vector_double ret_vec(vec.size());
+    if (!vec.empty()) vec_affine(&vec[0], vec.size(), scalar, 0.0, &ret_vec[0]);
     return ret_vec;
 }
 
 Vector_double stfio::vec_scal_div(const Vector_double& vec, double scalar) {
-    Vector_double ret_vec(vec.size(), scalar);
-    std::transform(vec.begin(), vec.end(), ret_vec.begin(), ret_vec.begin(), std::divides<double>());
+    Vector_double ret_vec(vec.size());
+    for (std::size_t n = 0; n < vec.size(); ++n) {
+        ret_vec[n] = vec[n] / scalar;
+    }
     return ret_vec;
 }
 
+void stfio::vec_affine(Vector_double& vec, double a, double b) {
+    if (!vec.empty()) vec_affine(&vec[0], vec.size(), a, b, &vec[0]);
+}
+
+void stfio::vec_affine(const double* in, std::size_t n, double a, double b, double* out) {
+    const std::size_t blockSize = 65536;
+    const int n_blocks = (int)((n + blockSize - 1) / blockSize);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (n_blocks > 16)
+#endif
+    for (int n_b = 0; n_b < n_blocks; ++n_b) {
+        const std::size_t first = n_b*blockSize;
+        const std::size_t last = std::min(first+blockSize, n);
+        // unit stride, so that the compiler can vectorize the loop:
+        for (std::size_t i = first; i < last; ++i) {
+            out[i] = a*in[i] + b;
+        }
+    }
+}
+
 Vector_double stfio::vec_vec_plus(const Vector_double& vec1, const Vector_double& vec2) {
     Vector_double ret_vec(vec1.size());
     std::transform(vec1.begin(), vec1.end(), vec2.begin(), ret_vec.begin(), std::plus<double>());
@@ -390,17 +621,18 @@ stfio::concatenate(const Recording& src, const std::vector<std::size_t>& section
                 Concatenated.resize(0);
                 throw std::runtime_error("memory allocation error");
             }
-            std::copy(src[nc][*cit].get().begin(),
-                      src[nc][*cit].get().end(),
-                      &TempSection[n_new]);
+            if (secSize > 0) {
+                src[nc][*cit].Read(0, secSize, &TempSection.get_w()[n_new]);
+            }
             n_new += secSize;
             n_s++;
         }
         TempSection.SetSectionDescription(src[nc][0].GetSectionDescription() + ", concatenated");
-        Channel TempChannel(TempSection);
+        Channel TempChannel(1);
+        TempChannel.AdoptSection(TempSection, 0);
 	TempChannel.SetChannelName(src[nc].GetChannelName());
 	TempChannel.SetYUnits(src[nc].GetYUnits());
-	Concatenated.InsertChannel(TempChannel, nc);
+	Concatenated.AdoptChannel(TempChannel, nc);
     }
 
     // Recording Concatenated(TempChannel);
@@ -413,18 +645,23 @@ Recording
 stfio::multiply(const Recording& src, const std::vector<std::size_t>& sections,
                 std::size_t channel, double factor)
 {
-    Channel TempChannel(sections.size(), src[channel][sections[0]].size());
+    Channel TempChannel(sections.size());
     std::size_t n = 0;
     for (c_st_it cit = sections.begin(); cit != sections.end(); cit++) {
-        // Multiply the valarray in Data:
-        Section TempSection(stfio::vec_scal_mul(src[channel][*cit].get(),factor));
+        // Multiply the data in place, reading stored sections directly:
+        Section TempSection(src[channel][*cit].size());
+        if (TempSection.size() > 0) {
+            Vector_double& data = TempSection.get_w();
+            src[channel][*cit].Read(0, data.size(), &data[0]);
+            stfio::vec_affine(data, factor, 0.0);
+        }
         TempSection.SetXScale(src[channel][*cit].GetXScale());
         TempSection.SetSectionDescription(
                 src[channel][*cit].GetSectionDescription()+
                 ", multiplied"
         );
         try {
-            TempChannel.InsertSection(TempSection, n);
+            TempChannel.AdoptSection(TempSection, n);
         }
         catch (const std::out_of_range e) {
             throw e;
@@ -432,7 +669,8 @@ stfio::multiply(const Recording& src, const std::vector<std::size_t>& sections,
         n++;
     }
     if (TempChannel.size()>0) {
-        Recording Multiplied(TempChannel);
+        Recording Multiplied(1);
+        Multiplied.AdoptChannel(TempChannel, 0);
         Multiplied.CopyAttributes(src);
         Multiplied[0].SetYUnits( src.at( channel ).GetYUnits() );
         return Multiplied;
@@ -102,6 +102,25 @@ namespace stfio {
 
     StfioDll Vector_double vec_vec_div(const Vector_double& vec1, const Vector_double& vec2);
 
+    //! Computes \e a * x + \e b for each element of a vector in place.
+    /*! Replaces chains of the vec_scal_* functions, which allocate a new
+     *  vector each, with a single pass over the data.
+     *  \param vec The vector.
+     *  \param a Scaling factor.
+     *  \param b Offset that is added after scaling.
+     */
+    StfioDll void vec_affine(Vector_double& vec, double a, double b);
+
+    //! Computes \e a * in[i] + \e b for \e n elements.
+    /*! Long arrays are split into blocks that are processed in parallel.
+     *  \param in The input values.
+     *  \param n Number of elements.
+     *  \param a Scaling factor.
+     *  \param b Offset that is added after scaling.
+     *  \param out Receives \e n values; may be the same as \e in.
+     */
+    StfioDll void vec_affine(const double* in, std::size_t n, double a, double b, double* out);
+
 //! ProgressInfo class
 /*! Abstract class to be used as an interface for the file io read/write functions
  *  Can be a GUI Dialog or stdout messages
@@ -192,6 +211,9 @@ findExtension(stfio::filetype ftype);
  *  \param ReturnData Will contain the file data on return.
  *  \param txtImport The text import filter settings.
  *  \param ProgressInfo Progress indicator
+ *  \param storage The type in which the data points are held after the
+ *         import; see Recording::SetStorage(). stfio::float64 keeps them
+ *         as the importer has left them.
  *  \return true if the file has successfully been read, false otherwise.
  */
 StfioDll bool 
@@ -200,7 +222,56 @@ importFile(
         stfio::filetype type,
         Recording& ReturnData,
         const stfio::txtImportSettings& txtImport,
-        stfio::ProgressInfo& progDlg
+        stfio::ProgressInfo& progDlg,
+        stfio::storagetype storage=stfio::float64
+);
+
+//! Receives the recordings read by stfio::importFiles().
+class StfioDll ImportReceiver {
+public:
+    virtual ~ImportReceiver() {}
+
+    //! Called once for every file as soon as it has been read.
+    /*! Calls are made from one thread at a time, but not necessarily from
+     *  the calling thread, and in order of completion rather than in the
+     *  order of the file names.
+     *  \param index Index of the file in the list passed to importFiles().
+     *  \param data The recording. May be swapped out; empty if the import failed.
+     *  \param error The error message if the import failed, empty otherwise.
+     *  \return false to cancel the files that haven't been started yet.
+     */
+    virtual bool Receive(std::size_t index, Recording& data, const std::string& error) = 0;
+};
+
+//! Imports several files concurrently.
+/*! Files are read by up to \e n_threads OpenMP threads. Importers that keep
+ *  global state (e.g. CFS, HDF5, ATF, biosig) still read one file at a time.
+ *  \param fNames The full path names of the files.
+ *  \param type The file type of all files, or stfio::none to guess it from
+ *         the extension of every file name (see findType()).
+ *  \param receiver Receives each recording as soon as it has been read.
+ *  \param txtImport The text import filter settings.
+ *  \param progDlg Reports the number of files that have been read so far.
+ *  \param n_threads Maximal number of files that are read at the same time;
+ *         0 uses all available cores.
+ *  \param max_bytes Limits the estimated memory of the recordings in flight,
+ *         i.e. read but not yet received. The estimate is four times the
+ *         file size. A file that doesn't fit is read by the next thread
+ *         that releases memory; 0 means no limit.
+ *  \param storage The type in which the data points of every recording
+ *         are held; see importFile().
+ *  \return The number of files that have been read successfully.
+ */
+StfioDll std::size_t
+importFiles(
+        const std::vector<std::string>& fNames,
+        stfio::filetype type,
+        ImportReceiver& receiver,
+        const stfio::txtImportSettings& txtImport,
+        stfio::ProgressInfo& progDlg,
+        int n_threads=0,
+        std::size_t max_bytes=0,
+        stfio::storagetype storage=stfio::float64
 );
 
 //! Generic file export.
@@ -0,0 +1,445 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <cmath>
+#include <stdexcept>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include "./batch.h"
+#include "./measure.h"
+#include "./fit.h"
+
+stfnum::BatchSettings::BatchSettings()
+    : baseBeg(0), baseEnd(0), baselineMethod(stfnum::mean_sd),
+      peakBeg(0), peakEnd(0), peakAtEnd(false), pM(1), direction(stfnum::both),
+      RTFactor(20), fromBase(true), slopeForThreshold(20.0),
+      latencyStartMode(stfnum::risePoint), latencyEndMode(stfnum::footPoint),
+      latencyBeg(0.0), latencyEnd(0.0),
+      pslopeBegMode(stfnum::manualPoint), pslopeEndMode(stfnum::manualPoint),
+      pslopeBeg(0), pslopeEnd(0), deltaT(0),
+      fitBeg(0), fitEnd(0), startFitAtPeak(false), fitFunc(NULL),
+      fitOpts(6), useScaling(false), crossingThreshold(0.0),
+      columns(colBase | colPeakBase | colRTLoHi | colT50)
+{
+    // defaults of the fit settings dialog:
+    fitOpts[0] = 1E-05;
+    fitOpts[1] = 1E-17;
+    fitOpts[2] = 1E-17;
+    fitOpts[3] = 1E-32;
+    fitOpts[4] = 64;
+    fitOpts[5] = 16;
+}
+
+stfnum::BatchResult::BatchResult()
+    : base(0.0), baseSD(0.0), threshold(0.0), thrT(-1.0), peak(0.0), maxT(0.0),
+      rtLoHi(0.0), innerRTLoHi(0.0), outerRTLoHi(0.0), halfDuration(0.0),
+      t50LeftReal(0.0), t50RightReal(0.0), maxRise(0.0), maxRiseT(0.0),
+      maxDecay(0.0), maxDecayT(0.0), latency(0.0), pslope(0.0), crossings(0),
+      params(0), chisqr(0.0), fitWarning(0), fitBeg(0), fitEnd(0), error()
+{}
+
+// Positions of the characteristic points of an event in sampling points:
+struct EventPoints {
+    double peak, rise, half, foot, threshold;
+};
+
+static double eventPoint(stfnum::event_point mode, const EventPoints& points, double manual) {
+    switch (mode) {
+     case stfnum::peakPoint:
+         return points.peak;
+     case stfnum::risePoint:
+         return points.rise;
+     case stfnum::halfPoint:
+         return points.half;
+     case stfnum::footPoint:
+         return points.foot;
+     case stfnum::thresholdPoint:
+         return points.threshold;
+     default:
+         return manual;
+    }
+}
+
+// Returns data points of a section without copying stored sections
+// into the section itself, which would not be thread-safe:
+static void sectionData(const Section& section, std::size_t begin, std::size_t end,
+                        Vector_double& buffer)
+{
+    buffer.resize(end-begin);
+    if (!buffer.empty()) {
+        section.Read(begin, buffer.size(), &buffer[0]);
+    }
+}
+
+// Locates the event in the reference section in the same way as a document
+// locates the action potential in its second channel. Stored sections are
+// measured in place by the Section overloads of the measurement functions:
+static EventPoints referencePoints(const Section& data, double dt,
+                                   const stfnum::BatchSettings& settings,
+                                   std::size_t peakEnd, std::size_t windowLength)
+{
+    const double searchRange = 100.0;
+    double var = 0.0, maxT = 0.0;
+    double base = stfnum::base(settings.baselineMethod, var, data, settings.baseBeg, settings.baseEnd);
+    double peak = stfnum::peak(data, base, settings.peakBeg, peakEnd, settings.pM,
+                               settings.direction, maxT);
+    EventPoints points;
+    points.peak = maxT;
+
+    double left = maxT-searchRange > 2.0 ? maxT-searchRange : 2.0;
+    double maxRiseY = 0.0;
+    points.rise = 0.0;
+    try {
+        stfnum::maxRise(data, left, maxT, points.rise, maxRiseY, windowLength);
+    }
+    catch (const std::out_of_range&) {
+        points.rise = 0.0;
+        left = settings.peakBeg;
+    }
+
+    std::size_t t50LeftIndex = 0, t50RightIndex = 0;
+    stfnum::t_half(data, base, peak-base, left, (double)data.size(), maxT,
+                   t50LeftIndex, t50RightIndex, points.half);
+
+    std::size_t tLoIndex = 0, tHiIndex = 0;
+    double tLoReal = 0.0;
+    double rt = stfnum::risetime(data, base, peak-base, 0.0, maxT, 0.2,
+                                 tLoIndex, tHiIndex, tLoReal);
+    points.foot = tLoReal - rt/3.0;
+
+    double thrT = -1.0;
+    stfnum::threshold(data, settings.peakBeg, peakEnd, settings.slopeForThreshold*dt,
+                      thrT, windowLength);
+    points.threshold = thrT;
+    return points;
+}
+
+stfnum::BatchResult stfnum::measureSection( const Section& section, double dt,
+                                            const BatchSettings& settings,
+                                            const Section* reference,
+                                            LMWorkspace* workspace )
+{
+    if (section.size() == 0) {
+        throw std::out_of_range("Empty section in stfnum::measureSection()");
+    }
+    BatchResult result;
+    const double SR = 1.0/dt;
+    const std::size_t peakEnd = settings.peakAtEnd ? section.size()-1 : settings.peakEnd;
+
+    // window of about 0.05 ms for computing slopes, see wxStfDoc::Measure():
+    long windowLength = lround(0.05 * SR);
+    if (windowLength < 1) windowLength = 1;
+
+    double var = 0.0;
+    result.base = stfnum::base(settings.baselineMethod, var, section, settings.baseBeg, settings.baseEnd);
+    result.baseSD = sqrt(var);
+    result.peak = stfnum::peak(section, result.base, settings.peakBeg, peakEnd, settings.pM,
+                               settings.direction, result.maxT);
+    result.threshold = stfnum::threshold(section, settings.peakBeg, peakEnd,
+                                         settings.slopeForThreshold*dt, result.thrT,
+                                         windowLength);
+
+    // amplitudes are measured either from the baseline or from the threshold:
+    double ref = result.base;
+    if (!settings.fromBase && result.thrT >= 0) {
+        ref = result.threshold;
+    }
+    double ampl = result.peak-ref;
+    double factor = settings.RTFactor*0.01;
+
+    double innerLo = NAN, innerHi = NAN, outerLo = NAN, outerHi = NAN;
+    stfnum::risetime2(section, ref, ampl, 0.0, result.maxT, factor,
+                      innerLo, innerHi, outerLo, outerHi);
+    result.innerRTLoHi = (innerHi-innerLo)*dt;
+    result.outerRTLoHi = (outerHi-outerLo)*dt;
+
+    std::size_t tLoIndex = 0, tHiIndex = 0;
+    double tLoReal = 0.0;
+    double rtLoHi = stfnum::risetime(section, ref, ampl, 0.0, result.maxT, factor,
+                                     tLoIndex, tHiIndex, tLoReal);
+    double tHiReal = tLoReal+rtLoHi;
+    result.rtLoHi = rtLoHi*dt;
+
+    std::size_t t50LeftIndex = 0, t50RightIndex = 0;
+    double halfDuration = stfnum::t_half(section, ref, ampl, 0.0, (double)section.size()-1, result.maxT,
+                                         t50LeftIndex, t50RightIndex, result.t50LeftReal);
+    result.t50RightReal = result.t50LeftReal+halfDuration;
+    result.halfDuration = halfDuration*dt;
+
+    double maxRiseY = 0.0, maxDecayY = 0.0;
+    result.maxRise = stfnum::maxRise(section, settings.peakBeg, result.maxT, result.maxRiseT,
+                                     maxRiseY, windowLength);
+    double t_half_3 = t50RightIndex + 2.0*((double)t50RightIndex-(double)t50LeftIndex);
+    double right_decay = peakEnd <= t_half_3 ? peakEnd : t_half_3+1;
+    result.maxDecay = stfnum::maxDecay(section, result.maxT, right_decay, result.maxDecayT,
+                                       maxDecayY, windowLength);
+    result.maxRise *= SR;
+    result.maxDecay *= SR;
+
+    EventPoints points;
+    points.peak = result.maxT;
+    points.rise = result.maxRiseT;
+    points.half = result.t50LeftReal;
+    points.foot = tLoReal-(tHiReal-tLoReal)/3.0;
+    points.threshold = result.thrT;
+
+    if (settings.columns & colLatency) {
+        EventPoints startPoints = points;
+        if (reference != NULL) {
+            startPoints = referencePoints(*reference, dt, settings,
+                                          settings.peakAtEnd ? reference->size()-1 : settings.peakEnd,
+                                          windowLength);
+        }
+        double latStart = eventPoint(settings.latencyStartMode, startPoints, settings.latencyBeg);
+        double latEnd = eventPoint(settings.latencyEndMode, points, settings.latencyEnd);
+        result.latency = (latEnd-latStart)*dt;
+    }
+
+#ifdef WITH_PSLOPE
+    if (settings.columns & colPSlope) {
+        int pslopeBeg = (int)eventPoint(settings.pslopeBegMode, points, (double)settings.pslopeBeg);
+        int pslopeEnd = 0;
+        if (settings.pslopeEndMode == stfnum::deltaPoint) {
+            pslopeEnd = pslopeBeg+settings.deltaT;
+        } else {
+            pslopeEnd = (int)eventPoint(settings.pslopeEndMode, points, (double)settings.pslopeEnd);
+        }
+        if (pslopeBeg < 0 || pslopeEnd < 0) {
+            throw std::out_of_range("Slope cursor out of range in stfnum::measureSection()");
+        }
+        result.pslope = stfnum::pslope(section, pslopeBeg, pslopeEnd)*SR;
+    }
+#endif
+
+    if (settings.columns & colCrossings) {
+        Vector_double buffer;
+        if (section.IsStored()) {
+            sectionData(section, 0, section.size(), buffer);
+        }
+        result.crossings = stfnum::peakIndices(section.IsStored() ? buffer : section.get(),
+                                               settings.crossingThreshold, 0).size();
+    }
+
+    if ((settings.columns & colFit) && settings.fitFunc != NULL) {
+        result.fitBeg = settings.startFitAtPeak ? (std::size_t)result.maxT : settings.fitBeg;
+        result.fitEnd = settings.fitEnd;
+        if (result.fitEnd > section.size() || result.fitBeg >= result.fitEnd) {
+            throw std::out_of_range("Fit cursors out of range in stfnum::measureSection()");
+        }
+        Vector_double x;
+        sectionData(section, result.fitBeg, result.fitEnd, x);
+        // initialize parameters from the init function, not from user input:
+        result.params.resize(settings.fitFunc->pInfo.size());
+        settings.fitFunc->init(x, result.base, result.peak, result.rtLoHi,
+                               result.halfDuration, dt, result.params);
+        std::string fitInfo;
+        LMWorkspace localWorkspace;
+        result.chisqr = stfnum::lmFit(x, dt, *settings.fitFunc, settings.fitOpts,
+                                      settings.useScaling, result.params, fitInfo,
+                                      result.fitWarning,
+                                      workspace != NULL ? *workspace : localWorkspace);
+    }
+
+    return result;
+}
+
+// Column titles in the order of stfnum::batch_column:
+static std::vector<std::string> batchTitles(const stfnum::BatchSettings& settings) {
+    std::vector<std::string> colTitles;
+    unsigned int columns = settings.columns;
+    if (columns & stfnum::colBase) {
+        colTitles.push_back("Base");
+    }
+    if (columns & stfnum::colBaseSD) {
+        colTitles.push_back("Base SD");
+    }
+    if (columns & stfnum::colThreshold) {
+        colTitles.push_back("Slope threshold");
+    }
+    if (columns & stfnum::colThresholdTime) {
+        colTitles.push_back("Slope threshold time");
+    }
+    if (columns & stfnum::colPeakZero) {
+        colTitles.push_back("Peak (from 0)");
+    }
+    if (columns & stfnum::colPeakBase) {
+        colTitles.push_back("Peak (from baseline)");
+    }
+    if (columns & stfnum::colPeakThreshold) {
+        colTitles.push_back("Peak (from threshold)");
+    }
+    if (columns & stfnum::colPeakTime) {
+        colTitles.push_back("Peak time");
+    }
+    if (columns & stfnum::colRTLoHi) {
+        colTitles.push_back("RT Lo-Hi%");
+    }
+    if (columns & stfnum::colInnerRTLoHi) {
+        colTitles.push_back("inner Rise Time Lo-Hi%");
+    }
+    if (columns & stfnum::colOuterRTLoHi) {
+        colTitles.push_back("Outer Rise Time Lo-Hi%");
+    }
+    if (columns & stfnum::colT50) {
+        colTitles.push_back("duration Amp/2");
+    }
+    if (columns & stfnum::colT50SE) {
+        colTitles.push_back("start Amp/2");
+        colTitles.push_back("end Amp/2");
+    }
+    if (columns & stfnum::colSlopes) {
+        colTitles.push_back("Max. slope rise");
+        colTitles.push_back("Max. slope decay");
+    }
+    if (columns & stfnum::colSlopeTimes) {
+        colTitles.push_back("Time of max. rise");
+        colTitles.push_back("Time of max. decay");
+    }
+    if (columns & stfnum::colLatency) {
+        colTitles.push_back("Latency");
+    }
+    if ((columns & stfnum::colFit) && settings.fitFunc != NULL) {
+        for (std::size_t n_pf=0; n_pf < settings.fitFunc->pInfo.size(); ++n_pf) {
+            colTitles.push_back(settings.fitFunc->pInfo[n_pf].desc);
+        }
+        colTitles.push_back("Fit warning code");
+    }
+#ifdef WITH_PSLOPE
+    if (columns & stfnum::colPSlope) {
+        colTitles.push_back("pSlope");
+    }
+#endif
+    if (columns & stfnum::colCrossings) {
+        colTitles.push_back("# of thr. crossings");
+    }
+    return colTitles;
+}
+
+stfnum::Table stfnum::measureBatch( const Channel& channel, const std::vector<std::size_t>& sections,
+                                    double dt, const BatchSettings& settings,
+                                    const Channel* reference,
+                                    std::vector<BatchResult>* results, int n_threads )
+{
+    std::vector<BatchResult> batch(sections.size());
+#ifdef _OPENMP
+    if (n_threads <= 0) {
+        n_threads = omp_get_num_procs();
+    }
+#pragma omp parallel num_threads(n_threads)
+#endif
+    {
+        // fits of all sections of a thread share its workspace:
+        LMWorkspace workspace;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int n_s=0; n_s < (int)sections.size(); ++n_s) {
+            try {
+                const Section* refSection = NULL;
+                if (reference != NULL) {
+                    refSection = &reference->at(sections[n_s]);
+                }
+                batch[n_s] = measureSection(channel.at(sections[n_s]), dt, settings,
+                                            refSection, &workspace);
+            }
+            catch (const std::exception& e) {
+                batch[n_s] = BatchResult();
+                batch[n_s].error = e.what();
+                if (batch[n_s].error.empty()) {
+                    batch[n_s].error = "Unknown error";
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> colTitles = batchTitles(settings);
+    Table table(sections.size(), colTitles.size());
+    for (std::size_t nCol=0; nCol < colTitles.size(); ++nCol) {
+        table.SetColLabel(nCol, colTitles[nCol]);
+    }
+
+    const unsigned int columns = settings.columns;
+    for (std::size_t n_s=0; n_s < sections.size(); ++n_s) {
+        const BatchResult& r = batch[n_s];
+        table.SetRowLabel(n_s, channel.at(sections[n_s]).GetSectionDescription());
+        if (!r.error.empty()) {
+            for (std::size_t nCol=0; nCol < colTitles.size(); ++nCol) {
+                table.SetEmpty(n_s, nCol);
+            }
+            continue;
+        }
+        std::size_t nCol=0;
+        if (columns & colBase)
+            table.at(n_s,nCol++) = r.base;
+        if (columns & colBaseSD)
+            table.at(n_s,nCol++) = r.baseSD;
+        if (columns & colThreshold)
+            table.at(n_s,nCol++) = r.threshold;
+        if (columns & colThresholdTime)
+            table.at(n_s,nCol++) = r.thrT*dt;
+        if (columns & colPeakZero)
+            table.at(n_s,nCol++) = r.peak;
+        if (columns & colPeakBase)
+            table.at(n_s,nCol++) = r.peak-r.base;
+        if (columns & colPeakThreshold)
+            table.at(n_s,nCol++) = r.peak-r.threshold;
+        if (columns & colPeakTime)
+            table.at(n_s,nCol++) = r.maxT*dt;
+        if (columns & colRTLoHi)
+            table.at(n_s,nCol++) = r.rtLoHi;
+        if (columns & colInnerRTLoHi)
+            table.at(n_s,nCol++) = r.innerRTLoHi;
+        if (columns & colOuterRTLoHi)
+            table.at(n_s,nCol++) = r.outerRTLoHi;
+        if (columns & colT50)
+            table.at(n_s,nCol++) = r.halfDuration;
+        if (columns & colT50SE) {
+            table.at(n_s,nCol++) = r.t50LeftReal*dt;
+            table.at(n_s,nCol++) = r.t50RightReal*dt;
+        }
+        if (columns & colSlopes) {
+            table.at(n_s,nCol++) = r.maxRise;
+            table.at(n_s,nCol++) = r.maxDecay;
+        }
+        if (columns & colSlopeTimes) {
+            table.at(n_s,nCol++) = r.maxRiseT*dt;
+            table.at(n_s,nCol++) = r.maxDecayT*dt;
+        }
+        if (columns & colLatency)
+            table.at(n_s,nCol++) = r.latency;
+        if ((columns & colFit) && settings.fitFunc != NULL) {
+            for (std::size_t n_pf=0; n_pf < r.params.size(); ++n_pf) {
+                table.at(n_s,nCol++) = r.params[n_pf];
+            }
+            if (r.fitWarning != 0) {
+                table.at(n_s,nCol++) = (double)r.fitWarning;
+            } else {
+                table.SetEmpty(n_s,nCol++);
+            }
+        }
+#ifdef WITH_PSLOPE
+        if (columns & colPSlope)
+            table.at(n_s,nCol++) = r.pslope;
+#endif
+        if (columns & colCrossings)
+            table.at(n_s,nCol++) = (double)r.crossings;
+    }
+
+    if (results != NULL) {
+        results->swap(batch);
+    }
+    return table;
+}
@@ -0,0 +1,187 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file batch.h
+ *  \brief Batch measurements of many sections that don't depend on a document.
+ */
+
+#ifndef _STFNUM_BATCH_H
+#define _STFNUM_BATCH_H
+
+#include <vector>
+#include <string>
+
+#include "./stfnum.h"
+#include "./fit.h"
+
+namespace stfnum {
+
+/*! \addtogroup stfgen
+ *  @{
+ */
+
+//! Points of an event that the latency and slope cursors can be set to.
+/*! The first five values correspond to stf::latency_mode.
+ */
+enum event_point {
+    manualPoint = 0,    /*!< A fixed position given in the settings. */
+    peakPoint = 1,      /*!< The peak. */
+    risePoint = 2,      /*!< The maximal slope of rise. */
+    halfPoint = 3,      /*!< The half-maximal amplitude during the rise. */
+    footPoint = 4,      /*!< The beginning of the event, extrapolated from the rise time. */
+    thresholdPoint = 5, /*!< The crossing of the slope threshold. */
+    deltaPoint = 6      /*!< A fixed distance from the start cursor (slope end cursor only). */
+};
+
+//! Columns of the table returned by stfnum::measureBatch().
+/*! Combine with bitwise or; the columns appear in the order given here.
+ */
+enum batch_column {
+    colBase          = 1 << 0,  /*!< Baseline. */
+    colBaseSD        = 1 << 1,  /*!< Standard deviation of the baseline. */
+    colThreshold     = 1 << 2,  /*!< Value at the slope threshold crossing. */
+    colThresholdTime = 1 << 3,  /*!< Time of the slope threshold crossing. */
+    colPeakZero      = 1 << 4,  /*!< Peak measured from 0. */
+    colPeakBase      = 1 << 5,  /*!< Peak measured from the baseline. */
+    colPeakThreshold = 1 << 6,  /*!< Peak measured from the threshold. */
+    colPeakTime      = 1 << 7,  /*!< Time of the peak. */
+    colRTLoHi        = 1 << 8,  /*!< Lo-Hi% rise time. */
+    colInnerRTLoHi   = 1 << 9,  /*!< Inner Lo-Hi% rise time. */
+    colOuterRTLoHi   = 1 << 10, /*!< Outer Lo-Hi% rise time. */
+    colT50           = 1 << 11, /*!< Half duration. */
+    colT50SE         = 1 << 12, /*!< Start and end of the half duration. */
+    colSlopes        = 1 << 13, /*!< Maximal slopes of rise and decay. */
+    colSlopeTimes    = 1 << 14, /*!< Times of the maximal slopes of rise and decay. */
+    colLatency       = 1 << 15, /*!< Latency. */
+    colFit           = 1 << 16, /*!< Best-fit parameters and fit warning code. */
+    colPSlope        = 1 << 17, /*!< Slope between the slope cursors. */
+    colCrossings     = 1 << 18  /*!< Number of threshold crossings. */
+};
+
+//! Cursor and measurement settings of a batch analysis.
+/*! Cursor positions are given in sampling points, slopes in y units per
+ *  x unit. The constructor sets the defaults of a new document.
+ */
+struct StfioDll BatchSettings {
+    //! Default constructor
+    BatchSettings();
+
+    std::size_t baseBeg;            /*!< Start of the baseline window. */
+    std::size_t baseEnd;            /*!< End of the baseline window. */
+    stfnum::baseline_method baselineMethod; /*!< Method used to compute the baseline. */
+    std::size_t peakBeg;            /*!< Start of the peak window. */
+    std::size_t peakEnd;            /*!< End of the peak window. */
+    bool peakAtEnd;                 /*!< Whether the peak window extends to the end of each section. */
+    int pM;                         /*!< Number of points averaged around the peak. */
+    stfnum::direction direction;    /*!< Direction of the peak. */
+    int RTFactor;                   /*!< Lower rise time limit in percent, e.g. 20 for 20-80%. */
+    bool fromBase;                  /*!< Measure amplitudes from the baseline rather than from the threshold. */
+    double slopeForThreshold;       /*!< Slope that defines the threshold. */
+    event_point latencyStartMode;   /*!< Start of the latency, taken from the reference section. */
+    event_point latencyEndMode;     /*!< End of the latency. */
+    double latencyBeg;              /*!< Start of the latency for stfnum::manualPoint. */
+    double latencyEnd;              /*!< End of the latency for stfnum::manualPoint. */
+    event_point pslopeBegMode;      /*!< Start of the slope window. */
+    event_point pslopeEndMode;      /*!< End of the slope window. */
+    std::size_t pslopeBeg;          /*!< Start of the slope window for stfnum::manualPoint. */
+    std::size_t pslopeEnd;          /*!< End of the slope window for stfnum::manualPoint. */
+    int deltaT;                     /*!< Length of the slope window for stfnum::deltaPoint. */
+    std::size_t fitBeg;             /*!< Start of the fit window. */
+    std::size_t fitEnd;             /*!< End of the fit window (not included). */
+    bool startFitAtPeak;            /*!< Whether the fit window starts at the peak. */
+    const stfnum::storedFunc* fitFunc; /*!< Function to be fitted, or NULL. */
+    Vector_double fitOpts;          /*!< Options passed to stfnum::lmFit(). */
+    bool useScaling;                /*!< Whether to scale the data before fitting. */
+    double crossingThreshold;       /*!< Threshold for counting crossings. */
+    unsigned int columns;           /*!< The columns to be reported, see stfnum::batch_column. */
+};
+
+//! Results of measuring a single section.
+/*! Times are given in units of sampling points unless noted otherwise.
+ */
+struct StfioDll BatchResult {
+    //! Default constructor
+    BatchResult();
+
+    double base;         /*!< Baseline. */
+    double baseSD;       /*!< Standard deviation of the baseline. */
+    double threshold;    /*!< Value at the slope threshold crossing. */
+    double thrT;         /*!< Time of the slope threshold crossing; negative if there is none. */
+    double peak;         /*!< Peak, measured from 0. */
+    double maxT;         /*!< Time of the peak. */
+    double rtLoHi;       /*!< Lo-Hi% rise time in x units. */
+    double innerRTLoHi;  /*!< Inner Lo-Hi% rise time in x units. */
+    double outerRTLoHi;  /*!< Outer Lo-Hi% rise time in x units. */
+    double halfDuration; /*!< Half duration in x units. */
+    double t50LeftReal;  /*!< Start of the half duration. */
+    double t50RightReal; /*!< End of the half duration. */
+    double maxRise;      /*!< Maximal slope of rise in y units per x unit. */
+    double maxRiseT;     /*!< Time of the maximal slope of rise. */
+    double maxDecay;     /*!< Maximal slope of decay in y units per x unit. */
+    double maxDecayT;    /*!< Time of the maximal slope of decay. */
+    double latency;      /*!< Latency in x units. */
+    double pslope;       /*!< Slope between the slope cursors in y units per x unit. */
+    std::size_t crossings; /*!< Number of threshold crossings. */
+    Vector_double params;  /*!< Best-fit parameters; empty if no function was fitted. */
+    double chisqr;       /*!< Sum of squared errors of the fit. */
+    int fitWarning;      /*!< Warning code of the fit. */
+    std::size_t fitBeg;  /*!< Start of the fit window that was used. */
+    std::size_t fitEnd;  /*!< End of the fit window that was used. */
+    std::string error;   /*!< Error message if the measurement failed, empty otherwise. */
+};
+
+//! Measures a single section.
+/*! Computes the same values as the cursor measurements of a document, but
+ *  only depends on its arguments, so that it can be called from several
+ *  threads at the same time. Throws std::out_of_range if a cursor exceeds
+ *  the section and passes on exceptions thrown by the fit.
+ *  \param section The section to be measured.
+ *  \param dt The sampling interval.
+ *  \param settings The cursor and measurement settings.
+ *  \param reference A section of another channel whose event marks the
+ *         start of the latency, or NULL to use \e section itself.
+ *  \param workspace Buffers for the fit that are reused across sections,
+ *         or NULL to allocate them for this section only.
+ *  \return The results.
+ */
+StfioDll BatchResult measureSection( const Section& section, double dt,
+                                     const BatchSettings& settings,
+                                     const Section* reference=NULL,
+                                     LMWorkspace* workspace=NULL );
+
+//! Measures several sections of a channel.
+/*! The sections are distributed across threads if OpenMP is available.
+ *  Cells of sections that couldn't be measured are left empty; their
+ *  error messages are available from \e results.
+ *  \param channel The channel.
+ *  \param sections Indices of the sections to be measured.
+ *  \param dt The sampling interval.
+ *  \param settings The cursor and measurement settings.
+ *  \param reference A channel whose events mark the start of the latency,
+ *         or NULL to use \e channel itself.
+ *  \param results If not NULL, receives the results of each section.
+ *  \param n_threads Maximal number of threads; 0 uses all available cores.
+ *  \return A table with one row per section and the columns
+ *          selected in \e settings.
+ */
+StfioDll Table measureBatch( const Channel& channel, const std::vector<std::size_t>& sections,
+                             double dt, const BatchSettings& settings,
+                             const Channel* reference=NULL,
+                             std::vector<BatchResult>* results=NULL, int n_threads=0 );
+
+/*@}*/
+
+}
+
+#endif
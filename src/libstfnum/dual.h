@@ -0,0 +1,256 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file dual.h
+ *  \brief Dual numbers for computing exact Jacobians of fit functions.
+ */
+
+#ifndef _STFNUM_DUAL_H
+#define _STFNUM_DUAL_H
+
+#include <cmath>
+#include <stdexcept>
+#include "./stfnum.h"
+
+namespace stfnum {
+
+/*! \addtogroup stfgen
+ *  @{
+ */
+
+//! A dual number for forward-mode automatic differentiation.
+/*! Carries a value and its partial derivatives with respect to \e N
+ *  variables. Arithmetic on dual numbers applies the chain rule, so that
+ *  a model written as a template for doubles and dual numbers yields its
+ *  exact gradient in a single evaluation.
+ */
+template <std::size_t N>
+struct Dual {
+    //! Constructs a constant.
+    /*! \param v_ The value.
+     */
+    Dual(double v_=0.0) : v(v_) {
+        for (std::size_t i=0; i<N; ++i) d[i]=0.0;
+    }
+
+    //! Constructs the \e i -th independent variable.
+    /*! \param v_ The value.
+     *  \param i Index of the variable; its derivative is set to 1.
+     */
+    Dual(double v_, std::size_t i) : v(v_) {
+        for (std::size_t k=0; k<N; ++k) d[k]=0.0;
+        d[i]=1.0;
+    }
+
+    double v;    /*!< The value. */
+    double d[N]; /*!< The partial derivatives. */
+
+    // The elementary functions are only found by argument-dependent lookup,
+    // so that they don't hide those for doubles in namespace stfnum:
+
+    //! Exponential function of a dual number.
+    friend Dual exp(const Dual& a) {
+        double e=std::exp(a.v);
+        return a.chain(e, e);
+    }
+
+    //! Natural logarithm of a dual number.
+    friend Dual log(const Dual& a) {
+        return a.chain(std::log(a.v), 1.0/a.v);
+    }
+
+    //! Square root of a dual number.
+    friend Dual sqrt(const Dual& a) {
+        double s=std::sqrt(a.v);
+        return a.chain(s, 0.5/s);
+    }
+
+    //! Power of a dual number with a constant exponent.
+    friend Dual pow(const Dual& a, double b) {
+        double p=std::pow(a.v, b-1.0);
+        return a.chain(p*a.v, b*p);
+    }
+
+private:
+    // Applies a function with value f and derivative df at v:
+    Dual chain(double f, double df) const {
+        Dual r(f);
+        for (std::size_t i=0; i<N; ++i) r.d[i]=df*d[i];
+        return r;
+    }
+};
+
+//! Unary minus.
+template <std::size_t N>
+inline Dual<N> operator-(const Dual<N>& a) {
+    Dual<N> r(-a.v);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=-a.d[i];
+    return r;
+}
+
+//! Sum of two dual numbers.
+template <std::size_t N>
+inline Dual<N> operator+(const Dual<N>& a, const Dual<N>& b) {
+    Dual<N> r(a.v+b.v);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=a.d[i]+b.d[i];
+    return r;
+}
+
+//! Sum of a dual number and a constant.
+template <std::size_t N>
+inline Dual<N> operator+(const Dual<N>& a, double b) {
+    Dual<N> r(a);
+    r.v+=b;
+    return r;
+}
+
+//! Sum of a constant and a dual number.
+template <std::size_t N>
+inline Dual<N> operator+(double a, const Dual<N>& b) {
+    return b+a;
+}
+
+//! Difference of two dual numbers.
+template <std::size_t N>
+inline Dual<N> operator-(const Dual<N>& a, const Dual<N>& b) {
+    Dual<N> r(a.v-b.v);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=a.d[i]-b.d[i];
+    return r;
+}
+
+//! Difference of a dual number and a constant.
+template <std::size_t N>
+inline Dual<N> operator-(const Dual<N>& a, double b) {
+    Dual<N> r(a);
+    r.v-=b;
+    return r;
+}
+
+//! Difference of a constant and a dual number.
+template <std::size_t N>
+inline Dual<N> operator-(double a, const Dual<N>& b) {
+    Dual<N> r(-b);
+    r.v+=a;
+    return r;
+}
+
+//! Product of two dual numbers.
+template <std::size_t N>
+inline Dual<N> operator*(const Dual<N>& a, const Dual<N>& b) {
+    Dual<N> r(a.v*b.v);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=a.d[i]*b.v+a.v*b.d[i];
+    return r;
+}
+
+//! Product of a dual number and a constant.
+template <std::size_t N>
+inline Dual<N> operator*(const Dual<N>& a, double b) {
+    Dual<N> r(a.v*b);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=a.d[i]*b;
+    return r;
+}
+
+//! Product of a constant and a dual number.
+template <std::size_t N>
+inline Dual<N> operator*(double a, const Dual<N>& b) {
+    return b*a;
+}
+
+//! Quotient of two dual numbers.
+template <std::size_t N>
+inline Dual<N> operator/(const Dual<N>& a, const Dual<N>& b) {
+    double inv=1.0/b.v;
+    Dual<N> r(a.v*inv);
+    for (std::size_t i=0; i<N; ++i) r.d[i]=(a.d[i]-r.v*b.d[i])*inv;
+    return r;
+}
+
+//! Quotient of a dual number and a constant.
+template <std::size_t N>
+inline Dual<N> operator/(const Dual<N>& a, double b) {
+    return a*(1.0/b);
+}
+
+//! Quotient of a constant and a dual number.
+template <std::size_t N>
+inline Dual<N> operator/(double a, const Dual<N>& b) {
+    double inv=1.0/b.v;
+    Dual<N> r(a*inv);
+    double c=-r.v*inv;
+    for (std::size_t i=0; i<N; ++i) r.d[i]=c*b.d[i];
+    return r;
+}
+
+//! Comparisons only take the values into account.
+template <std::size_t N>
+inline bool operator<(const Dual<N>& a, const Dual<N>& b) { return a.v<b.v; }
+template <std::size_t N>
+inline bool operator<(const Dual<N>& a, double b) { return a.v<b; }
+template <std::size_t N>
+inline bool operator<(double a, const Dual<N>& b) { return a<b.v; }
+template <std::size_t N>
+inline bool operator>(const Dual<N>& a, const Dual<N>& b) { return a.v>b.v; }
+template <std::size_t N>
+inline bool operator>(const Dual<N>& a, double b) { return a.v>b; }
+template <std::size_t N>
+inline bool operator>(double a, const Dual<N>& b) { return a>b.v; }
+
+//! Computes the Jacobian of a model by automatic differentiation.
+/*! \param f A function object whose templated
+ *         <tt>T operator()(double x, const T* p) const</tt> evaluates the
+ *         model for <tt>T = double</tt> and <tt>T = stfnum::Dual<N></tt>.
+ *  \param x Function argument.
+ *  \param p A valarray of \e N parameters.
+ *  \return A valarray \e j of size \e N, where \e j[i] contains the
+ *          derivative with respect to \e p[i].
+ */
+template <std::size_t N, class Model>
+Vector_double dualJac(const Model& f, double x, const Vector_double& p) {
+    if (p.size()!=N) {
+        throw std::out_of_range("Wrong number of parameters in stfnum::dualJac()");
+    }
+    Dual<N> pd[N];
+    for (std::size_t i=0; i<N; ++i) pd[i]=Dual<N>(p[i], i);
+    Dual<N> y=f(x, pd);
+    return Vector_double(y.d, y.d+N);
+}
+
+//! Computes the Jacobian of a model at equally spaced points by automatic differentiation.
+/*! \param f A function object as in stfnum::dualJac().
+ *  \param x0 x-value of the first point.
+ *  \param dx Spacing between points.
+ *  \param n Number of points.
+ *  \param p A valarray of \e N parameters.
+ *  \param j Receives \e n rows of \e N derivatives.
+ */
+template <std::size_t N, class Model>
+void dualJacArray(const Model& f, double x0, double dx, std::size_t n,
+                  const Vector_double& p, double* j)
+{
+    if (p.size()!=N) {
+        throw std::out_of_range("Wrong number of parameters in stfnum::dualJacArray()");
+    }
+    Dual<N> pd[N];
+    for (std::size_t i=0; i<N; ++i) pd[i]=Dual<N>(p[i], i);
+    for (std::size_t n_x=0; n_x<n; ++n_x, j+=N) {
+        Dual<N> y=f(x0+(double)n_x*dx, pd);
+        for (std::size_t i=0; i<N; ++i) j[i]=y.d[i];
+    }
+}
+
+/*@}*/
+
+}
+
+#endif
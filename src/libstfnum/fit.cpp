@@ -17,27 +17,30 @@
 
 #include <float.h>
 #include <cmath>
+#include <algorithm>
 
 namespace stfnum {
 // C-style functions for Lourakis' routines:
 void c_func_lour(double *p, double* hx, int m, int n, void *adata);
 void c_jac_lour(double *p, double *j, int m, int n, void *adata);
 
-// Helper functions for lmFit to store the function at global scope:
-void saveFunc(stfnum::Func func);
-void saveJac(stfnum::Jac jac);
-
 // A struct that will be passed as a pointer to
 // Lourakis' C-functions. It is used to:
 // (1) specify which parameters are to be fitted, and
 // (2) pass the constant parameters
 // (3) the sampling interval
+// (4) the function and its Jacobian
+// (5) buffers for the full parameter set and the full Jacobian, so that
+//     no memory needs to be allocated while iterating
+// Since everything is passed per call, several fits can run at the same time.
 struct fitInfo {
     fitInfo(const std::deque<bool>& fit_p_arg,
             const Vector_double& const_p_arg,
-            double dt_arg)
+            double dt_arg,
+            const stfnum::storedFunc& fitFunc_arg,
+            Vector_double& jac_f_arg)
         :   fit_p(fit_p_arg), const_p(const_p_arg),
-            dt(dt_arg)
+            dt(dt_arg), fitFunc(fitFunc_arg), p_f(fit_p_arg.size()), jac_f(jac_f_arg)
     {}
 
     // Specifies for each parameter whether the client
@@ -50,44 +53,42 @@ struct fitInfo {
 
     // sampling interval
     double dt;
-};
-}
 
-// Functions stored at global scope to be called by c_func_lour
-// and c_jac_lour
-stfnum::Func func_lour;
-stfnum::Jac jac_lour; 
+    // The function to be fitted and its Jacobian:
+    const stfnum::storedFunc& fitFunc;
 
-void stfnum::saveFunc(stfnum::Func func) {
-    func_lour=func;
-}
+    // All parameters, including constants:
+    Vector_double p_f;
 
-void stfnum::saveJac(stfnum::Jac jac) {
-    jac_lour=jac;
+    // The Jacobian with respect to all parameters, including constants;
+    // owned by the stfnum::LMWorkspace of the fit:
+    Vector_double& jac_f;
+};
 }
 
-void stfnum::c_func_lour(double *p, double* hx, int m, int n, void *adata) {
-    // m: the number of parameters that are to be fitted
-    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
-    //		  and (2) contains the constant parameters
-    fitInfo *fInfo=static_cast<fitInfo*>(adata);
+// Merges the fitted parameters in *p with the constants into fInfo->p_f:
+static void mergeParams(double *p, stfnum::fitInfo *fInfo) {
     // total number of parameters, including constants:
     int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
     for (int n_tp=0, n_p=0, n_f=0;n_tp<tot_p;++n_tp) {
         // if the parameter needs to be fitted...
         if (fInfo->fit_p[n_tp]) {
             // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
+            fInfo->p_f[n_tp] = p[n_p++];
         } else {
             // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
+            fInfo->p_f[n_tp] = fInfo->const_p[n_f++];
         }
     }
-    for (int n_x=0;n_x<n;++n_x) {
-        hx[n_x]=func_lour( (double)n_x*fInfo->dt, p_f);
-    }	
+}
+
+void stfnum::c_func_lour(double *p, double* hx, int m, int n, void *adata) {
+    // m: the number of parameters that are to be fitted
+    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
+    //		  and (2) contains the constant parameters
+    fitInfo *fInfo=static_cast<fitInfo*>(adata);
+    mergeParams(p, fInfo);
+    fInfo->fitFunc.EvalFunc(0.0, fInfo->dt, n, fInfo->p_f, hx);
 }
 
 void stfnum::c_jac_lour(double *p, double *jac, int m, int n, void *adata) {
@@ -95,34 +96,44 @@ void stfnum::c_jac_lour(double *p, double *jac, int m, int n, void *adata) {
     // adata: pointer to a struct that (1) specifies which parameters are to be fitted
     //		  and (2) contains the constant parameters
     fitInfo *fInfo=static_cast<fitInfo*>(adata);
+    mergeParams(p, fInfo);
     // total number of parameters, including constants:
     int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
-    for (int n_tp=0,n_p=0,n_f=0;n_tp<tot_p;++n_tp) {
-        // if the parameter needs to be fitted...
-        if (fInfo->fit_p[n_tp]) {
-            // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
-        } else {
-            // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
-        }
+    if (m==tot_p) {
+        // all parameters are fitted; the layout is the one that levmar expects:
+        fInfo->fitFunc.EvalJac(0.0, fInfo->dt, n, fInfo->p_f, jac);
+        return;
     }
+    // jac_f will contain the derivatives of all parameters,
+    // including the constants...
+    fInfo->jac_f.resize((std::size_t)n*tot_p);
+    fInfo->fitFunc.EvalJac(0.0, fInfo->dt, n, fInfo->p_f, &fInfo->jac_f[0]);
     for (int n_x=0,n_j=0;n_x<n;++n_x) {
-        // jac_f will calculate the derivatives of all parameters,
-        // including the constants...
-        Vector_double jac_f(jac_lour((double)n_x*fInfo->dt,p_f));
         // ... but we only need the derivatives of the non-constants...
         for (int n_tp=0;n_tp<tot_p;++n_tp) {
             // ... hence, we will eliminate the derivatives of the constants:
             if (fInfo->fit_p[n_tp]) {
-                jac[n_j++]=jac_f[n_tp];
+                jac[n_j++]=fInfo->jac_f[n_x*tot_p+n_tp];
             }
         }
     }
 }
 
+stfnum::LMWorkspace::LMWorkspace(bool want_covar_arg)
+    : want_covar(want_covar_arg), covar(), work(), covar_pass(), data(), jac()
+{}
+
+void stfnum::LMWorkspace::reserve(std::size_t n_params, std::size_t n_data) {
+    // dlevmar_dif needs the largest amount of working memory:
+    std::size_t worksz = std::max<std::size_t>(LM_DIF_WORKSZ(n_params, n_data),
+                                               LM_BC_DER_WORKSZ(n_params, n_data));
+    if (work.size() < worksz) work.resize(worksz);
+    if (want_covar && covar_pass.size() < n_params*n_params) {
+        covar_pass.resize(n_params*n_params);
+    }
+    data.reserve(n_data);
+}
+
 Vector_double stfnum::get_scale(Vector_double& data, double oldx) {
     Vector_double xyscale(4);
 
@@ -147,8 +158,7 @@ Vector_double stfnum::get_scale(Vector_double& data, double oldx) {
     amp = ymax - ymin;
     off = ymin / amp;
 
-    data = stfio::vec_scal_mul(data, 1.0 / amp);
-    data = stfio::vec_scal_minus(data, off);
+    stfio::vec_affine(data, 1.0 / amp, -off);
 
     xyscale[0] = 1.0/(data.size()*oldx);
     xyscale[1] = 0;
@@ -162,6 +172,16 @@ double stfnum::lmFit( const Vector_double& data, double dt,
                    const stfnum::storedFunc& fitFunc, const Vector_double& opts,
                    bool use_scaling,
                    Vector_double& p, std::string& info, int& warning )
+{
+    LMWorkspace workspace;
+    return lmFit(data, dt, fitFunc, opts, use_scaling, p, info, warning, workspace);
+}
+
+double stfnum::lmFit( const Vector_double& data, double dt,
+                   const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                   bool use_scaling,
+                   Vector_double& p, std::string& info, int& warning,
+                   LMWorkspace& workspace )
 {
     // Basic range checking:
     if (fitFunc.pInfo.size()!=p.size()) {
@@ -197,12 +217,10 @@ double stfnum::lmFit( const Vector_double& data, double dt,
         }
     }
 
-    // Store the functions at global scope:
-    saveFunc(fitFunc.func);
-    saveJac(fitFunc.jac);
-
     double info_id[LM_INFO_SZ];
-    Vector_double data_ptr(data);
+    // assign() keeps the memory of previous fits:
+    Vector_double& data_ptr = workspace.data;
+    data_ptr.assign(data.begin(), data.end());
     Vector_double xyscale(4);
     if (can_scale) {
         xyscale = get_scale(data_ptr, dt);
@@ -245,7 +263,16 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     if (can_scale)
         dt_finfo = 1.0/data_ptr.size();
 
-    fitInfo fInfo( p_fit_bool, p_const, dt_finfo );
+    fitInfo fInfo( p_fit_bool, p_const, dt_finfo, fitFunc, workspace.jac );
+
+    // Allocate the memory for all passes at once:
+    workspace.reserve( fitFunc.pInfo.size(), data.size() );
+    double* work = workspace.work.empty() ? NULL : &workspace.work[0];
+    double* covar = NULL;
+    workspace.covar.clear();
+    if (workspace.want_covar && n_fitted != 0) {
+        covar = &workspace.covar_pass[0];
+    }
 
     // make l-value of opts:
     Vector_double opts_l(5);
@@ -289,22 +316,22 @@ double stfnum::lmFit( const Vector_double& data, double dt,
                 if ( !constrained ) {
                     dlevmar_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            work, covar, &fInfo );
                 } else {
                     dlevmar_bc_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), &constrains_lm_lb[0], &constrains_lm_ub[0], NULL,
-                            (int)opts[4], &opts_l[0], info_id, NULL, NULL, &fInfo );
+                            (int)opts[4], &opts_l[0], info_id, work, covar, &fInfo );
                 }
             } else {
                 if ( !constrained ) {
                     dlevmar_der( c_func_lour, c_jac_lour, &p_toFit[0], &data_ptr[0], 
                             n_fitted, (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );                
+                            work, covar, &fInfo );                
                 } else {
                     dlevmar_bc_der( c_func_lour,  c_jac_lour, &p_toFit[0], 
                             &data_ptr[0], n_fitted, (int)data.size(), &constrains_lm_lb[0], 
                             &constrains_lm_ub[0], NULL, (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            work, covar, &fInfo );
                 }
             }
             it++;
@@ -320,6 +347,10 @@ double stfnum::lmFit( const Vector_double& data, double dt,
                     p_toFit = old_p_toFit;
                     break;
                 }
+                if (covar != NULL) {
+                    // keep the covariance matrix of the accepted parameters:
+                    workspace.covar.assign(covar, covar + n_fitted*n_fitted);
+                }
                 if ( dchisqr < 1e-5 ) {
                     // Keep current results and exit if change in chisqr is below threshold
                     break;
@@ -403,6 +434,50 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     return info_id[1];
 }
 
+Vector_double stfnum::lmFitBatch( const std::vector<Vector_double>& data, double dt,
+                                const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                                bool use_scaling, std::vector<Vector_double>& p,
+                                std::vector<std::string>& info, std::vector<int>& warning )
+{
+    if (p.size()!=data.size()) {
+        std::string msg("Error in stfnum::lmFitBatch()\n"
+                "number of parameter sets and data sets differ");
+        throw std::runtime_error(msg);
+    }
+    if ( opts.size() != 6 ) {
+        std::string msg("Error in stfnum::lmFitBatch()\n"
+                "wrong number of options");
+        throw std::runtime_error(msg);
+    }
+    Vector_double chisqr(data.size(), NAN);
+    info.assign(data.size(), std::string());
+    warning.assign(data.size(), 0);
+
+    // Exceptions must not leave an OpenMP parallel region; errors
+    // are reported per data set instead:
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        // every thread reuses its workspace for all of its fits:
+        LMWorkspace workspace;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int n_d=0; n_d<(int)data.size(); ++n_d) {
+            try {
+                chisqr[n_d] = lmFit(data[n_d], dt, fitFunc, opts, use_scaling,
+                                    p[n_d], info[n_d], warning[n_d], workspace);
+            }
+            catch (const std::exception& e) {
+                info[n_d] = e.what();
+                warning[n_d] = -1;
+            }
+        }
+    }
+    return chisqr;
+}
+
 double stfnum::flin(double x, const Vector_double& p) { return p[0]*x + p[1]; }
 
 //! Dummy function to be passed to stfnum::storedFunc for linear functions.
@@ -50,6 +50,38 @@ T linFit(
         T& c
 );
 
+//! Preallocated buffers for stfnum::lmFit().
+/*! Unless they are passed their working memory, Lourakis' routines allocate
+ *  and free it on every call, and lmFit() calls them once per pass. A workspace
+ *  owns this memory along with the covariance matrix and the scratch buffers of
+ *  lmFit(). It grows to the largest fit that it has been used for, so that it
+ *  can be reused across the passes of a fit and across the fits of many data
+ *  sets. A workspace must not be used by several threads at the same time.
+ */
+struct StfioDll LMWorkspace {
+    //! Constructor
+    /*! \param want_covar Whether lmFit() should compute the covariance matrix
+     *         of the fitted parameters.
+     */
+    explicit LMWorkspace(bool want_covar=false);
+
+    //! Reserves memory for fits of up to \e n_params parameters to \e n_data points.
+    /*! \param n_params Number of parameters, including constants.
+     *  \param n_data Number of data points.
+     */
+    void reserve(std::size_t n_params, std::size_t n_data);
+
+    bool want_covar;      /*!< Whether lmFit() computes the covariance matrix. */
+    Vector_double covar;  /*!< On exit from lmFit(), the covariance matrix of the
+                           *   fitted parameters (row-major, constants excluded) in
+                           *   the units used during the fit, i.e. scaled if scaling
+                           *   was used. Empty if \e want_covar is false. */
+    Vector_double work;   /*!< Working memory of Lourakis' routines. */
+    Vector_double covar_pass; /*!< Covariance matrix of the current pass. */
+    Vector_double data;   /*!< Copy of the data, scaled if scaling is used. */
+    Vector_double jac;    /*!< Jacobian with respect to all parameters, including constants. */
+};
+
 //! Uses the Levenberg-Marquardt algorithm to perform a non-linear least-squares fit.
 /*! \param data A valarray containing the data.
  *  \param dt The sampling interval of \e data.
@@ -66,6 +98,37 @@ double StfioDll lmFit(const Vector_double& data, double dt,
                       const stfnum::storedFunc& fitFunc, const Vector_double& opts,
                       bool use_scaling, Vector_double& p, std::string& info, int& warning );
 
+//! Performs a non-linear least-squares fit using preallocated buffers.
+/*! Same as above, but takes all memory that grows with the number of data
+ *  points from \e workspace, which should be reused for subsequent fits.
+ *  \param workspace Buffers for the fit; enlarged if required.
+ */
+double StfioDll lmFit(const Vector_double& data, double dt,
+                      const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                      bool use_scaling, Vector_double& p, std::string& info, int& warning,
+                      LMWorkspace& workspace );
+
+//! Fits a function to several data sets.
+/*! Each data set is fitted independently with stfnum::lmFit(). lmFit() is
+ *  reentrant, so that the fits are distributed across threads if OpenMP is available.
+ *  Each thread reuses a single stfnum::LMWorkspace for all of its fits.
+ *  \param data The data sets.
+ *  \param dt The sampling interval of all data sets.
+ *  \param fitFunc An stfnum::storedFunc to be fitted to each data set.
+ *  \param opts Options controlling Lourakis' implementation of the algorithm.
+ *  \param use_scaling Whether to scale x and y-amplitudes to 1.0
+ *  \param p One parameter set per data set. Should be set to initial guesses
+ *         on entry. Will contain the best-fit values on exit.
+ *  \param info On exit, information about why each fit stopped iterating, or
+ *         the error message if a fit failed.
+ *  \param warning On exit, the warning code of each fit; -1 if a fit failed.
+ *  \return The sum of squared errors of each fit; NaN if a fit failed.
+ */
+StfioDll Vector_double lmFitBatch( const std::vector<Vector_double>& data, double dt,
+                                   const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                                   bool use_scaling, std::vector<Vector_double>& p,
+                                   std::vector<std::string>& info, std::vector<int>& warning );
+
 //! Linear function.
 /*! \f[f(x)=p_0 x + p_1\f]
  *  \param x Function argument.
@@ -15,22 +15,26 @@
 #include <cfloat>
 #include <cmath>
 #include <sstream>
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
 
 #include "./fit.h"
 #include "./measure.h"
 #include "./funclib.h"
+#include "./dual.h"
 
 std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     std::vector< stfnum::storedFunc > funcList;
     
     // Monoexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoMExp=getParInfoExp(1);
-    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true));
+    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true,defaultOutput,fexp_array,fexp_jac_array));
 
     // Monoexponential function, offset fixed to baseline:
     parInfoMExp[2].toFit=false;
     funcList.push_back(stfnum::storedFunc("Monoexponential, offset fixed to baseline",
-                                         parInfoMExp,fexp,fexp_init,fexp_jac,true));
+                                         parInfoMExp,fexp,fexp_init,fexp_jac,true,defaultOutput,fexp_array,fexp_jac_array));
 
     // Monoexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoMExpDe(4);
@@ -39,17 +43,17 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoMExpDe[2].toFit=true; parInfoMExpDe[2].desc="tau"; parInfoMExpDe[0].scale=stfnum::xscale; parInfoMExpDe[0].unscale=stfnum::xunscale;
     parInfoMExpDe[3].toFit=true; parInfoMExpDe[3].desc="Peak"; parInfoMExpDe[0].scale=stfnum::yscale; parInfoMExpDe[0].unscale=stfnum::yunscale;
     funcList.push_back(stfnum::storedFunc("Monoexponential with delay, start fixed to baseline",
-                                         parInfoMExpDe,fexpde,fexpde_init,stfnum::nojac,false));
+                                         parInfoMExpDe,fexpde,fexpde_init,fexpde_jac,true,defaultOutput,fexpde_array,fexpde_jac_array));
 
     // Biexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoBExp=getParInfoExp(2);
     funcList.push_back(stfnum::storedFunc(
-                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,fexp_array,fexp_jac_array));
 
     // Biexponential function, offset fixed to baseline:
     parInfoBExp[4].toFit=false;
     funcList.push_back(stfnum::storedFunc("Biexponential, offset fixed to baseline",
-                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,fexp_array,fexp_jac_array));
 
     // Biexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoBExpDe(5);
@@ -63,21 +67,21 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     // parInfoBExpDe[4].constrained = true; parInfoBExpDe[4].constr_lb = 1.0e-16; parInfoBExpDe[4].constr_ub = DBL_MAX;
     funcList.push_back(stfnum::storedFunc(
                                        "Biexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoBExpDe,fexpbde,fexpbde_init,stfnum::nojac,false));
+                                       parInfoBExpDe,fexpbde,fexpbde_init,fexpbde_jac,true,defaultOutput,fexpbde_array,fexpbde_jac_array));
 
     // Triexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoTExp=getParInfoExp(3);
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,fexp_array,fexp_jac_array));
 
     // Triexponential function, free fit, different initialization:
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau));
+                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau,fexp_array,fexp_jac_array));
 
     // Triexponential function, offset fixed to baseline:
     parInfoTExp[6].toFit=false;
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,fexp_array,fexp_jac_array));
 
     // Alpha function:
     std::vector<stfnum::parInfo> parInfoAlpha(3);
@@ -85,7 +89,7 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoAlpha[1].toFit=true; parInfoAlpha[1].desc="Rate";
     parInfoAlpha[2].toFit=true; parInfoAlpha[2].desc="Offset";
     funcList.push_back(stfnum::storedFunc(
-                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true));
+                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true,defaultOutput,falpha_array,falpha_jac_array));
 
     // HH gNa function:
     std::vector<stfnum::parInfo> parInfoHH(4);
@@ -94,11 +98,11 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoHH[2].toFit=true; parInfoHH[2].desc="tau_h";
     parInfoHH[3].toFit=false; parInfoHH[3].desc="offset";
     funcList.push_back(stfnum::storedFunc(
-                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, stfnum::nojac, false));
+                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, fHH_jac, true, defaultOutput, fHH_array, fHH_jac_array));
 
     // power of 1 gNa function:
     funcList.push_back(stfnum::storedFunc(
-                                         "power of 1 g_Na function, offset fixed to baseline", parInfoHH, fgnabiexp, fgnabiexp_init, fgnabiexp_jac, true));
+                                         "power of 1 g_Na function, offset fixed to baseline", parInfoHH, fgnabiexp, fgnabiexp_init, fgnabiexp_jac, true, defaultOutput, fgnabiexp_array, fgnabiexp_jac_array));
 
     // Gaussian
     std::vector<stfnum::parInfo> parInfoGauss(3);
@@ -110,7 +114,7 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoGauss[2].desc="width"; parInfoGauss[2].scale = stfnum::xscale; parInfoGauss[2].unscale = stfnum::xunscale;
 
     funcList.push_back(stfnum::storedFunc(
-                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true));
+                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true, defaultOutput, fgauss_array, fgauss_jac_array));
 
     // Triexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoTExpDe(7);
@@ -125,11 +129,89 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoTExpDe[6].toFit=true;  parInfoTExpDe[6].desc="ptau1b"; parInfoTExpDe[6].scale=stfnum::noscale; parInfoTExpDe[6].unscale=stfnum::noscale;
     funcList.push_back(stfnum::storedFunc(
                                        "Triexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoTExpDe,fexptde,fexptde_init,stfnum::nojac,false));
+                                       parInfoTExpDe,fexptde,fexptde_init,fexptde_jac,true,defaultOutput,fexptde_array,fexptde_jac_array));
 
     return funcList;
 }
 
+// The shared function library. It is intentionally never destroyed, so that
+// pointers to its entries remain valid during static destruction; a deque
+// doesn't move its elements when new ones are appended.
+static std::deque<stfnum::storedFunc>* sharedFuncLib = NULL;
+
+// Must be called from within the critical section stfnum_funclib:
+static std::deque<stfnum::storedFunc>& sharedLib() {
+    if (sharedFuncLib == NULL) {
+        std::vector<stfnum::storedFunc> funcList = stfnum::GetFuncLib();
+        sharedFuncLib = new std::deque<stfnum::storedFunc>(funcList.begin(), funcList.end());
+    }
+    return *sharedFuncLib;
+}
+
+// Must be called from within the critical section stfnum_funclib:
+static const stfnum::storedFunc* findShared(const std::string& name) {
+    std::deque<stfnum::storedFunc>& lib = sharedLib();
+    for (std::size_t n_f=0; n_f<lib.size(); ++n_f) {
+        if (lib[n_f].name == name) {
+            return &lib[n_f];
+        }
+    }
+    return NULL;
+}
+
+std::size_t stfnum::GetFuncCount() {
+    std::size_t count = 0;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_funclib)
+#endif
+    count = sharedLib().size();
+    return count;
+}
+
+const stfnum::storedFunc& stfnum::GetFunc(std::size_t index) {
+    const stfnum::storedFunc* func = NULL;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_funclib)
+#endif
+    {
+        std::deque<stfnum::storedFunc>& lib = sharedLib();
+        if (index < lib.size()) {
+            func = &lib[index];
+        }
+    }
+    if (func == NULL) {
+        throw std::out_of_range("Function index out of range in stfnum::GetFunc()");
+    }
+    return *func;
+}
+
+const stfnum::storedFunc* stfnum::FindFunc(const std::string& name) {
+    const stfnum::storedFunc* func = NULL;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_funclib)
+#endif
+    func = findShared(name);
+    return func;
+}
+
+const stfnum::storedFunc& stfnum::RegisterFunc(const stfnum::storedFunc& func) {
+    const stfnum::storedFunc* added = NULL;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_funclib)
+#endif
+    {
+        if (findShared(func.name) == NULL) {
+            sharedLib().push_back(func);
+            added = &sharedLib().back();
+        }
+    }
+    if (added == NULL) {
+        throw std::runtime_error("A function called \"" + func.name +
+                                 "\" has already been registered");
+    }
+    return *added;
+}
+
 double stfnum::fexp(double x, const Vector_double& p) {
     double sum=0.0;
     for (std::size_t n_p=0;n_p<p.size()-1;n_p+=2) {
@@ -150,14 +232,128 @@ Vector_double stfnum::fexp_jac(double x, const Vector_double& p) {
     return jac;
 }
 
+// Compile the array evaluators for AVX2 and SSE4.2 as well as for the
+// baseline instruction set; the loader picks the best one at runtime.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && \
+    defined(__ELF__) && (defined(__x86_64__) || defined(__i386__))
+#define STFNUM_SIMD_CLONES __attribute__((target_clones("avx2","sse4.2","default")))
+#else
+#define STFNUM_SIMD_CLONES
+#endif
+
+// Number of consecutive points that share a single call to exp():
+#define EXP_BLOCK 64
+
+// Tabulates exp(-k*dx/tau) for k < n (n <= EXP_BLOCK).
+static void expStep(double dx, double tau, std::size_t n, double* step) {
+    for (std::size_t k=0;k<n;++k) {
+        step[k]=exp(-(double)k*dx/tau);
+    }
+}
+
+// Fills e[k]=exp(-(x+k*dx)/tau) for k < len (len <= EXP_BLOCK) from one exp()
+// call and the table computed by expStep(). Falls back to one exp() per point
+// if the product would leave the range of normal doubles.
+static inline void expFill(double x, double dx, double tau, const double* step,
+                           std::size_t len, double* e)
+{
+    double anchor=exp(-x/tau);
+    if (anchor>DBL_MIN && anchor<DBL_MAX && step[len-1]>DBL_MIN && step[len-1]<DBL_MAX) {
+        for (std::size_t k=0;k<len;++k) {
+            e[k]=anchor*step[k];
+        }
+    } else {
+        for (std::size_t k=0;k<len;++k) {
+            e[k]=exp(-(x+(double)k*dx)/tau);
+        }
+    }
+}
+
+// y[k] = sum_i amp[i]*exp(-(x0+k*dx)/tau[i]) + offset
+static inline void expSum(double x0, double dx, std::size_t n, const double* amp, const double* tau,
+                          std::size_t n_exp, double offset, double* y)
+{
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    Vector_double step(n_exp*EXP_BLOCK);
+    for (std::size_t n_e=0;n_e<n_exp;++n_e) {
+        expStep(dx, tau[n_e], n_step, &step[n_e*EXP_BLOCK]);
+    }
+    double e[EXP_BLOCK];
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        double x=x0+(double)n_b*dx;
+        double* yb=&y[n_b];
+        for (std::size_t k=0;k<len;++k) {
+            yb[k]=0.0;
+        }
+        for (std::size_t n_e=0;n_e<n_exp;++n_e) {
+            expFill(x, dx, tau[n_e], &step[n_e*EXP_BLOCK], len, e);
+            double a=amp[n_e];
+            for (std::size_t k=0;k<len;++k) {
+                yb[k]+=a*e[k];
+            }
+        }
+        for (std::size_t k=0;k<len;++k) {
+            yb[k]+=offset;
+        }
+    }
+}
+
+// Index of the first point at or after the delay; earlier points are set to pre.
+static std::size_t delayOnset(double x0, double dx, std::size_t n, double delay, double pre, double* y) {
+    std::size_t k0=0;
+    while (k0<n && x0+(double)k0*dx<delay) {
+        y[k0++]=pre;
+    }
+    return k0;
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fexp_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t n_exp=(p.size()-1)/2;
+    Vector_double amp(n_exp), tau(n_exp);
+    for (std::size_t n_e=0;n_e<n_exp;++n_e) {
+        amp[n_e]=p[2*n_e];
+        tau[n_e]=p[2*n_e+1];
+    }
+    expSum(x0, dx, n, &amp[0], &tau[0], n_exp, p[p.size()-1], y);
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fexp_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    std::size_t n_par=p.size();
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step[EXP_BLOCK], e[EXP_BLOCK];
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        j[n_x*n_par+n_par-1]=1.0;
+    }
+    for (std::size_t n_p=0;n_p<n_par-1;n_p+=2) {
+        double tau=p[n_p+1];
+        double c=p[n_p]/(tau*tau);
+        expStep(dx, tau, n_step, step);
+        for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+            std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+            double x=x0+(double)n_b*dx;
+            expFill(x, dx, tau, step, len, e);
+            double* row=&j[n_b*n_par+n_p];
+            for (std::size_t k=0;k<len;++k, row+=n_par) {
+                row[0]=e[k];
+                row[1]=c*(x+(double)k*dx)*e[k];
+            }
+        }
+    }
+}
+
 void stfnum::fexp_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find out direction:
     bool increasing = data[0] < data[data.size()-1];
     Vector_double::const_iterator max_el = std::max_element(data.begin(), data.end());
     Vector_double::const_iterator min_el = std::min_element(data.begin(), data.end());
     double floor = (increasing ? (*max_el+1.0e-9) : (*min_el-1.0e-9));
-    Vector_double peeled( stfio::vec_scal_minus(data, floor));
-    if (increasing) peeled = stfio::vec_scal_mul(peeled, -1.0);
+    // (data - floor), negated if increasing, in a single pass:
+    double sign = increasing ? -1.0 : 1.0;
+    Vector_double peeled(data.size());
+    stfio::vec_affine(&data[0], data.size(), sign, -sign*floor, &peeled[0]);
     std::transform(peeled.begin(), peeled.end(), peeled.begin(),
 #if defined(_MSC_VER)
                    std::logl);
@@ -234,34 +430,76 @@ double stfnum::yunscaleoffset(double param, double xscale, double xoff, double y
     return (param+yoff)/yscale;
 }
 
-double stfnum::fexpde(double x, const Vector_double& p) {
-    if (x<p[1]) {
-        return p[0];
-    } else {
-        double e1=exp((p[1]-x)/p[2]);
-        // normalize the amplitude so that the peak really is the peak:
-        return (p[0]-p[3])*e1 + p[3];
+// The models without hand-written derivatives are written once for doubles
+// and for stfnum::Dual, so that their exact Jacobians can be computed by
+// stfnum::dualJac() in a single evaluation.
+struct ExpDeModel {
+    template <typename T>
+    T operator()(double x, const T* p) const {
+        if (x<p[1]) {
+            return p[0];
+        } else {
+            T e1=exp((p[1]-x)/p[2]);
+            // normalize the amplitude so that the peak really is the peak:
+            return (p[0]-p[3])*e1 + p[3];
+        }
+    }
+};
+
+struct ExpBDeModel {
+    template <typename T>
+    T operator()(double x, const T* p) const {
+        if (x<p[1]) {
+            return p[0];
+        } else {
+            T e1=exp((p[1]-x)/p[2]);
+            T e2=exp((p[1]-x)/p[4]);
+            return p[3]*e1 - p[3]*e2 + p[0];
+        }
+    }
+};
+
+struct ExpTDeModel {
+    template <typename T>
+    T operator()(double x, const T* p) const {
+        if (x<p[1]) {
+            return p[0];
+        } else {
+            T e1=exp((p[1]-x)/p[2]);
+            T e2=exp((p[1]-x)/p[4]);
+            T e3=exp((p[1]-x)/p[5]);
+            return p[6]*p[3]*e1 + (1.0-p[6])*p[3]*e3 - p[3]*e2 + p[0];
+        }
+    }
+};
+
+struct HHModel {
+    template <typename T>
+    T operator()(double x, const T* p) const {
+        T m = 1.0 - exp(-x/p[1]);
+        T h = exp(-x/p[2]);
+        return p[0] * (m*m*m) * h + p[3];
     }
+};
+
+double stfnum::fexpde(double x, const Vector_double& p) {
+    return ExpDeModel()(x, &p[0]);
 }
 
-#if 0
 Vector_double stfnum::fexpde_jac(double x, const Vector_double& p) {
-    Vector_double jac(4);
-    if (x<p[3]) {
-        jac[0]=1.0;
-        jac[1]=0.0;
-        jac[2]=0.0;
-        jac[3]=0.0;
-    } else {
-        double e=exp((p[3]-x)/p[1]);
-        jac[0]=e;
-        jac[1]=(p[0]-p[2])*(p[3]-x)*(-1.0/(p[1]*p[1]))*e;
-        jac[2]=-e+1.0;
-        jac[3]=(p[0]-p[2])*(1.0/p[1])*e;
-    }
-    return jac;
+    return dualJac<4>(ExpDeModel(), x, p);
+}
+
+void stfnum::fexpde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    dualJacArray<4>(ExpDeModel(), x0, dx, n, p, j);
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fexpde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t k0=delayOnset(x0, dx, n, p[1], p[0], y);
+    double amp=p[0]-p[3];
+    expSum(x0+(double)k0*dx-p[1], dx, n-k0, &amp, &p[2], 1, p[3], &y[k0]);
 }
-#endif 
 
 void stfnum::fexpde_init(const Vector_double& data, double base, double peak, double RTLoHI, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find the peak position in data:
@@ -275,55 +513,44 @@ void stfnum::fexpde_init(const Vector_double& data, double base, double peak, do
 }
 
 double stfnum::fexpbde(double x, const Vector_double& p) {
-    if (x<p[1]) {
-        return p[0];
-    } else {
-        // double tpeak = p[4]*p[2]*log(p[4]/p[2])/(p[4]-p[2]);
-        // double adjust = 1.0/((1.0-exp(-tpeak/p[4]))-(1.0-exp(-tpeak/p[2])));
-        double e1=exp((p[1]-x)/p[2]);
-        double e2=exp((p[1]-x)/p[4]);
+    return ExpBDeModel()(x, &p[0]);
+}
 
-        return p[3]*e1 - p[3]*e2 + p[0];
-    }
+Vector_double stfnum::fexpbde_jac(double x, const Vector_double& p) {
+    return dualJac<5>(ExpBDeModel(), x, p);
+}
+
+void stfnum::fexpbde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    dualJacArray<5>(ExpBDeModel(), x0, dx, n, p, j);
 }
 
 double stfnum::fexptde(double x, const Vector_double& p) {
-    if (x<p[1]) {
-        return p[0];
-    } else {
-        // double tpeak = p[4]*p[2]*log(p[4]/p[2])/(p[4]-p[2]);
-        // double adjust = 1.0/((1.0-exp(-tpeak/p[4]))-(1.0-exp(-tpeak/p[2])));
-        double e1=exp((p[1]-x)/p[2]);
-        double e2=exp((p[1]-x)/p[4]);
-        double e3=exp((p[1]-x)/p[5]);
+    return ExpTDeModel()(x, &p[0]);
+}
 
-        return p[6]*p[3]*e1 + (1.0-p[6])*p[3]*e3 - p[3]*e2 + p[0];
-    }
+Vector_double stfnum::fexptde_jac(double x, const Vector_double& p) {
+    return dualJac<7>(ExpTDeModel(), x, p);
 }
 
-#if 0
-Vector_double stfnum::fexpbde_jac(double x, const Vector_double& p) {
-    Vector_double jac(5);
-    if (x<p[1]) {
-        jac[0]=1.0;
-        jac[1]=0.0;
-        jac[2]=0.0;
-        jac[3]=0.0;
-        jac[4]=0.0;
-    } else {
-        double tpeak = p[4]*p[2]*log(p[4]/p[2])/(p[4]-p[2]);
-        double adjust = 1.0/((1.0-exp(-tpeak/p[4]))-(1.0-exp(-tpeak/p[2])));
-        double e1=exp((p[1]-x)/p[2]);
-        double e2=exp((p[1]-x)/p[4]);
-        jac[0]=1.0;
-        jac[1]=adjust*p[3]/p[2] * e1 - adjust*p[3]/p[4] * e2;
-        jac[2]=adjust*p[3]*(p[1]-x)*(-1.0/(p[2]*p[2]))*e1;
-        jac[3]=adjust*e1-adjust*e2;
-        jac[4]=adjust*p[3]*(p[1]-x)*(1.0/(p[4]*p[4]))*e2;
-    }
-    return jac;
+void stfnum::fexptde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    dualJacArray<7>(ExpTDeModel(), x0, dx, n, p, j);
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fexpbde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t k0=delayOnset(x0, dx, n, p[1], p[0], y);
+    double amp[2]={p[3], -p[3]};
+    double tau[2]={p[2], p[4]};
+    expSum(x0+(double)k0*dx-p[1], dx, n-k0, amp, tau, 2, p[0], &y[k0]);
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fexptde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t k0=delayOnset(x0, dx, n, p[1], p[0], y);
+    double amp[3]={p[6]*p[3], (1.0-p[6])*p[3], -p[3]};
+    double tau[3]={p[2], p[5], p[4]};
+    expSum(x0+(double)k0*dx-p[1], dx, n-k0, amp, tau, 3, p[0], &y[k0]);
 }
-#endif
 
 void stfnum::fexpbde_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find the peak position in data:
@@ -388,6 +615,43 @@ Vector_double stfnum::falpha_jac(double x, const Vector_double& p) {
     return jac;
 }
 
+// exp(1-x/p[1]) is evaluated as exp(-(x-p[1])/p[1]) so that the blocked
+// exponential can be used.
+STFNUM_SIMD_CLONES
+void stfnum::falpha_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step[EXP_BLOCK], e[EXP_BLOCK];
+    expStep(dx, p[1], n_step, step);
+    double c=p[0]/p[1];
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        double x=x0+(double)n_b*dx;
+        expFill(x-p[1], dx, p[1], step, len, e);
+        for (std::size_t k=0;k<len;++k) {
+            y[n_b+k]=c*(x+(double)k*dx)*e[k] + p[2];
+        }
+    }
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::falpha_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step[EXP_BLOCK], e[EXP_BLOCK];
+    expStep(dx, p[1], n_step, step);
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        double x=x0+(double)n_b*dx;
+        expFill(x-p[1], dx, p[1], step, len, e);
+        double* row=&j[n_b*3];
+        for (std::size_t k=0;k<len;++k, row+=3) {
+            double xk=x+(double)k*dx;
+            row[0]=xk*e[k]/p[1];
+            row[1]=row[0]*( xk*p[0]/(p[1]*p[1]) - p[0]/p[1] );
+            row[2]=1.0;
+        }
+    }
+}
+
 void stfnum::falpha_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
         double maxT = stfnum::whereis( data, peak )*dt;
 
@@ -405,9 +669,15 @@ double stfnum::fHH(double x, const Vector_double& p) {
     // p[1]: tau_m
     // p[2]: tau_h
     // p[3]: offset
-    double m = 1 - exp(-x/p[1]);
-    double h = exp(-x/p[2]);
-    return p[0] * (m*m*m) * h + p[3];
+    return HHModel()(x, &p[0]);
+}
+
+Vector_double stfnum::fHH_jac(double x, const Vector_double& p) {
+    return dualJac<4>(HHModel(), x, p);
+}
+
+void stfnum::fHH_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    dualJacArray<4>(HHModel(), x0, dx, n, p, j);
 }
 
 double stfnum::fgnabiexp(double x, const Vector_double& p) {
@@ -420,6 +690,70 @@ double stfnum::fgnabiexp(double x, const Vector_double& p) {
     return p[0] * m * h + p[3];
 }
 
+// Fills em[k]=exp(-(x0+k*dx)/p[1]) and eh[k]=exp(-(x0+k*dx)/p[2]) for one
+// block of the Hodgkin-Huxley type models.
+static inline void mhFill(double x, double dx, const Vector_double& p, const double* step_m,
+                          const double* step_h, std::size_t len, double* em, double* eh)
+{
+    expFill(x, dx, p[1], step_m, len, em);
+    expFill(x, dx, p[2], step_h, len, eh);
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fHH_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step_m[EXP_BLOCK], step_h[EXP_BLOCK], em[EXP_BLOCK], eh[EXP_BLOCK];
+    expStep(dx, p[1], n_step, step_m);
+    expStep(dx, p[2], n_step, step_h);
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        mhFill(x0+(double)n_b*dx, dx, p, step_m, step_h, len, em, eh);
+        for (std::size_t k=0;k<len;++k) {
+            double m=1.0-em[k];
+            y[n_b+k]=p[0] * (m*m*m) * eh[k] + p[3];
+        }
+    }
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fgnabiexp_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y) {
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step_m[EXP_BLOCK], step_h[EXP_BLOCK], em[EXP_BLOCK], eh[EXP_BLOCK];
+    expStep(dx, p[1], n_step, step_m);
+    expStep(dx, p[2], n_step, step_h);
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        mhFill(x0+(double)n_b*dx, dx, p, step_m, step_h, len, em, eh);
+        for (std::size_t k=0;k<len;++k) {
+            y[n_b+k]=p[0] * (1.0-em[k]) * eh[k] + p[3];
+        }
+    }
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fgnabiexp_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j) {
+    std::size_t n_step=std::min(n, (std::size_t)EXP_BLOCK);
+    double step_m[EXP_BLOCK], step_h[EXP_BLOCK], em[EXP_BLOCK], eh[EXP_BLOCK];
+    expStep(dx, p[1], n_step, step_m);
+    expStep(dx, p[2], n_step, step_h);
+    double c1=-p[0]/(p[1]*p[1]);
+    double c2=p[0]/(p[2]*p[2]);
+    for (std::size_t n_b=0;n_b<n;n_b+=EXP_BLOCK) {
+        std::size_t len=std::min(n-n_b, (std::size_t)EXP_BLOCK);
+        double x=x0+(double)n_b*dx;
+        mhFill(x, dx, p, step_m, step_h, len, em, eh);
+        double* row=&j[n_b*4];
+        for (std::size_t k=0;k<len;++k, row+=4) {
+            double xk=x+(double)k*dx;
+            double mh=(1.0-em[k])*eh[k];
+            row[0]=mh;
+            row[1]=c1*xk*em[k]*eh[k];
+            row[2]=c2*xk*mh;
+            row[3]=1.0;
+        }
+    }
+}
+
 double stfnum::fgauss(double x, const Vector_double& pars) {
     double y=0.0, /* fac=0.0, */ ex=0.0, arg=0.0;
     int npars=static_cast<int>(pars.size());
@@ -446,6 +780,40 @@ Vector_double stfnum::fgauss_jac(double x, const Vector_double& pars) {
     return jac;
 }
 
+// The Gaussian can't be tabulated like the exponentials, so this
+// computes one exp() per point and term, but keeps the arithmetic in flat loops.
+STFNUM_SIMD_CLONES
+void stfnum::fgauss_array(double x0, double dx, std::size_t n, const Vector_double& pars, double* y) {
+    int npars=static_cast<int>(pars.size());
+    std::fill(y, y+n, 0.0);
+    for (int i=0; i < npars-1; i += 3) {
+        double amp=pars[i], mean=pars[i+1], width=pars[i+2];
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            double arg=(x0+(double)n_x*dx-mean)/width;
+            y[n_x] += amp * exp(-arg*arg);
+        }
+    }
+}
+
+STFNUM_SIMD_CLONES
+void stfnum::fgauss_jac_array(double x0, double dx, std::size_t n, const Vector_double& pars, double* j) {
+    int npars=static_cast<int>(pars.size());
+    std::fill(j, j+n*pars.size(), 0.0);
+    for (int i=0; i < npars-1; i += 3) {
+        double amp=pars[i], mean=pars[i+1], width=pars[i+2];
+        double c=2.0*amp/(width*width);
+        double* row=&j[i];
+        for (std::size_t n_x=0;n_x<n;++n_x, row+=npars) {
+            double d=x0+(double)n_x*dx-mean;
+            double arg=d/width;
+            double ex=exp(-arg*arg);
+            row[0] = ex;
+            row[1] = c*ex*d;
+            row[2] = c*ex*d*d/width;
+        }
+    }
+}
+
 void stfnum::fgauss_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find the peak position in data:
     double maxT = stfnum::whereis( data, peak ) * dt;
@@ -63,6 +63,24 @@ namespace stfnum {
      */
     Vector_double fexp_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexp() at \e n equally spaced points.
+    /*! \param x0 x-value of the first point.
+     *  \param dx Spacing between points.
+     *  \param n Number of points.
+     *  \param p Parameters as in stfnum::fexp().
+     *  \param y Receives \e n function values.
+     */
+    void fexp_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Evaluates stfnum::fexp_jac() at \e n equally spaced points.
+    /*! \param x0 x-value of the first point.
+     *  \param dx Spacing between points.
+     *  \param n Number of points.
+     *  \param p Parameters as in stfnum::fexp().
+     *  \param j Receives \e n rows of p.size() derivatives.
+     */
+    void fexp_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
+
     //! Initialises parameters for fitting stfnum::fexp() to \e data.
     /*! This needs to be made more robust.
      *  \param data The waveform of the data for the fit.
@@ -106,44 +124,23 @@ namespace stfnum {
      */
     double fexpde(double x, const Vector_double& p);
 
-#if 0
-    //! Computes the Jacobian of stfnum::fexpde().
-    /*! \f{eqnarray*}
-     *      j_0(x)&=& \frac{df(x)}{dp_0} = 
-     *      \begin{cases}
-     *          1, & \mbox{if }x < p_3 \\ 
-     *          \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_1(x)&=& \frac{df(x)}{dp_1} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          \left( p_0-p_2 \right) \left( p_3-x \right) \frac{-1}{p_1^2} \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_2(x)&=& \frac{df(x)}{dp_2} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          1 - \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_3(x)&=& \frac{df(x)}{dp_3} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          \left( p_0-p_2 \right) \frac{1}{p_1} \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases}
-     *  \f} 
-     *  \param x Function argument.
-     *  \param p A valarray of parameters, where \n
-     *         \e p[0] is the baseline, \n
-     *         \e p[1] is the time constant, \n
-     *         \e p[2] is the amplitude and \n
-     *         \e p[3] is the delay.
-     *  \return A valarray \e j with the evaluated Jacobian, where \n
-     *          \e j[0] contains the derivative with respect to \e p[0], \n
-     *          \e j[1] contains the derivative with respect to \e p[1], \n
-     *          \e j[2] contains the derivative with respect to \e p[2] and \n
-     *          \e j[3] contains the derivative with respect to \e p[3].
+    //! Evaluates stfnum::fexpde() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void fexpde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Computes the Jacobian of stfnum::fexpde() by automatic differentiation.
+    /*! \param x Function argument.
+     *  \param p Parameters as in stfnum::fexpde().
+     *  \return A valarray \e j of size 4, where \e j[i] contains the
+     *          derivative with respect to \e p[i].
      */
     Vector_double fexpde_jac(double x, const Vector_double& p);
-#endif
+
+    //! Evaluates the Jacobian of stfnum::fexpde() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fexpde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
     
     //! Initialises parameters for fitting stfnum::fexpde() to \e data.
     /*! \param data The waveform of the data for the fit.
@@ -175,6 +172,24 @@ namespace stfnum {
      */
     double fexpbde(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexpbde() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void fexpbde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Computes the Jacobian of stfnum::fexpbde() by automatic differentiation.
+    /*! \param x Function argument.
+     *  \param p Parameters as in stfnum::fexpbde().
+     *  \return A valarray \e j of size 5, where \e j[i] contains the
+     *          derivative with respect to \e p[i].
+     */
+    Vector_double fexpbde_jac(double x, const Vector_double& p);
+
+    //! Evaluates the Jacobian of stfnum::fexpbde() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fexpbde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
+
     //! Triexponential function with delay. 
     /*! \f{eqnarray*}
      *      f(x)=
@@ -196,44 +211,23 @@ namespace stfnum {
      */
     double fexptde(double x, const Vector_double& p);
 
-#if 0
-    //! Computes the Jacobian of stfnum::fexpde().
-    /*! \f{eqnarray*}
-     *      j_0(x)&=& \frac{df(x)}{dp_0} = 
-     *      \begin{cases}
-     *          1, & \mbox{if }x < p_3 \\ 
-     *          \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_1(x)&=& \frac{df(x)}{dp_1} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          \left( p_0-p_2 \right) \left( p_3-x \right) \frac{-1}{p_1^2} \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_2(x)&=& \frac{df(x)}{dp_2} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          1 - \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases} \\
-     *      j_3(x)&=& \frac{df(x)}{dp_3} = 
-     *      \begin{cases}
-     *          0, & \mbox{if }x < p_3 \\ 
-     *          \left( p_0-p_2 \right) \frac{1}{p_1} \mathrm{e}^{\frac{p_3 - x}{p_1}}, & \mbox{if }x \geq p_3
-     *      \end{cases}
-     *  \f} 
-     *  \param x Function argument.
-     *  \param p A valarray of parameters, where \n
-     *         \e p[0] is the baseline, \n
-     *         \e p[1] is the time constant, \n
-     *         \e p[2] is the amplitude and \n
-     *         \e p[3] is the delay.
-     *  \return A valarray \e j with the evaluated Jacobian, where \n
-     *          \e j[0] contains the derivative with respect to \e p[0], \n
-     *          \e j[1] contains the derivative with respect to \e p[1], \n
-     *          \e j[2] contains the derivative with respect to \e p[2] and \n
-     *          \e j[3] contains the derivative with respect to \e p[3].
+    //! Evaluates stfnum::fexptde() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
      */
-    Vector_double fexpbde_jac(double x, const Vector_double& p);
-#endif
+    void fexptde_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Computes the Jacobian of stfnum::fexptde() by automatic differentiation.
+    /*! \param x Function argument.
+     *  \param p Parameters as in stfnum::fexptde().
+     *  \return A valarray \e j of size 7, where \e j[i] contains the
+     *          derivative with respect to \e p[i].
+     */
+    Vector_double fexptde_jac(double x, const Vector_double& p);
+
+    //! Evaluates the Jacobian of stfnum::fexptde() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fexptde_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
     
     //! Initialises parameters for fitting stfnum::fexpde() to \e data.
     /*! \param data The waveform of the data for the fit.
@@ -284,6 +278,16 @@ namespace stfnum {
      *          \e j[2] contains the derivative with respect to \e p[2].
      */
     Vector_double falpha_jac(double x, const Vector_double& p);
+
+    //! Evaluates stfnum::falpha() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void falpha_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Evaluates the Jacobian of stfnum::falpha() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void falpha_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
     
     //! Hodgkin-Huxley sodium conductance function.
     /*! \f[f(x)=p_0\left(1-\mathrm{e}^{\frac{-x}{p_1}}\right)^3\mathrm{e}^{\frac{-x}{p_2}} + p_3\f]
@@ -297,6 +301,24 @@ namespace stfnum {
      */
     double fHH(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fHH() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void fHH_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Computes the Jacobian of stfnum::fHH() by automatic differentiation.
+    /*! \param x Function argument.
+     *  \param p Parameters as in stfnum::fHH().
+     *  \return A valarray \e j of size 4, where \e j[i] contains the
+     *          derivative with respect to \e p[i].
+     */
+    Vector_double fHH_jac(double x, const Vector_double& p);
+
+    //! Evaluates the Jacobian of stfnum::fHH() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fHH_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
+
     //! Computes the sum of an arbitrary number of Gaussians.
     /*! \f[
      *      f(x) = \sum_{i=0}^{n-1}p_{3i}\mathrm{e}^{- \left( \frac{x-p_{3i+1}}{p_{3i+2}} \right) ^2}
@@ -316,6 +338,16 @@ namespace stfnum {
     //! Computes the Jacobian of a sum of Gaussians.
     Vector_double fgauss_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fgauss() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void fgauss_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Evaluates the Jacobian of stfnum::fgauss() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fgauss_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
+
     //! power of 1 sodium conductance function.
     /*! \f[f(x)=p_0\left(1-\mathrm{e}^{\frac{-x}{p_1}}\right)\mathrm{e}^{\frac{-x}{p_2}} + p_3\f]
      *  \param x Function argument.
@@ -356,6 +388,16 @@ namespace stfnum {
      */
     Vector_double fgnabiexp_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fgnabiexp() at \e n equally spaced points.
+    /*! See stfnum::fexp_array() for the arguments.
+     */
+    void fgnabiexp_array(double x0, double dx, std::size_t n, const Vector_double& p, double* y);
+
+    //! Evaluates the Jacobian of stfnum::fgnabiexp() at \e n equally spaced points.
+    /*! See stfnum::fexp_jac_array() for the arguments.
+     */
+    void fgnabiexp_jac_array(double x0, double dx, std::size_t n, const Vector_double& p, double* j);
+
     //! Initialises parameters for fitting stfnum::falpha() to \e data.
     /*! \param data The waveform of the data for the fit.
      *  \param base Baseline of \e data.
@@ -476,11 +518,44 @@ namespace stfnum {
     std::size_t whereis(const Vector_double& data, double value);
 
     //! Returns the library of functions for non-linear regression.
-    /*! \return A vector of non-linear regression functions.
+    /*! Builds a new copy of the library on every call; use stfnum::GetFunc()
+     *  or stfnum::FindFunc() to access the shared library instead.
+     *  \return A vector of non-linear regression functions.
      */
 	StfioDll
     std::vector<stfnum::storedFunc> GetFuncLib();
 
+    //! Returns the number of functions in the shared library.
+    /*! The shared library is built once, on first use, and contains the
+     *  functions of stfnum::GetFuncLib() in the same order, followed by the
+     *  functions added with stfnum::RegisterFunc(). Its entries are never
+     *  changed, moved or removed, so that they can be read from several
+     *  threads and pointers to them remain valid until the program exits.
+     *  \return The number of functions.
+     */
+    StfioDll std::size_t GetFuncCount();
+
+    //! Returns a function from the shared library.
+    /*! Throws std::out_of_range if \e index is out of range.
+     *  \param index 0-based index of the function, as in stfnum::GetFuncLib().
+     *  \return A reference to the function.
+     */
+    StfioDll const stfnum::storedFunc& GetFunc(std::size_t index);
+
+    //! Looks up a function in the shared library by name.
+    /*! \param name The name of the function (stfnum::storedFunc::name).
+     *  \return A pointer to the function, or NULL if there is none of that name.
+     */
+    StfioDll const stfnum::storedFunc* FindFunc(const std::string& name);
+
+    //! Adds a function to the shared library.
+    /*! Throws std::runtime_error if a function of the same name has
+     *  already been added.
+     *  \param func The function; it is copied into the library.
+     *  \return A reference to the function in the library.
+     */
+    StfioDll const stfnum::storedFunc& RegisterFunc(const stfnum::storedFunc& func);
+
     /*@}*/
 
 }
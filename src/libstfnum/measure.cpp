@@ -26,6 +26,7 @@
  */
 
 #include <stdexcept>
+#include <set>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -33,149 +34,265 @@
 #include "./stfnum.h"
 #include "./measure.h"
 
-int compareDouble(const void *a, const void *b)
-{
-    return ( ( *(double*)a >  *(double*)b ) - ( *(double*)a < *(double*)b ) );
+// Calls f with the data points of a section in their own sample type: the
+// Vector_double of a section that isn't stored, or a SampleArray that reads
+// the stored samples without converting them to double first. F has a
+// result_type and a templated operator() that takes the data points.
+template <class F>
+static typename F::result_type dispatchLayout(const Section& sec, const F& f) {
+    if (!sec.IsStored()) {
+        return f(sec.get());
+    }
+    SampleLayout layout = sec.Layout();
+    switch (layout.type) {
+     case stfio::int16:
+         return f(SampleArray<short>(layout, sec.size()));
+     case stfio::float32:
+         return f(SampleArray<float>(layout, sec.size()));
+     default:
+         return f(SampleArray<double>(layout, sec.size()));
+    }
 }
 
 double stfnum::base(enum stfnum::baseline_method base_method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb)
 {
-    if (data.size()==0) return 0;
-    if (llb>ulb || ulb>=data.size()) {
-        return NAN;
+    return stfnum::base< std::vector<double> >(base_method, var, data, llb, ulb);
+}
+
+struct BaseOp {
+    typedef double result_type;
+    BaseOp(stfnum::baseline_method method_, double& var_, std::size_t llb_, std::size_t ulb_)
+        : method(method_), var(var_), llb(llb_), ulb(ulb_) {}
+    template <class V> double operator()(const V& data) const {
+        return stfnum::base(method, var, data, llb, ulb);
     }
-    size_t n = ulb - llb + 1;
-    double base;
-    assert(n > 0);
-    assert(n <= data.size());
-
-    if (base_method == stfnum::median_iqr) {
-	// make  copy of the data for sorting
-        double *a = (double*)malloc(n * sizeof(double));
-        for (size_t i = 0; i < n; ++i) {
-            a[i] = data[i + llb];
+    stfnum::baseline_method method;
+    double& var;
+    std::size_t llb;
+    std::size_t ulb;
+};
+
+double stfnum::base(enum stfnum::baseline_method base_method, double& var, const Section& data, std::size_t llb, std::size_t ulb)
+{
+    return dispatchLayout(data, BaseOp(base_method, var, llb, ulb));
+}
+
+// Ranks of the order statistics that make up the median (0 and 1) and the
+// upper (2 and 3) and lower (4 and 5) quartiles of n data points. The
+// quartiles of an even number of points are taken from the lower half of
+// the ranks, as in earlier versions that sorted the data.
+static void baseRanks(std::size_t n, std::size_t ranks[6]) {
+    ranks[0] = (n-1)/2;
+    ranks[1] = n/2;
+    if (n % 2 == 0) {
+        ranks[0] = n/2-1;
+        n /= 2;
+    }
+    ranks[2] = std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1));
+    ranks[3] = std::max<long>(0l, (long)floor(3*n/4.0-1));
+    ranks[4] = std::min<long>((long)(n-1), (long)ceil(  n/4.0-1));
+    ranks[5] = std::max<long>(0l, (long)floor(  n/4.0-1));
+}
+
+double stfnum::medianIQR(double* a, std::size_t n, double& iqr) {
+    std::size_t ranks[6];
+    baseRanks(n, ranks);
+    std::vector<std::size_t> order(ranks, ranks+6);
+    std::sort(order.begin(), order.end());
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+
+    // Each selection leaves the larger data points behind the selected one,
+    // so the next (larger) rank only needs to be searched there:
+    std::size_t first = 0;
+    for (std::size_t k = 0; k < order.size(); ++k) {
+        std::nth_element(a+first, a+order[k], a+n);
+        first = order[k]+1;
+    }
+    iqr = ((a[ranks[2]] + a[ranks[3]]) - (a[ranks[4]] + a[ranks[5]])) / 2;
+    return (a[ranks[0]] + a[ranks[1]]) / 2;
+}
+
+// Keeps the data points of a sliding window in consecutive sorted buckets,
+// so that the order statistics in the ranks of baseRanks() are the largest
+// values of their buckets.
+class RankedWindow {
+public:
+    explicit RankedWindow(std::size_t n) : buckets(), sizes(), ranks() {
+        std::size_t r[6];
+        baseRanks(n, r);
+        std::vector<std::size_t> order(r, r+6);
+        std::sort(order.begin(), order.end());
+        order.erase(std::unique(order.begin(), order.end()), order.end());
+        std::size_t prev = 0;
+        for (std::size_t k = 0; k < order.size(); ++k) {
+            sizes.push_back(order[k]+1-prev);
+            prev = order[k]+1;
         }
-        qsort(a,n,sizeof(double),&compareDouble);
-
-	// get the median
-        if (n % 2)
-            base = a[(n-1)/2];
-        else {
-            n /=2;
-            base = (a[n-1] + a[n]) / 2;
+        sizes.push_back(n-prev);
+        buckets.resize(sizes.size());
+        for (int k = 0; k < 6; ++k) {
+            ranks[k] = std::lower_bound(order.begin(), order.end(), r[k]) - order.begin();
         }
+    }
 
-        /*
-         *  compute inter-quartile range (IQR) and return in "var"
-         *  interpolate as average of upper and lower bound
-         *  and make sure that indices are within [0,n-1] interval
-         */
-	double Q32 = a[std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1))] + a[std::max<long>(0l, (long)floor(3*n/4.0-1))];
-	double Q12 = a[std::min<long>((long)(n-1), (long)ceil(  n/4.0-1))] + a[std::max<long>(0l, (long)floor(  n/4.0-1))];
-	var = (Q32 - Q12) / 2;
+    void Insert(double x) {
+        std::size_t k = 0;
+        while (k < buckets.size()-1 && (buckets[k].empty() || x > *buckets[k].rbegin()))
+            ++k;
+        buckets[k].insert(x);
+    }
 
-        free(a);
-        return base;
+    void Erase(double x) {
+        std::size_t k = 0;
+        while (k < buckets.size()-1 && (buckets[k].empty() || x > *buckets[k].rbegin()))
+            ++k;
+        buckets[k].erase(buckets[k].find(x));
     }
-    // else  if (method == mean_baseline)
 
-    double sumY=0.0;
-    //according to the pascal version, every value 
-    //within the window shall be summed up:
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:sumY)
-#endif
-    for (int i=(int)llb; i<=(int)ulb;++i) {
-        sumY+=data[i];
+    // Restores the bucket sizes after the window has been filled or moved.
+    void Balance() {
+        for (std::size_t k = 0; k < buckets.size()-1; ++k) {
+            while (buckets[k].size() > sizes[k]) {
+                std::multiset<double>::iterator last = --buckets[k].end();
+                buckets[k+1].insert(*last);
+                buckets[k].erase(last);
+            }
+            while (buckets[k].size() < sizes[k]) {
+                // the next bucket is empty while the window is filled:
+                std::size_t next = k+1;
+                while (buckets[next].empty())
+                    ++next;
+                buckets[k].insert(*buckets[next].begin());
+                buckets[next].erase(buckets[next].begin());
+            }
+        }
     }
 
-    base=sumY/n;
-    // second pass to calculate the variance:
-    double varS=0.0;
-    double corr=0.0;
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:varS,corr)
-#endif
-    for (int i=(int)llb; i<=(int)ulb;++i) {
-        double diff=data[i]-base;
-        varS+=diff*diff;
-        // correct for floating point inaccuracies:
-        corr+=diff;
+    double Median(double& iqr) const {
+        iqr = ((Value(2) + Value(3)) - (Value(4) + Value(5))) / 2;
+        return (Value(0) + Value(1)) / 2;
     }
-    corr=(corr*corr)/n;
-    var = (varS-corr)/(n-1);
 
-    return base;
+private:
+    double Value(int k) const { return *buckets[ranks[k]].rbegin(); }
+
+    std::vector< std::multiset<double> > buckets;
+    std::vector<std::size_t> sizes;
+    std::size_t ranks[6];
+};
+
+template <class V>
+static void rollingBaseTmpl(const V& data, std::size_t window,
+                            Vector_double& median, Vector_double& iqr)
+{
+    const std::size_t n_data = data.size();
+    if (window == 0 || window > n_data) {
+        throw std::out_of_range("Window out of range in stfnum::rollingBase");
+    }
+    median.resize(n_data);
+    iqr.resize(n_data);
+
+    RankedWindow ranked(window);
+    for (std::size_t i = 0; i < window; ++i) {
+        ranked.Insert(data[i]);
+    }
+    ranked.Balance();
+
+    std::size_t first = 0; // first data point of the window
+    for (std::size_t i = 0; i < n_data; ++i) {
+        std::size_t centered = i > window/2 ? i-window/2 : 0;
+        if (centered > n_data-window) {
+            centered = n_data-window;
+        }
+        if (centered > first) {
+            ranked.Insert(data[first+window]);
+            ranked.Erase(data[first]);
+            ranked.Balance();
+            ++first;
+        }
+        median[i] = ranked.Median(iqr[i]);
+    }
+}
+
+void stfnum::rollingBase(const std::vector<double>& data, std::size_t window,
+                         Vector_double& median, Vector_double& iqr)
+{
+    rollingBaseTmpl(data, window, median, iqr);
+}
+
+struct RollingBaseOp {
+    typedef void result_type;
+    RollingBaseOp(std::size_t window_, Vector_double& median_, Vector_double& iqr_)
+        : window(window_), median(median_), iqr(iqr_) {}
+    template <class V> void operator()(const V& data) const {
+        rollingBaseTmpl(data, window, median, iqr);
+    }
+    std::size_t window;
+    Vector_double& median;
+    Vector_double& iqr;
+};
+
+void stfnum::rollingBase(const Section& data, std::size_t window,
+                         Vector_double& median, Vector_double& iqr)
+{
+    dispatchLayout(data, RollingBaseOp(window, median, iqr));
 }
 
 double stfnum::peak(const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
             int pM, stfnum::direction dir, double& maxT)
 {
-    if (llp>ulp || ulp>=data.size()) {
-        maxT = NAN;
-        return NAN;
+    return stfnum::peak< std::vector<double> >(data, base, llp, ulp, pM, dir, maxT);
+}
+
+struct PeakOp {
+    typedef double result_type;
+    PeakOp(double base_, std::size_t llp_, std::size_t ulp_, int pM_, stfnum::direction dir_, double& maxT_)
+        : base(base_), llp(llp_), ulp(ulp_), pM(pM_), dir(dir_), maxT(maxT_) {}
+    template <class V> double operator()(const V& data) const {
+        return stfnum::peak(data, base, llp, ulp, pM, dir, maxT);
     }
-    
-    double max=data[llp];
-    maxT=(double)llp;
-    double peak=0.0;
-
-    if (pM > 0) {
-        for (std::size_t i=llp+1; i <=ulp; i++) {
-            //Calculate peak as the average over pM points around the point i
-            peak=0.0;
-            div_t Div1=div((int)pM-1, 2);
-            int counter = 0;
-            int start = i-Div1.quot;
-            if (start < 0)
-                start = 0;
-            for (counter=start; counter <= start+pM-1 && counter < (int)data.size(); counter++)
-                peak+=data[counter];
-            peak /= (counter-start);
-            
-            //Set peak for BOTH
-            if (dir == stfnum::both && fabs(peak-base) > fabs (max-base))
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-            //Set peak for UP
-            if (dir == stfnum::up && peak-base > max-base)
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-            //Set peak for DOWN
-            if (dir == stfnum::down && peak-base < max-base)
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-        }	//End loop: data points
-        peak = max;
-        //End peak and base calculation
-        //-------------------------------
-    } else {
-        if (pM==-1) { // calculate the average within the peak window
-            double sumY=0; 
+    double base;
+    std::size_t llp;
+    std::size_t ulp;
+    int pM;
+    stfnum::direction dir;
+    double& maxT;
+};
+
+double stfnum::peak(const Section& data, double base, std::size_t llp, std::size_t ulp,
+            int pM, stfnum::direction dir, double& maxT)
+{
+    return dispatchLayout(data, PeakOp(base, llp, ulp, pM, dir, maxT));
+}
+
+Vector_double stfnum::peak(const Channel& channel, const std::vector<std::size_t>& sections,
+            const Vector_double& base, std::size_t llp, std::size_t ulp,
+            int pM, stfnum::direction dir, Vector_double& maxT, int n_threads)
+{
+    if (base.size() != sections.size()) {
+        throw std::out_of_range("Number of baselines doesn't match the number of sections in stfnum::peak");
+    }
+    for (std::size_t n_s = 0; n_s < sections.size(); ++n_s) {
+        if (sections[n_s] >= channel.size()) {
+            throw std::out_of_range("Section number out of range in stfnum::peak");
+        }
+    }
+    Vector_double peaks(sections.size());
+    maxT.resize(sections.size());
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:sumY)
+    if (n_threads <= 0) {
+        n_threads = omp_get_num_procs();
+    }
+#pragma omp parallel for schedule(dynamic) num_threads(n_threads)
 #endif
-            for (int i=(int)llp; i<=(int)ulp;++i) {
-                sumY+=data[i];
-            }
-            int n=(int)(ulp-llp+1);
-            peak=sumY/n;
-            maxT=(double)((llp+ulp)/2.0);
-        } else {
-            maxT = NAN;
-            peak = NAN;
-        }
+    for (int n_s = 0; n_s < (int)sections.size(); ++n_s) {
+        peaks[n_s] = stfnum::peak(channel[sections[n_s]], base[n_s], llp, ulp, pM, dir, maxT[n_s]);
     }
-    return peak;
+    return peaks;
 }
 
-double stfnum::threshold( const std::vector<double>& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength )
+template <class V>
+static double thresholdTmpl(const V& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength )
 {
     thrT = -1;
     
@@ -207,7 +324,32 @@ double stfnum::threshold( const std::vector<double>& data, std::size_t llp, std:
     return threshold;
 }
 
-double stfnum::risetime(const std::vector<double>& data, double base, double ampl,
+double stfnum::threshold( const std::vector<double>& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength )
+{
+    return thresholdTmpl(data, llp, ulp, slope, thrT, windowLength);
+}
+
+struct ThresholdOp {
+    typedef double result_type;
+    ThresholdOp(std::size_t llp_, std::size_t ulp_, double slope_, double& thrT_, std::size_t windowLength_)
+        : llp(llp_), ulp(ulp_), slope(slope_), thrT(thrT_), windowLength(windowLength_) {}
+    template <class V> double operator()(const V& data) const {
+        return thresholdTmpl(data, llp, ulp, slope, thrT, windowLength);
+    }
+    std::size_t llp;
+    std::size_t ulp;
+    double slope;
+    double& thrT;
+    std::size_t windowLength;
+};
+
+double stfnum::threshold( const Section& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength )
+{
+    return dispatchLayout(data, ThresholdOp(llp, ulp, slope, thrT, windowLength));
+}
+
+template <class V>
+static double risetimeTmpl(const V& data, double base, double ampl,
                      double left, double right, double frac, std::size_t& tLoId, std::size_t& tHiId,
                      double& tLoReal)
 {
@@ -266,7 +408,39 @@ double stfnum::risetime(const std::vector<double>& data, double base, double amp
     return rtLoHi;  
 }
 
-double stfnum::risetime2(const std::vector<double>& data, double base, double ampl,
+double stfnum::risetime(const std::vector<double>& data, double base, double ampl,
+                     double left, double right, double frac, std::size_t& tLoId, std::size_t& tHiId,
+                     double& tLoReal)
+{
+    return risetimeTmpl(data, base, ampl, left, right, frac, tLoId, tHiId, tLoReal);
+}
+
+struct RisetimeOp {
+    typedef double result_type;
+    RisetimeOp(double base_, double ampl_, double left_, double right_, double frac_, std::size_t& tLoId_, std::size_t& tHiId_, double& tLoReal_)
+        : base(base_), ampl(ampl_), left(left_), right(right_), frac(frac_), tLoId(tLoId_), tHiId(tHiId_), tLoReal(tLoReal_) {}
+    template <class V> double operator()(const V& data) const {
+        return risetimeTmpl(data, base, ampl, left, right, frac, tLoId, tHiId, tLoReal);
+    }
+    double base;
+    double ampl;
+    double left;
+    double right;
+    double frac;
+    std::size_t& tLoId;
+    std::size_t& tHiId;
+    double& tLoReal;
+};
+
+double stfnum::risetime(const Section& data, double base, double ampl,
+                     double left, double right, double frac, std::size_t& tLoId, std::size_t& tHiId,
+                     double& tLoReal)
+{
+    return dispatchLayout(data, RisetimeOp(base, ampl, left, right, frac, tLoId, tHiId, tLoReal));
+}
+
+template <class V>
+static double risetime2Tmpl(const V& data, double base, double ampl,
                      double left, double right, double frac,
                      double& innerTLoReal, double& innerTHiReal, double& outerTLoReal, double& outerTHiReal )
 {
@@ -391,7 +565,43 @@ double stfnum::risetime2(const std::vector<double>& data, double base, double am
     return (innerTHiReal-innerTLoReal);
 }
 
-double   stfnum::t_half(const std::vector<double>& data,
+double stfnum::risetime2(const std::vector<double>& data, double base, double ampl,
+                     double left, double right, double frac,
+                     double& innerTLoReal, double& innerTHiReal, double& outerTLoReal, double& outerTHiReal )
+{
+    return risetime2Tmpl(data, base, ampl, left, right, frac,
+                     innerTLoReal, innerTHiReal, outerTLoReal, outerTHiReal);
+}
+
+struct Risetime2Op {
+    typedef double result_type;
+    Risetime2Op(double base_, double ampl_, double left_, double right_, double frac_, double& innerTLoReal_, double& innerTHiReal_, double& outerTLoReal_, double& outerTHiReal_)
+        : base(base_), ampl(ampl_), left(left_), right(right_), frac(frac_), innerTLoReal(innerTLoReal_), innerTHiReal(innerTHiReal_), outerTLoReal(outerTLoReal_), outerTHiReal(outerTHiReal_) {}
+    template <class V> double operator()(const V& data) const {
+        return risetime2Tmpl(data, base, ampl, left, right, frac,
+                             innerTLoReal, innerTHiReal, outerTLoReal, outerTHiReal);
+    }
+    double base;
+    double ampl;
+    double left;
+    double right;
+    double frac;
+    double& innerTLoReal;
+    double& innerTHiReal;
+    double& outerTLoReal;
+    double& outerTHiReal;
+};
+
+double stfnum::risetime2(const Section& data, double base, double ampl,
+                     double left, double right, double frac,
+                     double& innerTLoReal, double& innerTHiReal, double& outerTLoReal, double& outerTHiReal )
+{
+    return dispatchLayout(data, Risetime2Op(base, ampl, left, right, frac,
+                                          innerTLoReal, innerTHiReal, outerTLoReal, outerTHiReal));
+}
+
+template <class V>
+static double t_halfTmpl(const V& data,
         double base,
         double ampl,
         double left,
@@ -458,7 +668,54 @@ double   stfnum::t_half(const std::vector<double>& data,
     return t50RightReal-t50LeftReal;
 }
 
-double   stfnum::maxRise(const std::vector<double>& data,
+double   stfnum::t_half(const std::vector<double>& data,
+        double base,
+        double ampl,
+        double left,
+        double right,
+        double center,
+        std::size_t& t50LeftId,
+        std::size_t& t50RightId,
+        double& t50LeftReal)
+{
+    return t_halfTmpl(data, base, ampl, left, right, center,
+                      t50LeftId, t50RightId, t50LeftReal);
+}
+
+struct THalfOp {
+    typedef double result_type;
+    THalfOp(double base_, double ampl_, double left_, double right_, double center_, std::size_t& t50LeftId_, std::size_t& t50RightId_, double& t50LeftReal_)
+        : base(base_), ampl(ampl_), left(left_), right(right_), center(center_), t50LeftId(t50LeftId_), t50RightId(t50RightId_), t50LeftReal(t50LeftReal_) {}
+    template <class V> double operator()(const V& data) const {
+        return t_halfTmpl(data, base, ampl, left, right, center,
+                          t50LeftId, t50RightId, t50LeftReal);
+    }
+    double base;
+    double ampl;
+    double left;
+    double right;
+    double center;
+    std::size_t& t50LeftId;
+    std::size_t& t50RightId;
+    double& t50LeftReal;
+};
+
+double   stfnum::t_half(const Section& data,
+        double base,
+        double ampl,
+        double left,
+        double right,
+        double center,
+        std::size_t& t50LeftId,
+        std::size_t& t50RightId,
+        double& t50LeftReal)
+{
+    return dispatchLayout(data, THalfOp(base, ampl, left, right, center,
+                                      t50LeftId, t50RightId, t50LeftReal));
+}
+
+template <class V>
+static double maxRiseTmpl(const V& data,
         double left,
         double right,
         double& maxRiseT,
@@ -490,7 +747,42 @@ double   stfnum::maxRise(const std::vector<double>& data,
     return maxRise/windowLength;
 }
 
-double stfnum::maxDecay(const std::vector<double>& data,
+double   stfnum::maxRise(const std::vector<double>& data,
+        double left,
+        double right,
+        double& maxRiseT,
+        double& maxRiseY,
+        std::size_t    windowLength)
+{
+    return maxRiseTmpl(data, left, right, maxRiseT, maxRiseY, windowLength);
+}
+
+struct MaxRiseOp {
+    typedef double result_type;
+    MaxRiseOp(double left_, double right_, double& maxRiseT_, double& maxRiseY_, std::size_t windowLength_)
+        : left(left_), right(right_), maxRiseT(maxRiseT_), maxRiseY(maxRiseY_), windowLength(windowLength_) {}
+    template <class V> double operator()(const V& data) const {
+        return maxRiseTmpl(data, left, right, maxRiseT, maxRiseY, windowLength);
+    }
+    double left;
+    double right;
+    double& maxRiseT;
+    double& maxRiseY;
+    std::size_t windowLength;
+};
+
+double   stfnum::maxRise(const Section& data,
+        double left,
+        double right,
+        double& maxRiseT,
+        double& maxRiseY,
+        std::size_t    windowLength)
+{
+    return dispatchLayout(data, MaxRiseOp(left, right, maxRiseT, maxRiseY, windowLength));
+}
+
+template <class V>
+static double maxDecayTmpl(const V& data,
         double left,
         double right,
         double& maxDecayT,
@@ -521,8 +813,43 @@ double stfnum::maxDecay(const std::vector<double>& data,
     return maxDecay/windowLength;
 }
 
+double stfnum::maxDecay(const std::vector<double>& data,
+        double left,
+        double right,
+        double& maxDecayT,
+        double& maxDecayY,
+        std::size_t    windowLength)
+{
+    return maxDecayTmpl(data, left, right, maxDecayT, maxDecayY, windowLength);
+}
+
+struct MaxDecayOp {
+    typedef double result_type;
+    MaxDecayOp(double left_, double right_, double& maxDecayT_, double& maxDecayY_, std::size_t windowLength_)
+        : left(left_), right(right_), maxDecayT(maxDecayT_), maxDecayY(maxDecayY_), windowLength(windowLength_) {}
+    template <class V> double operator()(const V& data) const {
+        return maxDecayTmpl(data, left, right, maxDecayT, maxDecayY, windowLength);
+    }
+    double left;
+    double right;
+    double& maxDecayT;
+    double& maxDecayY;
+    std::size_t windowLength;
+};
+
+double stfnum::maxDecay(const Section& data,
+        double left,
+        double right,
+        double& maxDecayT,
+        double& maxDecayY,
+        std::size_t    windowLength)
+{
+    return dispatchLayout(data, MaxDecayOp(left, right, maxDecayT, maxDecayY, windowLength));
+}
+
 #ifdef WITH_PSLOPE
-double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::size_t right) {
+template <class V>
+static double pslopeTmpl(const V& data, std::size_t left, std::size_t right) {
 
     // data testing not zero 
     //if (!data.size()) return 0;
@@ -542,6 +869,27 @@ double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::si
 
     return SlopeVal;
 }
+
+double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::size_t right)
+{
+    return pslopeTmpl(data, left, right);
+}
+
+struct PSlopeOp {
+    typedef double result_type;
+    PSlopeOp(std::size_t left_, std::size_t right_)
+        : left(left_), right(right_) {}
+    template <class V> double operator()(const V& data) const {
+        return pslopeTmpl(data, left, right);
+    }
+    std::size_t left;
+    std::size_t right;
+};
+
+double stfnum::pslope(const Section& data, std::size_t left, std::size_t right)
+{
+    return dispatchLayout(data, PSlopeOp(left, right));
+}
 #endif // WITH_PSLOPE
 
 
@@ -30,6 +30,9 @@
 #define _MEASLIB_H
 
 #include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
 
 #include "../libstfio/stfio.h"
 
@@ -39,6 +42,12 @@ namespace stfnum {
  *  @{
  */
 
+/* Most measurements below are also overloaded for a const Section&. Stored
+ * sections are read in their own sample type (see Section::SetStorage())
+ * without converting them to double first; the other parameters are the same
+ * as for the std::vector<double> version.
+ */
+
 //! Calculate the average of all sampling points between and including \e llb and \e ulb.
 /*! \param method: 0: mean and s.d.; 1: median
  *  \param var Will contain the variance on exit (only when method=0).
@@ -52,6 +61,49 @@ namespace stfnum {
 StfioDll
 double base(enum stfnum::baseline_method method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb);
 
+//! Calculate the baseline of a section.
+/*! See base() for the parameters. */
+StfioDll
+double base(enum stfnum::baseline_method method, double& var, const Section& data, std::size_t llb, std::size_t ulb);
+
+//! Calculate the baseline of any random-access sequence of data points.
+/*! \e V needs operator[] and size(), e.g. SampleArray. See base() for the parameters.
+ */
+template <class V>
+double base(enum stfnum::baseline_method method, double& var, const V& data, std::size_t llb, std::size_t ulb);
+
+//! Median and inter-quartile range of \e n data points.
+/*! Uses selection (std::nth_element) instead of sorting, so that the
+ *  cost is proportional to \e n. Used by base() for stfnum::median_iqr.
+ *  \param a The data points; they are reordered on exit.
+ *  \param n Number of data points, has to be > 0.
+ *  \param iqr On exit, the inter-quartile range.
+ *  \return The median.
+ */
+StfioDll
+double medianIQR(double* a, std::size_t n, double& iqr);
+
+//! Rolling median and inter-quartile range of a gap-free trace.
+/*! Computes the baseline of every data point from a window of \e window
+ *  points centered on it, so that slow drift can be followed in a single
+ *  pass. The window is shifted inwards at the start and end of \e data so
+ *  that it always has \e window points. Each step costs O(log \e window).
+ *  Throws std::out_of_range if \e window is 0 or exceeds \e data.
+ *  \param data The data waveform to be analysed.
+ *  \param window Number of data points in the window.
+ *  \param median On exit, the median of each data point's window.
+ *  \param iqr On exit, the inter-quartile range of each data point's window.
+ */
+StfioDll
+void rollingBase(const std::vector<double>& data, std::size_t window,
+                 Vector_double& median, Vector_double& iqr);
+
+//! Rolling median and inter-quartile range of a section.
+/*! See rollingBase() for the parameters. */
+StfioDll
+void rollingBase(const Section& data, std::size_t window,
+                 Vector_double& median, Vector_double& iqr);
+
 
 //! Find the peak value of \e data between \e llp and \e ulp.
 /*! Note that peaks will be detected by measuring from \e base, but the return value
@@ -73,6 +125,55 @@ double base(enum stfnum::baseline_method method, double& var, const std::vector<
 StfioDll
 double peak( const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
         int pM, stfnum::direction, double& maxT);
+
+//! Find the peak value of a section.
+/*! See peak() for the parameters. */
+StfioDll
+double peak( const Section& data, double base, std::size_t llp, std::size_t ulp,
+        int pM, stfnum::direction, double& maxT);
+
+//! Find the peak value of any random-access sequence of data points.
+/*! \e V needs operator[] and size(), e.g. SampleArray. See peak() for the parameters.
+ */
+template <class V>
+double peak( const V& data, double base, std::size_t llp, std::size_t ulp,
+        int pM, stfnum::direction, double& maxT);
+
+//! Find the peak values of several sections of a channel.
+/*! Calls peak() for every section, distributing the sections across
+ *  threads if OpenMP is available. Throws std::out_of_range if a section
+ *  index is out of range or if \e base and \e sections differ in size.
+ *  \param channel The channel.
+ *  \param sections Indices of the sections to be analysed.
+ *  \param base The baseline value of each section.
+ *  \param llp Lower limit of the peak window.
+ *  \param ulp Upper limit of the peak window.
+ *  \param pM Width of the sliding average, see peak().
+ *  \param dir The direction of the peaks, see peak().
+ *  \param maxT On exit, the index of each peak value.
+ *  \param n_threads Maximal number of threads; 0 uses all available cores.
+ *  \return The peak value of each section, measured from 0.
+ */
+StfioDll
+Vector_double peak( const Channel& channel, const std::vector<std::size_t>& sections,
+        const Vector_double& base, std::size_t llp, std::size_t ulp,
+        int pM, stfnum::direction dir, Vector_double& maxT, int n_threads=0 );
+
+//! Distance of a peak candidate from the baseline in the direction of the search.
+/*! The candidate with the largest distance is the peak.
+ *  \param diff The candidate minus the baseline.
+ *  \param dir The direction of the peak, see peak().
+ *  \return \e diff for stfnum::up, -\e diff for stfnum::down, its absolute
+ *          value for stfnum::both and -HUGE_VAL otherwise.
+ */
+inline double peakDistance(double diff, stfnum::direction dir) {
+    switch (dir) {
+     case stfnum::up:   return diff;
+     case stfnum::down: return -diff;
+     case stfnum::both: return fabs(diff);
+     default:           return -HUGE_VAL;
+    }
+}
  
 //! Find the value within \e data between \e llp and \e ulp at which \e slope is exceeded.
 /*! \param data The data waveform to be analysed.
@@ -88,6 +189,11 @@ double peak( const std::vector<double>& data, double base, std::size_t llp, std:
 StfioDll
 double threshold( const std::vector<double>& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength );
 
+//! Find the threshold crossing within a section.
+/*! See threshold() for the parameters. */
+StfioDll
+double threshold( const Section& data, std::size_t llp, std::size_t ulp, double slope, double& thrT, std::size_t windowLength );
+
 //! Find 20 to 80% rise time of an event in \e data.
 /*! Although t80real is not explicitly returned, it can be calculated
  *  from t20Real+risetime.
@@ -109,6 +215,13 @@ double risetime(const std::vector<double>& data, double base, double ampl,
                 double left, double right, double frac, std::size_t& tLoId, std::size_t& tHiId,
                 double& tLoReal);
 
+//! Find the rise time of an event within a section.
+/*! See risetime() for the parameters. */
+StfioDll
+double risetime(const Section& data, double base, double ampl,
+                double left, double right, double frac, std::size_t& tLoId, std::size_t& tHiId,
+                double& tLoReal);
+
 //! Find 20 to 80% rise time of an event in \e data.
 /*! Although t80real is not explicitly returned, it can be calculated
  *  from t20Real+risetime.
@@ -133,6 +246,13 @@ double risetime2(const std::vector<double>& data, double base, double ampl,
                 double left, double right, double frac,
                 double& innerTLoReal, double& innerTHiReal, double& outerTLoReal, double& outerTHiReal );
 
+//! Find the inner and outer rise times of an event within a section.
+/*! See risetime2() for the parameters. */
+StfioDll
+double risetime2(const Section& data, double base, double ampl,
+                double left, double right, double frac,
+                double& innerTLoReal, double& innerTHiReal, double& outerTLoReal, double& outerTHiReal );
+
 //! Find the full width at half-maximal amplitude of an event within \e data.
 /*! Although t50RightReal is not explicitly returned, it can be calculated
  *  from t50LeftReal+t_half.
@@ -154,6 +274,12 @@ StfioDll
 double t_half( const std::vector<double>& data, double base, double ampl, double left, double right,
                double center, std::size_t& t50LeftId, std::size_t& t50RightId, double& t50LeftReal );
 
+//! Find the full width at half-maximal amplitude of an event within a section.
+/*! See t_half() for the parameters. */
+StfioDll
+double t_half( const Section& data, double base, double ampl, double left, double right,
+               double center, std::size_t& t50LeftId, std::size_t& t50RightId, double& t50LeftReal );
+
 //! Find the maximal slope during the rising phase of an event within \e data.
 /*! \param data The data waveform to be analysed.
  *  \param left Delimits the search to the left.
@@ -169,6 +295,12 @@ StfioDll
 double  maxRise( const std::vector<double>& data, double left, double right, double& maxRiseT,
                  double& maxRiseY, std::size_t windowLength);
 
+//! Find the maximal slope of rise within a section.
+/*! See maxRise() for the parameters. */
+StfioDll
+double  maxRise( const Section& data, double left, double right, double& maxRiseT,
+                 double& maxRiseY, std::size_t windowLength);
+
 //! Find the maximal slope during the decaying phase of an event within \e data.
 /*! \param data The data waveform to be analysed.
  *  \param left Delimits the search to the left.
@@ -184,6 +316,12 @@ StfioDll
 double  maxDecay( const std::vector<double>& data, double left, double right, double& maxDecayT,
                   double& maxDecayY, std::size_t windowLength);
 
+//! Find the maximal slope of decay within a section.
+/*! See maxDecay() for the parameters. */
+StfioDll
+double  maxDecay( const Section& data, double left, double right, double& maxDecayT,
+                  double& maxDecayY, std::size_t windowLength);
+
 #ifdef WITH_PSLOPE
 //! Find the slope an event within \e data.
 /*! \param data The data waveform to be analysed.
@@ -193,9 +331,141 @@ double  maxDecay( const std::vector<double>& data, double left, double right, do
  */
 double pslope( const std::vector<double>& data, std::size_t left, std::size_t right);
 
+//! Find the slope of an event within a section.
+/*! See pslope() for the parameters. */
+double pslope( const Section& data, std::size_t left, std::size_t right);
+
 #endif
 /*@}*/
 
 }
 
+template <class V>
+double stfnum::base(enum stfnum::baseline_method base_method, double& var, const V& data, std::size_t llb, std::size_t ulb)
+{
+    if (data.size()==0) return 0;
+    if (llb>ulb || ulb>=data.size()) {
+        return NAN;
+    }
+    size_t n = ulb - llb + 1;
+    double base;
+    assert(n > 0);
+    assert(n <= data.size());
+
+    if (base_method == stfnum::median_iqr) {
+        // copy the data to a buffer that is kept for the next call of this
+        // thread, since the selection reorders the data points:
+#if (__cplusplus < 201103)
+        Vector_double a(n);
+#else
+        static thread_local Vector_double a;
+        a.resize(n);
+#endif
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = data[i + llb];
+        }
+        return stfnum::medianIQR(&a[0], n, var);
+    }
+    // else  if (method == mean_baseline)
+
+    double sumY=0.0;
+    //according to the pascal version, every value 
+    //within the window shall be summed up:
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sumY)
+#endif
+    for (int i=(int)llb; i<=(int)ulb;++i) {
+        sumY+=data[i];
+    }
+
+    base=sumY/n;
+    // second pass to calculate the variance:
+    double varS=0.0;
+    double corr=0.0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:varS,corr)
+#endif
+    for (int i=(int)llb; i<=(int)ulb;++i) {
+        double diff=data[i]-base;
+        varS+=diff*diff;
+        // correct for floating point inaccuracies:
+        corr+=diff;
+    }
+    corr=(corr*corr)/n;
+    var = (varS-corr)/(n-1);
+
+    return base;
+}
+
+template <class V>
+double stfnum::peak(const V& data, double base, std::size_t llp, std::size_t ulp,
+            int pM, stfnum::direction dir, double& maxT)
+{
+    if (llp>ulp || ulp>=data.size()) {
+        maxT = NAN;
+        return NAN;
+    }
+    
+    double max=data[llp];
+    maxT=(double)llp;
+    double peak=0.0;
+
+    if (pM > 0) {
+        // The average over pM points around i is kept as a running sum
+        // of the window [winBeg, winEnd) that is updated by the points
+        // entering and leaving it, rather than summed up for every i.
+        const std::size_t half = (pM-1)/2, n_data = data.size();
+        std::size_t winBeg = 0, winEnd = 0;
+        double sum = 0.0, maxDist = peakDistance(max-base, dir);
+        for (std::size_t i=llp+1; i <=ulp; i++) {
+            std::size_t start = i > half ? i-half : 0;
+            std::size_t end = std::min(start+pM, n_data);
+            if (start >= winEnd) {
+                sum = 0.0;
+                for (std::size_t k = start; k < end; ++k)
+                    sum += data[k];
+            } else {
+                // Take the difference first so that the sum doesn't
+                // change on a plateau:
+                for (; winBeg < start && winEnd < end; ++winBeg, ++winEnd)
+                    sum += data[winEnd] - data[winBeg];
+                for (; winEnd < end; ++winEnd)
+                    sum += data[winEnd];
+                for (; winBeg < start; ++winBeg)
+                    sum -= data[winBeg];
+            }
+            winBeg = start;
+            winEnd = end;
+            peak = sum / (end-start);
+
+            double dist = peakDistance(peak-base, dir);
+            if (dist > maxDist) {
+                max = peak;
+                maxDist = dist;
+                maxT = (double)i;
+            }
+        }	//End loop: data points
+        peak = max;
+        //End peak and base calculation
+        //-------------------------------
+    } else {
+        if (pM==-1) { // calculate the average within the peak window
+            double sumY=0; 
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sumY)
+#endif
+            for (int i=(int)llp; i<=(int)ulp;++i) {
+                sumY+=data[i];
+            }
+            int n=(int)(ulp-llp+1);
+            peak=sumY/n;
+            maxT=(double)((llp+ulp)/2.0);
+        } else {
+            maxT = NAN;
+            peak = NAN;
+        }
+    }
+    return peak;
+}
+
 #endif
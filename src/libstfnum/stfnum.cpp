@@ -20,6 +20,7 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <map>
 
 #include "stfnum.h"
 #include "fit.h"
@@ -136,6 +137,31 @@ void stfnum::Table::AppendRows(std::size_t nRows_) {
     }
 }
 
+void stfnum::storedFunc::EvalFunc(double x0, double dx, std::size_t n,
+                                  const Vector_double& p, double* y) const
+{
+    if (funcArray) {
+        funcArray(x0, dx, n, p, y);
+        return;
+    }
+    for (std::size_t n_x=0; n_x<n; ++n_x) {
+        y[n_x]=func(x0+(double)n_x*dx, p);
+    }
+}
+
+void stfnum::storedFunc::EvalJac(double x0, double dx, std::size_t n,
+                                 const Vector_double& p, double* j) const
+{
+    if (jacArray) {
+        jacArray(x0, dx, n, p, j);
+        return;
+    }
+    for (std::size_t n_x=0; n_x<n; ++n_x) {
+        Vector_double jac_x(jac(x0+(double)n_x*dx, p));
+        std::copy(jac_x.begin(), jac_x.end(), &j[n_x*p.size()]);
+    }
+}
+
 double stfnum::fboltz(double x, const Vector_double& pars) {
     double arg=(pars[0]-x)/pars[1];
     double ex=exp(arg);
@@ -170,6 +196,148 @@ int stfnum::fac(int arg) {
     }
 }
 
+// FFTW plans and aligned buffers, keyed by transform size. All access
+// to these and to the FFTW planner goes through the stfnum_fftw critical
+// section; executing a plan on new arrays is thread-safe in FFTW.
+struct fftBuffers {
+    double* in;
+    fftw_complex* out;
+};
+
+static std::map< std::size_t, std::pair<fftw_plan, fftw_plan> > fftPlans;
+static std::multimap< std::size_t, fftBuffers > fftPool;
+static unsigned fftFlags = FFTW_ESTIMATE;
+
+// Maximal number of idle buffer pairs that are kept per transform size:
+static const std::size_t FFT_POOL_MAX = 8;
+
+static void destroyPlans() {
+    std::map< std::size_t, std::pair<fftw_plan, fftw_plan> >::iterator it;
+    for (it = fftPlans.begin(); it != fftPlans.end(); ++it) {
+        fftw_destroy_plan(it->second.first);
+        fftw_destroy_plan(it->second.second);
+    }
+    fftPlans.clear();
+}
+
+stfnum::FFTWorkspace::FFTWorkspace(std::size_t n_)
+    : n(n_), in(NULL), out(NULL), p_fwd(NULL), p_bwd(NULL)
+{
+    if (n==0) {
+        throw std::out_of_range("Transform of size 0 in stfnum::FFTWorkspace");
+    }
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        std::multimap< std::size_t, fftBuffers >::iterator it = fftPool.find(n);
+        if (it != fftPool.end()) {
+            in = it->second.in;
+            out = it->second.out;
+            fftPool.erase(it);
+        } else {
+            //memory allocation as suggested by fftw:
+            in = (double *)fftw_malloc(sizeof(double) * n);
+            out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * (n/2+1));
+        }
+        if (in != NULL && out != NULL) {
+            std::map< std::size_t, std::pair<fftw_plan, fftw_plan> >::iterator pit = fftPlans.find(n);
+            if (pit == fftPlans.end()) {
+                // Planning with FFTW_MEASURE overwrites the arrays; they don't hold any data yet.
+                p_fwd = fftw_plan_dft_r2c_1d((int)n, in, out, fftFlags);
+                p_bwd = fftw_plan_dft_c2r_1d((int)n, out, in, fftFlags);
+                fftPlans[n] = std::make_pair(p_fwd, p_bwd);
+            } else {
+                p_fwd = pit->second.first;
+                p_bwd = pit->second.second;
+            }
+        }
+    }
+    if (in == NULL || out == NULL) {
+        fftw_free(in);
+        fftw_free(out);
+        throw std::runtime_error("Couldn't allocate memory in stfnum::FFTWorkspace");
+    }
+}
+
+stfnum::FFTWorkspace::~FFTWorkspace() {
+    bool pooled = false;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        if (fftPool.count(n) < FFT_POOL_MAX) {
+            fftBuffers buf;
+            buf.in = in;
+            buf.out = out;
+            fftPool.insert(std::make_pair(n, buf));
+            pooled = true;
+        }
+    }
+    if (!pooled) {
+        fftw_free(in);
+        fftw_free(out);
+    }
+}
+
+void stfnum::FFTWorkspace::Forward() {
+    fftw_execute_dft_r2c(p_fwd, in, out);
+}
+
+void stfnum::FFTWorkspace::Backward() {
+    fftw_execute_dft_c2r(p_bwd, out, in);
+}
+
+void stfnum::fftwSetMeasure(bool measure) {
+    unsigned flags = (measure ? FFTW_MEASURE : FFTW_ESTIMATE);
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        if (flags != fftFlags) {
+            destroyPlans();
+            fftFlags = flags;
+        }
+    }
+}
+
+bool stfnum::fftwImportWisdom(const std::string& filename) {
+    int ret = 0;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        ret = fftw_import_wisdom_from_filename(filename.c_str());
+    }
+    return ret != 0;
+}
+
+bool stfnum::fftwExportWisdom(const std::string& filename) {
+    int ret = 0;
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        ret = fftw_export_wisdom_to_filename(filename.c_str());
+    }
+    return ret != 0;
+}
+
+void stfnum::fftwClearCache() {
+#ifdef _OPENMP
+#pragma omp critical (stfnum_fftw)
+#endif
+    {
+        destroyPlans();
+        std::multimap< std::size_t, fftBuffers >::iterator it;
+        for (it = fftPool.begin(); it != fftPool.end(); ++it) {
+            fftw_free(it->second.in);
+            fftw_free(it->second.out);
+        }
+        fftPool.clear();
+    }
+}
+
 Vector_double
 stfnum::filter( const Vector_double& data, std::size_t filter_start,
         std::size_t filter_end, const Vector_double &a, int SR,
@@ -182,16 +350,13 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
     Vector_double data_return(filter_size);
     double SI=1.0/SR; //the sampling interval
 
-    double *in;
+    //buffers and plans are reused for transforms of equal size:
+    FFTWorkspace fft(filter_size);
+    double *in=fft.Real();
     //fftw_complex is a double[2]; hence, out is an array of
     //double[2] with out[n][0] being the real and out[n][1] being
     //the imaginary part.
-    fftw_complex *out;
-    fftw_plan p1, p2;
-
-    //memory allocation as suggested by fftw:
-    in =(double *)fftw_malloc(sizeof(double) * filter_size);
-    out=(fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(filter_size/2)+1));
+    fftw_complex *out=fft.Complex();
 
     // calculate the offset (a straight line between the first and last points):
     double offset_0=data[filter_start];
@@ -203,9 +368,8 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
         in[n_point]=data[n_point+filter_start]-(offset_0 + offset_step*n_point);
     }
 
-    //plan the fft and execute it:
-    p1 =fftw_plan_dft_r2c_1d((int)filter_size,in,out,FFTW_ESTIMATE);
-    fftw_execute(p1);
+    //execute the fft:
+    fft.Forward();
 
     for (std::size_t n_point=0; n_point < (unsigned int)(filter_size/2)+1; ++n_point) {
         //calculate the frequency (in kHz) which corresponds to the index:
@@ -216,8 +380,7 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
     }
 
     //do the reverse fft:
-    p2=fftw_plan_dft_c2r_1d((int)filter_size,out,in,FFTW_ESTIMATE);
-    fftw_execute(p2);
+    fft.Backward();
 
     //fill the return array, adding the offset, and scaling by filter_size
     //(because fftw computes an unnormalized transform):
@@ -225,23 +388,113 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
     for (std::size_t n_point=0; n_point < filter_size; ++n_point) {
         data_return[n_point]=(in[n_point]/filter_size + offset_0 + offset_step*n_point);
     }
-    fftw_destroy_plan(p1);
-    fftw_destroy_plan(p2);
-    fftw_free(in);fftw_free(out);
     return data_return;
 }
 
+// Template length from which sliding dot products are computed
+// with FFTs rather than by direct summation:
+static const std::size_t FFT_TEMPL_THRESHOLD = 48;
+
+// Minimal number of windows that are processed at once by
+// detectionCriterion; larger chunks reduce the per-chunk FFT overhead:
+static const std::size_t MIN_CHUNK_SIZE = 16384;
+
+static void
+slidingDotProductDirect(const double* data, std::size_t n_data,
+                        const Vector_double& templ, double* out)
+{
+    std::size_t n_templ=templ.size();
+    std::size_t n_out=n_data-n_templ+1;
+    for (std::size_t n_point=0; n_point<n_out; ++n_point) {
+        double sum=0.0;
+        for (std::size_t n_t=0; n_t<n_templ; ++n_t) {
+            sum+=templ[n_t]*data[n_point+n_t];
+        }
+        out[n_point]=sum;
+    }
+}
+
+// Overlap-save: each block of n_fft data points yields
+// n_fft-n_templ+1 valid points of the circular cross-correlation.
+static void
+slidingDotProductFFT(const double* data, std::size_t n_data,
+                     const Vector_double& templ, double* out)
+{
+    std::size_t n_templ=templ.size();
+    std::size_t n_out=n_data-n_templ+1;
+
+    // Use 4 times the template size so that 3/4 of each block
+    // contributes to the result, but don't exceed the data size needlessly:
+    std::size_t n_fft=256;
+    while (n_fft<4*n_templ) n_fft*=2;
+    while (n_fft/2>=n_data && n_fft/2>=2*n_templ) n_fft/=2;
+    std::size_t n_step=n_fft-n_templ+1;
+    std::size_t n_cplx=n_fft/2+1;
+
+    stfnum::FFTWorkspace fft_data(n_fft), fft_templ(n_fft);
+    double *in=fft_data.Real();
+    fftw_complex *data_f=fft_data.Complex();
+    fftw_complex *templ_f=fft_templ.Complex();
+
+    // Transform the zero-padded template once; store the complex conjugate
+    // (correlation rather than convolution) and include the normalization
+    // of the unnormalized backward transform:
+    std::fill(fft_templ.Real(), fft_templ.Real()+n_fft, 0.0);
+    std::copy(templ.begin(), templ.end(), fft_templ.Real());
+    fft_templ.Forward();
+    for (std::size_t n_f=0; n_f<n_cplx; ++n_f) {
+        templ_f[n_f][0] /= (double)n_fft;
+        templ_f[n_f][1] /= -(double)n_fft;
+    }
+
+    for (std::size_t n_start=0; n_start<n_out; n_start+=n_step) {
+        std::size_t n_avail=std::min(n_fft, n_data-n_start);
+        std::copy(&data[n_start], &data[n_start]+n_avail, in);
+        std::fill(in+n_avail, in+n_fft, 0.0);
+        fft_data.Forward();
+        for (std::size_t n_f=0; n_f<n_cplx; ++n_f) {
+            double re=data_f[n_f][0]*templ_f[n_f][0]-data_f[n_f][1]*templ_f[n_f][1];
+            double im=data_f[n_f][0]*templ_f[n_f][1]+data_f[n_f][1]*templ_f[n_f][0];
+            data_f[n_f][0]=re;
+            data_f[n_f][1]=im;
+        }
+        fft_data.Backward();
+        std::size_t n_valid=std::min(n_step, n_out-n_start);
+        std::copy(in, in+n_valid, &out[n_start]);
+    }
+}
+
+void
+stfnum::slidingDotProduct(const double* data, std::size_t n_data,
+                          const Vector_double& templ, double* out)
+{
+    if (templ.size()==0 || n_data<templ.size()) {
+        throw std::out_of_range("Template larger than data in stfnum::slidingDotProduct()");
+    }
+    if (templ.size()<FFT_TEMPL_THRESHOLD) {
+        slidingDotProductDirect(data, n_data, templ, out);
+    } else {
+        slidingDotProductFFT(data, n_data, templ, out);
+    }
+}
+
 Vector_double
 stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
 {
     bool skipped=false;
+    if (templ.size()==0 || data.size()<templ.size()) {
+        throw std::runtime_error("Template larger than data in stfnum::detectionCriterion");
+    }
     // variable names are taken from Clements & Bekkers (1997) as long
     // as they don't interfere with C++ keywords (such as "template")
-    Vector_double detection_criterion(data.size()-templ.size());
+    std::size_t n_out=data.size()-templ.size();
+    Vector_double detection_criterion(n_out);
+    if (n_out==0) {
+        return detection_criterion;
+    }
     // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
+    double sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
     for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
         sum_data+=data[0+n_templ];
         sum_data_sqr+=data[0+n_templ]*data[0+n_templ];
         sum_templ+=templ[n_templ];
@@ -249,43 +502,42 @@ stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ
     }
     double y_old=0.0;
     double y2_old=0.0;
-    int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating detection criterion", &skipped );
-            if (skipped) {
-                detection_criterion.resize(0);
-                return detection_criterion;
-            }
-            progCounter++;
+    // The products of template and data have to be computed in full
+    // length; this is done chunk by chunk so that progress can be reported:
+    std::size_t n_chunk_max=std::max(MIN_CHUNK_SIZE, n_out/100+1);
+    Vector_double sum_templ_data(std::min(n_chunk_max, n_out));
+    for (std::size_t n_chunk=0; n_chunk<n_out; n_chunk+=n_chunk_max) {
+        progDlg.Update( (int)((double)n_chunk/(double)n_out*100.0),
+                        "Calculating detection criterion", &skipped );
+        if (skipped) {
+            detection_criterion.resize(0);
+            return detection_criterion;
         }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
+        std::size_t n_chunk_size=std::min(n_chunk_max, n_out-n_chunk);
+        slidingDotProduct(&data[n_chunk], n_chunk_size+templ.size()-1, templ, &sum_templ_data[0]);
+        for (std::size_t n_data=n_chunk; n_data<n_chunk+n_chunk_size; ++n_data) {
+            if (n_data!=0) {
+                // The new value that will be added is:
+                double y_new=data[n_data+templ.size()-1];
+                double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
+                sum_data+=y_new-y_old;
+                sum_data_sqr+=y2_new-y2_old;
             }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-            sum_data_sqr+=y2_new-y2_old;
+            // The first value that was added (and will have to be subtracted during
+            // the next loop):
+            y_old=data[n_data+0];
+            y2_old=data[n_data+0]*data[n_data+0];
+
+            double stdata=sum_templ_data[n_data-n_chunk];
+            double scale=(stdata-sum_templ*sum_data/templ.size())/
+                (sum_templ_sqr-sum_templ*sum_templ/templ.size());
+            double offset=(sum_data-scale*sum_templ)/templ.size();
+            double sse=sum_data_sqr+scale*scale*sum_templ_sqr+templ.size()*offset*offset -
+                2.0*(scale*stdata +
+                     offset*sum_data-scale*offset*sum_templ);
+            double standard_error=sqrt(sse/(templ.size()-1));
+            detection_criterion[n_data]=(scale/standard_error);
         }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-        y2_old=data[n_data+0]*data[n_data+0];
-
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-            (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
-        double sse=sum_data_sqr+scale*scale*sum_templ_sqr+templ.size()*offset*offset -
-            2.0*(scale*sum_templ_data +
-                 offset*sum_data-scale*offset*sum_templ);
-        double standard_error=sqrt(sse/(templ.size()-1));
-        detection_criterion[n_data]=(scale/standard_error);
     }
     return detection_criterion;
 }
@@ -334,6 +586,77 @@ stfnum::peakIndices(const Vector_double& data, double threshold,
     return peakInd;
 }
 
+stfnum::LinCorrStream::LinCorrStream(const Vector_double& templ_)
+    : templ(templ_), tail(), work(), dots(), sum_templ(0.0), ss_templ(0.0), n_done(0)
+{
+    if (templ.size()==0) {
+        throw std::runtime_error("Array of size 0 in stfnum::LinCorrStream");
+    }
+    for (Vector_double::const_iterator cit=templ.begin(); cit!=templ.end(); ++cit) {
+        sum_templ+=*cit;
+    }
+    double mean_templ=sum_templ/templ.size();
+    for (Vector_double::const_iterator cit=templ.begin(); cit!=templ.end(); ++cit) {
+        ss_templ+=SQR(*cit-mean_templ);
+    }
+    tail.reserve(templ.size());
+}
+
+std::size_t
+stfnum::LinCorrStream::Push(const double* data, std::size_t n_data, double* out)
+{
+    std::size_t n_templ=templ.size();
+    work.assign(tail.begin(), tail.end());
+    work.insert(work.end(), data, data+n_data);
+    if (work.size()<n_templ) {
+        tail.swap(work);
+        return 0;
+    }
+    std::size_t n_out=work.size()-n_templ+1;
+    // Keep the last n_templ-1 points for the next chunk:
+    tail.assign(work.end()-(n_templ-1), work.end());
+
+    // Remove the mean of the chunk so that the sums of squares below
+    // don't suffer from cancellation when the data have a large offset.
+    // The correlation coefficient is invariant to this shift.
+    double ref=0.0;
+    for (Vector_double::iterator it=work.begin(); it!=work.end(); ++it) {
+        ref+=*it;
+    }
+    ref/=work.size();
+    for (Vector_double::iterator it=work.begin(); it!=work.end(); ++it) {
+        *it-=ref;
+    }
+
+    dots.resize(n_out);
+    slidingDotProduct(&work[0], work.size(), templ, &dots[0]);
+
+    double sum_data=0.0, sum_data_sqr=0.0;
+    for (std::size_t n_t=0; n_t<n_templ; ++n_t) {
+        sum_data+=work[n_t];
+        sum_data_sqr+=work[n_t]*work[n_t];
+    }
+    for (std::size_t n_point=0; n_point<n_out; ++n_point) {
+        if (n_point!=0) {
+            double y_old=work[n_point-1];
+            double y_new=work[n_point+n_templ-1];
+            sum_data+=y_new-y_old;
+            sum_data_sqr+=y_new*y_new-y_old*y_old;
+        }
+        // The optimally scaled template (scale*templ+offset) has the same
+        // correlation with the data as the template itself, up to the sign of
+        // the scale, which is the sign of the covariance; hence,
+        // r = n/(n-1) * |cov(data,templ)| / (sd(data)*sd(templ)),
+        // where the n/(n-1) factor stems from the SDs computed with 1/n.
+        double ss_templ_data=dots[n_point]-sum_templ*sum_data/n_templ;
+        double ss_data=std::max(sum_data_sqr-sum_data*sum_data/n_templ, 0.0);
+        out[n_point]=(double)n_templ/(double)(n_templ-1)*fabs(ss_templ_data)/
+            sqrt(ss_data*ss_templ);
+    }
+    n_done+=n_out;
+    return n_out;
+}
+
 Vector_double
 stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
 {
@@ -346,79 +669,27 @@ stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::Pr
         throw std::runtime_error("Array of size 0 in stfnum::crossCorr");
     }
     Vector_double Corr(data.size()-templ.size());
-
-    // Optimal scaling & offset:
-    // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
-    for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
-        sum_data+=data[0+n_templ];
-        sum_data_sqr+=data[0+n_templ]*data[0+n_templ];
-        sum_templ+=templ[n_templ];
-        sum_templ_sqr+=templ[n_templ]*templ[n_templ];
+    if (Corr.empty()) {
+        return Corr;
     }
-    double y_old=0.0;
-    double y2_old=0.0;
-    int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating correlation coefficient", &skipped );
-            if (skipped) {
-                Corr.resize(0);
-                return Corr;
-            }
-            progCounter++;
-        }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
-            }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-            sum_data_sqr+=y2_new-y2_old;
-        }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-        y2_old=data[n_data+0]*data[n_data+0];
-
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-        (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
-
-        // Now that the optimal template has been found,
-        // compute the correlation between data and optimal template.
-        // The correlation coefficient is computed in a way that avoids
-        // numerical instability; therefore, the sum of squares
-        // computed above can't be re-used.
-        // Get the means:
-        double mean_data=sum_data/templ.size();
-        double sum_optTempl=sum_templ*scale+offset*templ.size();
-        double mean_optTempl=sum_optTempl/templ.size();
-
-        // Get SDs:
-        double sd_data=0.0;
-        double sd_templ=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            sd_data+=SQR(data[i+n_data]-mean_data);
-            sd_templ+=SQR(templ[i]*scale+offset-mean_optTempl);
-        }
-        sd_data=sqrt(sd_data/templ.size());
-        sd_templ=sqrt(sd_templ/templ.size());
 
-        // Get correlation:
-        double r=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            r+=(data[i+n_data]-mean_data)*(templ[i]*scale+offset-mean_optTempl);
+    LinCorrStream stream(templ);
+    std::size_t n_chunk_max=std::max(MIN_CHUNK_SIZE, data.size()/100+1);
+    Vector_double chunkCorr(n_chunk_max);
+    std::size_t n_corr=0;
+    for (std::size_t n_chunk=0; n_chunk<data.size() && n_corr<Corr.size(); n_chunk+=n_chunk_max) {
+        progDlg.Update( (int)((double)n_corr/(double)Corr.size()*100.0),
+                        "Calculating correlation coefficient", &skipped );
+        if (skipped) {
+            Corr.resize(0);
+            return Corr;
         }
-        r/=((templ.size()-1)*sd_data*sd_templ);
-        Corr[n_data]=r;
+        std::size_t n_chunk_size=std::min(n_chunk_max, data.size()-n_chunk);
+        std::size_t n_new=stream.Push(&data[n_chunk], n_chunk_size, &chunkCorr[0]);
+        // The last window is not part of the result:
+        n_new=std::min(n_new, Corr.size()-n_corr);
+        std::copy(chunkCorr.begin(), chunkCorr.begin()+n_new, Corr.begin()+n_corr);
+        n_corr+=n_new;
     }
     return Corr;
 }
@@ -711,8 +982,10 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
 	// Normalize data
     double fmax = *std::max_element(dataIn.begin(), dataIn.end());
     double fmin = *std::min_element(dataIn.begin(), dataIn.end());
-    Vector_double data = stfio::vec_scal_minus(dataIn, fmin);
-    data = stfio::vec_scal_div(data, fmax-fmin);
+    Vector_double data(dataIn.size());
+    if (!data.empty()) {
+        stfio::vec_affine(&dataIn[0], dataIn.size(), 1.0/(fmax-fmin), -fmin/(fmax-fmin), &data[0]);
+    }
 
     bool skipped = false;
     progDlg.Update( 0, "Starting deconvolution...", &skipped );
@@ -720,8 +993,11 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         std::out_of_range e("subscript out of range in stfnum::filter()");
         throw e;
     }
+    //buffers and plans are reused for transforms of equal size:
+    FFTWorkspace fft_data(data.size()), fft_templ(data.size());
+
     /* pad templ */
-    double* in_templ_padded =(double *)fftw_malloc(sizeof(double) * data.size());
+    double* in_templ_padded = fft_templ.Real();
     std::copy(templ.begin(), templ.end(), in_templ_padded);
     if (templ.size() < data.size()) {
         for (size_t kp=templ.size(); kp<data.size(); ++kp)
@@ -737,25 +1013,18 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
     //fftw_complex is a double[2]; hence, out is an array of
     //double[2] with out[n][0] being the real and out[n][1] being
     //the imaginary part.
-    fftw_plan p_data, p_templ, p_inv;
-
-    //memory allocation as suggested by fftw:
-    double* in_data =(double *)fftw_malloc(sizeof(double) * data.size());
+    double* in_data = fft_data.Real();
     std::copy(data.begin(), data.end(), in_data);
-    fftw_complex* out_data = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
+    fftw_complex* out_data = fft_data.Complex();
 
-    //plan the ffts and execute them:
-    p_data =fftw_plan_dft_r2c_1d((int)data.size(), in_data, out_data,
-                                 FFTW_ESTIMATE);
-    fftw_execute(p_data);
+    //execute the ffts:
+    fft_data.Forward();
     if (isnan(out_data[0][0]) || isinf(out_data[0][0])) {
         data_return.resize(0);
         throw std::runtime_error("Unstable fft; try again avoiding any test pulses (if present)");
     }
-    fftw_complex* out_templ_padded = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
-    p_templ =fftw_plan_dft_r2c_1d((int)data.size(),
-                                  in_templ_padded, out_templ_padded, FFTW_ESTIMATE);
-    fftw_execute(p_templ);
+    fftw_complex* out_templ_padded = fft_templ.Complex();
+    fft_templ.Forward();
 
     double SI=1.0/SR; //the sampling interval
     progDlg.Update( 25, "Performing deconvolution...", &skipped );
@@ -793,8 +1062,7 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
     }
 
     //do the reverse fft:
-    p_inv = fftw_plan_dft_c2r_1d((int)data.size(),out_data, in_data, FFTW_ESTIMATE);
-    fftw_execute(p_inv);
+    fft_data.Backward();
 
     //fill the return array, adding the offset, and scaling by data.size()
     //(because fftw computes an unnormalized transform):
@@ -802,15 +1070,6 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         data_return[n_point]= in_data[n_point]/data.size();
     }
 
-    fftw_destroy_plan(p_data);
-    fftw_destroy_plan(p_templ);
-    fftw_destroy_plan(p_inv);
-
-    fftw_free(in_data);
-    fftw_free(out_data);
-    fftw_free(in_templ_padded);
-    fftw_free(out_templ_padded);
-
     progDlg.Update( 50, "Computing data histogram...", &skipped );
     if (skipped) {
         data_return.resize(0);
@@ -866,13 +1125,16 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
 #endif
 
     Vector_double opts = LM_default_opts();
-    std::vector< stfnum::storedFunc > funcLib = stfnum::GetFuncLib();
+    const stfnum::storedFunc* gauss = stfnum::FindFunc("Gaussian");
+    if (gauss == NULL) {
+        throw std::runtime_error("Gaussian missing from the function library in stfnum::deconvolve()");
+    }
     std::string info;
     int warning;
 #ifdef _STFDEBUG
     double chisqr =
 #endif
-        lmFit(histo_fit, interval, funcLib[funcLib.size()-2], opts, true,
+        lmFit(histo_fit, interval, *gauss, opts, true,
               pars, info, warning );
 #ifdef _STFDEBUG
     std::cout << chisqr << "\t" << interval << std::endl;
@@ -79,6 +79,19 @@ typedef boost::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef boost::function<double(double, double, double, double, double)> Scale;
 
+//! A function evaluated at equally spaced points.
+/*! Takes the x-value of the first point, the spacing between points, the
+ *  number of points and a vector of parameters, and writes one function
+ *  value per point to the buffer passed as the last argument.
+ */
+typedef boost::function<void(double, double, std::size_t, const Vector_double&, double*)> FuncArray;
+
+//! The jacobian of a stfnum::FuncArray.
+/*! Same arguments as stfnum::FuncArray; the buffer receives one row of
+ *  derivatives with respect to all parameters per point (row-major).
+ */
+typedef boost::function<void(double, double, std::size_t, const Vector_double&, double*)> JacArray;
+
 #else
 
 typedef std::function<double(double, const Vector_double&)> Func;
@@ -89,6 +102,19 @@ typedef std::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef std::function<double(double, double, double, double, double)> Scale;
 
+//! A function evaluated at equally spaced points.
+/*! Takes the x-value of the first point, the spacing between points, the
+ *  number of points and a vector of parameters, and writes one function
+ *  value per point to the buffer passed as the last argument.
+ */
+typedef std::function<void(double, double, std::size_t, const Vector_double&, double*)> FuncArray;
+
+//! The jacobian of a stfnum::FuncArray.
+/*! Same arguments as stfnum::FuncArray; the buffer receives one row of
+ *  derivatives with respect to all parameters per point (row-major).
+ */
+typedef std::function<void(double, double, std::size_t, const Vector_double&, double*)> JacArray;
+
 #endif
 //! Dummy function, serves as a placeholder to initialize functions without a Jacobian.
 Vector_double nojac( double x, const Vector_double& p);
@@ -264,12 +290,17 @@ struct StfioDll storedFunc {
      *  \param hasJac_ true if a Jacobian is available.
      *  \param init_ A function for initialising the parameters.
      *  \param output_ Output of the fit.
+     *  \param funcArray_ Optional whole-array version of func_.
+     *  \param jacArray_ Optional whole-array version of jac_.
      */
     storedFunc( const std::string& name_, const std::vector<parInfo>& pInfo_,
             const Func& func_, const Init& init_, const Jac& jac_, bool hasJac_ = true,
-            const Output& output_ = defaultOutput /*,
+            const Output& output_ = defaultOutput,
+            const FuncArray& funcArray_ = FuncArray(),
+            const JacArray& jacArray_ = JacArray() /*,
             bool hasId_ = true*/
-    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_) /*, hasId(hasId_)*/
+    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_),
+        funcArray(funcArray_), jacArray(jacArray_) /*, hasId(hasId_)*/
     {
 /*        if (hasId) {
             id = NextId();
@@ -292,8 +323,29 @@ struct StfioDll storedFunc {
     Jac jac;                     /*!< Jacobian of func. */
     bool hasJac;                 /*!< True if the function has an analytic Jacobian. */
     Output output;               /*!< Output of the fit. */
+    FuncArray funcArray;         /*!< Whole-array version of func; may be empty. */
+    JacArray jacArray;           /*!< Whole-array version of jac; may be empty. */
 //    bool hasId;                  /*!< Determines whether a function should have an id. */
 
+    //! Evaluates the function at equally spaced points.
+    /*! Uses funcArray if available, func otherwise.
+     *  \param x0 x-value of the first point.
+     *  \param dx Spacing between points.
+     *  \param n Number of points.
+     *  \param p Function parameters.
+     *  \param y Receives \e n function values.
+     */
+    void EvalFunc(double x0, double dx, std::size_t n, const Vector_double& p, double* y) const;
+
+    //! Evaluates the Jacobian at equally spaced points.
+    /*! Uses jacArray if available, jac otherwise.
+     *  \param x0 x-value of the first point.
+     *  \param dx Spacing between points.
+     *  \param n Number of points.
+     *  \param p Function parameters.
+     *  \param j Receives \e n rows of p.size() derivatives.
+     */
+    void EvalJac(double x0, double dx, std::size_t n, const Vector_double& p, double* j) const;
 };
 
 //! Calculates the square of a number.
@@ -303,6 +355,80 @@ struct StfioDll storedFunc {
 template <typename T>
 T SQR (T a);
 
+//! Aligned buffers and cached FFTW plans for real transforms of a given size.
+/*! Buffers are taken from a pool on construction and returned to it on
+ *  destruction, so that repeated transforms of equal size neither allocate
+ *  memory nor create plans. Plans are created once per transform size and
+ *  shared between threads; access to the pool and to the FFTW planner is
+ *  serialized, so workspaces can be used concurrently from several threads.
+ */
+class StfioDll FFTWorkspace {
+public:
+    //! Constructor
+    /*! \param n The transform size.
+     */
+    explicit FFTWorkspace(std::size_t n);
+
+    //! Destructor. Returns the buffers to the pool.
+    ~FFTWorkspace();
+
+    //! Retrieves the real buffer.
+    /*! \return Pointer to an array of size() doubles.
+     */
+    double* Real() { return in; }
+
+    //! Retrieves the complex buffer.
+    /*! \return Pointer to an array of size()/2+1 complex values.
+     */
+    fftw_complex* Complex() { return out; }
+
+    //! Retrieves the transform size.
+    /*! \return The transform size.
+     */
+    std::size_t size() const { return n; }
+
+    //! Transforms the real buffer into the complex buffer.
+    void Forward();
+
+    //! Transforms the complex buffer back into the real buffer.
+    /*! The transform is unnormalized and overwrites the complex buffer.
+     */
+    void Backward();
+
+private:
+    FFTWorkspace(const FFTWorkspace&);
+    FFTWorkspace& operator=(const FFTWorkspace&);
+
+    std::size_t n;
+    double* in;
+    fftw_complex* out;
+    fftw_plan p_fwd, p_bwd;
+};
+
+//! Selects how FFTW plans are created.
+/*! Cached plans are discarded if the mode changes. Must not be called while transforms are running.
+ *  \param measure true if plans should be created with FFTW_MEASURE (slower
+ *         planning, faster transforms), false for FFTW_ESTIMATE (the default).
+ */
+StfioDll void fftwSetMeasure(bool measure);
+
+//! Loads FFTW wisdom from a file.
+/*! \param filename Path to the wisdom file.
+ *  \return true if the wisdom could be read, false otherwise.
+ */
+StfioDll bool fftwImportWisdom(const std::string& filename);
+
+//! Saves the accumulated FFTW wisdom to a file.
+/*! \param filename Path to the wisdom file.
+ *  \return true if the wisdom could be written, false otherwise.
+ */
+StfioDll bool fftwExportWisdom(const std::string& filename);
+
+//! Destroys all cached FFTW plans and frees all pooled buffers.
+/*! Must not be called while an stfnum::FFTWorkspace exists.
+ */
+StfioDll void fftwClearCache();
+
 //! Convolves a data set with a filter function.
 /*! \param toFilter The valarray to be filtered.
  *  \param filter_start The index from which to start filtering.
@@ -428,9 +554,29 @@ StfioDll Vector_double
 quad(const Vector_double& data, std::size_t begin, std::size_t end);
  
 
+//! Computes the dot product of a template with every window of a data set.
+/*! Short templates are processed by direct summation, long templates
+ *  by overlap-save FFT correlation.
+ *  \param data Pointer to the first data point.
+ *  \param n_data Number of data points; must not be smaller than \e templ.size().
+ *  \param templ The template waveform.
+ *  \param out Receives n_data-templ.size()+1 values, where out[i] is
+ *         the sum of templ[k]*data[i+k] over all template points k.
+ */
+StfioDll void
+slidingDotProduct(
+        const double* data,
+        std::size_t n_data,
+        const Vector_double& templ,
+        double* out
+);
+
 //! Computes the event detection criterion according to Clements & Bekkers (1997).
-/*! \param data The valarray from which to extract events.
+/*! The products of template and data are computed with stfnum::slidingDotProduct(),
+ *  so that long templates are handled in O(N log M) time.
+ *  \param data The valarray from which to extract events.
  *  \param templ A template waveform that is used for event detection.
+ *  \param progDlg Progress indicator.
  *  \return The detection criterion for every value of \e data.
  */
 StfioDll Vector_double
@@ -452,10 +598,45 @@ StfioDll std::vector<int> peakIndices(const Vector_double& data, double threshol
 //! Computes the linear correlation between two arrays.
 /*! \param va1 First array.
  *  \param va2 Second array.
+ *  \param progDlg Progress indicator.
  *  \return The linear correlation between the two arrays for each data point of \e va1.
  */
 StfioDll Vector_double linCorr(const Vector_double& va1, const Vector_double& va2, stfio::ProgressInfo& progDlg); 
 
+//! Computes the linear correlation between a template and a data stream.
+/*! Data are passed in chunks of arbitrary size, and the correlation
+ *  coefficient of every template-sized window is returned as soon as the
+ *  window is complete. Template products are computed with
+ *  stfnum::slidingDotProduct(), the sums of the data with running window sums.
+ *  Memory use is bounded by the chunk size plus the template size.
+ */
+class StfioDll LinCorrStream {
+public:
+    //! Constructor
+    /*! \param templ The template waveform.
+     */
+    explicit LinCorrStream(const Vector_double& templ);
+
+    //! Processes the next chunk of data.
+    /*! \param data Pointer to the first data point of the chunk.
+     *  \param n_data Number of data points in the chunk.
+     *  \param out Receives the correlation coefficients of all windows
+     *         that were completed by this chunk; needs room for \e n_data values.
+     *  \return The number of values written to \e out.
+     */
+    std::size_t Push(const double* data, std::size_t n_data, double* out);
+
+    //! Retrieves the number of correlation coefficients computed so far.
+    /*! \return The number of windows that have been completed.
+     */
+    std::size_t Count() const { return n_done; }
+
+private:
+    Vector_double templ, tail, work, dots;
+    double sum_templ, ss_templ;
+    std::size_t n_done;
+};
+
 //! Computes a Gaussian that can be used as a filter kernel.
 /*! \f[
  *      f(x) = \mathrm{e}^{-0.3466 \left( \frac{x}{p_{0}} \right) ^2}   
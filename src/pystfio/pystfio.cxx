@@ -109,6 +109,24 @@ bool _read(const std::string& filename, const std::string& ftype, bool verbose,
     return true;
 }
 
+// Reports progress on standard output and lets Ctrl-C skip the operation;
+// the KeyboardInterrupt is raised when the wrapped function returns NULL:
+class PyProgressInfo : public stfio::StdoutProgressInfo {
+public:
+    PyProgressInfo(const std::string& title, const std::string& message, int maximum, bool verbose)
+        : StdoutProgressInfo(title, message, maximum, verbose) {}
+    bool Update(int value, const std::string& newmsg="", bool* skip=NULL) {
+        StdoutProgressInfo::Update(value, newmsg, skip);
+        if (PyErr_CheckSignals() < 0) {
+            if (skip != NULL) {
+                *skip = true;
+            }
+            return false;
+        }
+        return true;
+    }
+};
+
 PyObject* detect_events(double* data, int size_data, double* templ, int size_templ,
                         double dt, const std::string& mode, bool norm, double lowpass, double highpass)
 {
@@ -125,26 +143,57 @@ PyObject* detect_events(double* data, int size_data, double* templ, int size_tem
         } else {
             basel = fmin;
         }
-        vtempl = stfio::vec_scal_minus(vtempl, basel);
-        fmin = *std::min_element(vtempl.begin(), vtempl.end());
-        fmax = *std::max_element(vtempl.begin(), vtempl.end());
+        // Subtracting the baseline shifts the extrema by the same amount,
+        // so that both steps can be done in a single pass:
+        fmin -= basel;
+        fmax -= basel;
         if (fabs(fmin) > fabs(fmax)) {
             normval = fabs(fmin);
         } else {
             normval = fabs(fmax);
         }
-        vtempl = stfio::vec_scal_div(vtempl, normval);
+        stfio::vec_affine(vtempl, 1.0/normval, -basel/normval);
     }
+    if (mode=="correlation") {
+        // Stream the correlation directly from the input into the
+        // output array so that no copy of either is held in memory:
+        if (size_templ <= 0 || size_data < size_templ) {
+            std::cerr << "Template larger than data in detect_events" << std::endl;
+            return Py_BuildValue("");
+        }
+        PyProgressInfo progDlg("Computing linear correlation...", "Computing linear correlation...", 100, true);
+        npy_intp dims[1] = {(int)(size_data-size_templ)};
+        PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+        double* gDataP = (double*)array_data(np_array);
+
+        stfnum::LinCorrStream stream(vtempl);
+        std::size_t n_chunk_max = 1 << 16;
+        Vector_double chunkCorr(n_chunk_max);
+        std::size_t n_corr = 0, n_total = dims[0];
+        bool skipped = false;
+        for (std::size_t n_chunk=0; n_chunk<(std::size_t)size_data && n_corr<n_total; n_chunk+=n_chunk_max) {
+            progDlg.Update((int)((double)n_corr/(double)n_total*100.0),
+                           "Computing linear correlation...", &skipped);
+            if (skipped) {
+                Py_DECREF(np_array);
+                return NULL;
+            }
+            std::size_t n_chunk_size = std::min(n_chunk_max, (std::size_t)size_data-n_chunk);
+            std::size_t n_new = stream.Push(&data[n_chunk], n_chunk_size, &chunkCorr[0]);
+            n_new = std::min(n_new, n_total-n_corr);
+            std::copy(chunkCorr.begin(), chunkCorr.begin()+n_new, &gDataP[n_corr]);
+            n_corr += n_new;
+        }
+        return np_array;
+    }
+
     Vector_double trace(data, &data[size_data]);
     Vector_double detect(size_data);
     if (mode=="criterion") {
-        stfio::StdoutProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100, true);
+        PyProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100, true);
         detect = stfnum::detectionCriterion(trace, vtempl, progDlg);
-    } else if (mode=="correlation") {
-        stfio::StdoutProgressInfo progDlg("Computing linear correlation...", "Computing linear correlation...", 100, true);
-        detect = stfnum::linCorr(trace, vtempl, progDlg);
     } else if (mode=="deconvolution") {
-        stfio::StdoutProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100, true);
+        PyProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100, true);
         try {
             detect = stfnum::deconvolve(trace, vtempl, 1.0/dt, highpass, lowpass, progDlg);
         } catch (const std::runtime_error& e) {
@@ -152,6 +201,10 @@ PyObject* detect_events(double* data, int size_data, double* templ, int size_tem
             return Py_BuildValue("");
         }
     }
+    if (PyErr_Occurred()) {
+        // skipped by Ctrl-C:
+        return NULL;
+    }
     npy_intp dims[1] = {(int)detect.size()};
     PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
     double* gDataP = (double*)array_data(np_array);
@@ -191,6 +244,10 @@ PyObject* peak_detection(double* invec, int size, double threshold, int min_dist
         
 }
 
+void affine(double* inplace, int size_inplace, double a, double b) {
+    stfio::vec_affine(inplace, size_inplace, a, b, inplace);
+}
+
 double risetime(double* invec, int size, double base, double amp, double frac) {
     wrap_array();
 
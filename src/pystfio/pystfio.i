@@ -19,6 +19,7 @@ common electrophysiology file formats"
 #include "./../libstfio/recording.h"
 #include "./../libstfio/channel.h"
 #include "./../libstfio/section.h"
+#include "./../libstfio/hdf5/hdf5lib.h"
 
 #include "pystfio.h"
 
@@ -38,6 +39,7 @@ static int myErr = 0; // flag to save error state
 %apply (TYPE* IN_ARRAY1, int DIM1) {(TYPE* invec, int size)};
 %apply (TYPE* IN_ARRAY1, int DIM1) {(TYPE* data, int size_data)};
 %apply (TYPE* IN_ARRAY1, int DIM1) {(TYPE* templ, int size_templ)};
+%apply (TYPE* INPLACE_ARRAY1, int DIM1) {(TYPE* inplace, int size_inplace)};
 
 %enddef    /* %apply_numpy_typemaps() macro */
 
@@ -151,6 +153,7 @@ class Section {
     }
     int __len__() { return $self->size(); }
 
+    %feature("kwargs") write;
     %feature("autodoc", "Writes a Recording to a file.
 
     Arguments:
@@ -161,13 +164,27 @@ class Section {
     ftype  -- file type (string). At present, \"hdf5\", \"gdf\", \"cfs\" and \"ibw\" are supported.
 #endif // TEST_MINIMAL
     verbose-- Show info while writing
+    layout -- Layout of hdf5 files: \"sections\" (default) stores each
+              section in its own group; \"channels\" stores each channel
+              in a single dataset, which is much faster for many sections
+              but can't be read by older versions.
+    compression -- Deflate level (1-9) of the \"channels\" layout; 0
+              disables compression.
 
     Returns:
     True upon successful completion.") write;
-    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false) {
+    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false,
+               const std::string& layout="sections", int compression=0) {
         stfio::filetype stftype = gettype(ftype);
         stfio::StdoutProgressInfo progDlg("File export", "Writing file", 100, verbose);
         try {
+            if (layout == "channels" && stftype == stfio::hdf5) {
+                return stfio::exportHDF5File(fname, *($self), progDlg, stfio::hdf5_channels, compression);
+            }
+            if (layout != "sections") {
+                std::cerr << "Unknown layout " << layout << " for file type " << ftype << std::endl;
+                return false;
+            }
             return stfio::exportFile(fname, stftype, *($self), progDlg);
         } catch (const std::exception& e) {
             std::cerr << "Couldn't write to file:\n"
@@ -342,7 +359,8 @@ class Section {
     }
     double __getitem__(int at) {
         if (at >= 0 && at < (int)$self->size()) {
-            return (*($self))[at];
+            // The const operator[] reads a stored section without loading it.
+            return static_cast<const Section&>(*$self)[at];
         } else {
             myErr = 1;
             return 0;
@@ -350,15 +368,24 @@ class Section {
     }
     int __len__() { return $self->size(); }
 
-    %feature("autodoc", "Returns the section as a numpy array.") asarray;
-    PyObject* asarray() {
-        npy_intp dims[1] = {$self->size()};
+    %feature("autodoc", "Computes a*x+b for each data point in place.") affine;
+    void affine(double a, double b) {
+        stfio::vec_affine($self->get_w(), a, b);
+    }
+
+    %feature("autodoc", "Returns the section or the data points from start up to stop as a numpy array.
+Sections of large HDF5 files are read from the file on demand; only the
+requested data points are read.") asarray;
+    PyObject* asarray(int start=0, int stop=-1) {
+        int size = $self->size();
+        if (stop < 0 || stop > size) stop = size;
+        if (start < 0) start = 0;
+        if (start > stop) start = stop;
+        npy_intp dims[1] = {stop-start};
         PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
         double* gDataP = (double*)array_data(np_array);
 
-        std::copy( $self->get().begin(),
-                   $self->get().end(),
-                   gDataP);
+        $self->Read(start, stop-start, gDataP);
         return np_array;
     };
 }
@@ -413,6 +440,20 @@ Arguments:
 double risetime(double* invec, int size, double base, double amp, double frac=0.2);
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("autodoc", 0) affine;
+%feature("kwargs") affine;
+%feature("docstring", "Computes a*x+b for each element of a numpy array in place,
+in a single pass and without allocating memory.
+
+Arguments:
+inplace -- contiguous numpy array of doubles; overwritten with the result
+a       -- scaling factor
+b       -- offset that is added after scaling
+") affine;
+void affine(double* inplace, int size_inplace, double a, double b);
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %pythoncode {
 import os
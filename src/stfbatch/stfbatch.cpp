@@ -0,0 +1,581 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file stfbatch.cpp
+ *  \brief Batch analysis of recordings from the command line.
+ *
+ *  stfbatch reads a cursor configuration file (*.csr) saved from the
+ *  cursor settings dialog of Stimfit, measures every section (or the
+ *  average) of a list of recordings and writes the results to a CSV or
+ *  an HDF5 file. Files are processed in parallel; no display is needed.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <stdexcept>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include "hdf5.h"
+#if H5_VERS_MINOR > 6
+  #include "hdf5_hl.h"
+#else
+  #include "H5TA.h"
+#endif
+
+#include "../libstfio/stfio.h"
+#include "../libstfio/hdf5/hdf5lib.h"
+#include "../libstfnum/stfnum.h"
+#include "../libstfnum/funclib.h"
+#include "../libstfnum/batch.h"
+
+static void usage() {
+    std::cerr
+        << "Usage: stfbatch [options] CONFIG.csr FILE...\n"
+        << "Measures all sections of each FILE with the cursor settings in CONFIG.\n\n"
+        << "Options:\n"
+        << "  -o FILE     Write results to FILE (.csv or .h5); default: standard output\n"
+        << "  -c N        Channel to be measured (default: 0)\n"
+        << "  -r N        Channel whose events mark the start of the latency\n"
+        << "  -m LIST     Comma-separated list of results (default: base,peakbase,rtlohi,t50):\n"
+        << "              base basesd threshold thresholdtime peakzero peakbase\n"
+        << "              peakthreshold peaktime rtlohi innerrtlohi outerrtlohi t50 t50se\n"
+        << "              slopes slopetimes latency pslope\n"
+        << "  -f N        Fit function N to the decay (see -l)\n"
+        << "  -l          List the fit functions and exit\n"
+        << "  -t VALUE    Count the crossings of VALUE\n"
+        << "  -a          Measure the average of all sections instead of each section\n"
+        << "  -s TYPE, --storage TYPE\n"
+        << "              Hold the data points as float64 (default), float32 or int16\n"
+        << "  -M SIZE, --max-memory SIZE\n"
+        << "              Limit the memory of the recordings that have been read but not\n"
+        << "              yet measured to about SIZE bytes; K, M and G suffixes are\n"
+        << "              accepted (default: no limit)\n"
+        << "  -j N        Number of threads (default: all cores; needs OpenMP)\n"
+        << "  -v          Report progress on standard error\n";
+}
+
+static std::string toLower(const std::string& str) {
+    std::string lower(str);
+    for (std::size_t n=0; n < lower.size(); ++n) {
+        lower[n] = (char)tolower(lower[n]);
+    }
+    return lower;
+}
+
+static stfio::storagetype parseStorage(const std::string& name) {
+    std::string lower = toLower(name);
+    if (lower == "float64") return stfio::float64;
+    if (lower == "float32") return stfio::float32;
+    if (lower == "int16") return stfio::int16;
+    throw std::runtime_error("Unknown storage type " + name);
+}
+
+static std::string trim(const std::string& str) {
+    std::size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    std::size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, last-first+1);
+}
+
+// A number of bytes with an optional K, M or G suffix:
+static std::size_t parseBytes(const std::string& value) {
+    char* end = NULL;
+    double bytes = strtod(value.c_str(), &end);
+    std::string suffix = toLower(trim(end));
+    if (suffix == "k") bytes *= 1024.0;
+    else if (suffix == "m") bytes *= 1024.0*1024.0;
+    else if (suffix == "g") bytes *= 1024.0*1024.0*1024.0;
+    else if (!suffix.empty() || end == value.c_str()) {
+        throw std::runtime_error("Invalid memory size " + value);
+    }
+    if (!(bytes >= 0)) {
+        throw std::runtime_error("Invalid memory size " + value);
+    }
+    return (std::size_t)bytes;
+}
+
+// Reads the "group/key = value" entries of an ini file. Keys are
+// case-insensitive, like those of wxFileConfig.
+static std::map<std::string, std::string> readConf(const std::string& fName) {
+    std::ifstream file(fName.c_str());
+    if (!file) {
+        throw std::runtime_error("Couldn't open " + fName);
+    }
+    std::map<std::string, std::string> entries;
+    std::string line, group;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        if (line[0] == '[') {
+            group = toLower(trim(line.substr(1, line.find(']')-1)));
+            continue;
+        }
+        std::size_t eq = line.find('=');
+        if (eq != std::string::npos) {
+            entries[group + "/" + toLower(trim(line.substr(0, eq)))] = trim(line.substr(eq+1));
+        }
+    }
+    return entries;
+}
+
+static bool confValue(const std::map<std::string, std::string>& conf, const std::string& key,
+                      double& value)
+{
+    std::map<std::string, std::string>::const_iterator it = conf.find(toLower(key));
+    if (it == conf.end()) {
+        return false;
+    }
+    std::istringstream is(it->second);
+    return (bool)(is >> value);
+}
+
+// Converts a latency mode as written by the cursor settings dialog:
+static stfnum::event_point latencyPoint(double mode) {
+    switch ((int)mode) {
+     case stfnum::peakPoint:
+     case stfnum::risePoint:
+     case stfnum::halfPoint:
+     case stfnum::footPoint:
+         return (stfnum::event_point)(int)mode;
+     default:
+         return stfnum::manualPoint;
+    }
+}
+
+// Sets the cursors from a cursor configuration file saved by Stimfit:
+static void readCursorConf(const std::string& fName, stfnum::BatchSettings& settings) {
+    std::map<std::string, std::string> conf = readConf(fName);
+    if (conf.empty()) {
+        throw std::runtime_error(fName + " is not a cursor configuration file");
+    }
+    double value = 0.0;
+    if (confValue(conf, "__BASE__/LeftCursor", value)) settings.baseBeg = (std::size_t)value;
+    if (confValue(conf, "__BASE__/RightCursor", value)) settings.baseEnd = (std::size_t)value;
+    if (confValue(conf, "__BASE__/BaselineMethod", value))
+        settings.baselineMethod = ((int)value == 1) ? stfnum::median_iqr : stfnum::mean_sd;
+    if (confValue(conf, "__PEAK__/LeftCursor", value)) settings.peakBeg = (std::size_t)value;
+    if (confValue(conf, "__PEAK__/RightCursor", value)) settings.peakEnd = (std::size_t)value;
+    if (confValue(conf, "__PEAK__/PeakAtEnd", value)) settings.peakAtEnd = (value != 0);
+    if (confValue(conf, "__PEAK__/NumberOfPoints", value)) settings.pM = (int)value;
+    if (confValue(conf, "__PEAK__/Direction", value)) {
+        switch ((int)value) {
+         case 0: settings.direction = stfnum::up; break;
+         case 1: settings.direction = stfnum::down; break;
+         default: settings.direction = stfnum::both;
+        }
+    }
+    if (confValue(conf, "__PEAK__/FromBase", value)) settings.fromBase = (value != 0);
+    if (confValue(conf, "__PEAK__/RTFactor", value)) settings.RTFactor = (int)value;
+    if (confValue(conf, "__PEAK__/Slope", value)) settings.slopeForThreshold = value;
+    if (confValue(conf, "__DECAY__/LeftCursor", value)) settings.fitBeg = (std::size_t)value;
+    if (confValue(conf, "__DECAY__/RightCursor", value)) settings.fitEnd = (std::size_t)value;
+    if (confValue(conf, "__DECAY__/StartFitAtPeak", value)) settings.startFitAtPeak = (value != 0);
+    if (confValue(conf, "__LATENCY__/LeftCursor", value)) settings.latencyBeg = value;
+    if (confValue(conf, "__LATENCY__/RightCursor", value)) settings.latencyEnd = value;
+    if (confValue(conf, "__LATENCY__/LeftMode", value)) settings.latencyStartMode = latencyPoint(value);
+    if (confValue(conf, "__LATENCY__/RightMode", value)) settings.latencyEndMode = latencyPoint(value);
+}
+
+static unsigned int parseColumns(const std::string& list) {
+    static const char* names[] = {
+        "base", "basesd", "threshold", "thresholdtime", "peakzero", "peakbase",
+        "peakthreshold", "peaktime", "rtlohi", "innerrtlohi", "outerrtlohi", "t50",
+        "t50se", "slopes", "slopetimes", "latency", "fit", "pslope", "crossings"
+    };
+    unsigned int columns = 0;
+    std::istringstream is(list);
+    std::string name;
+    while (std::getline(is, name, ',')) {
+        name = toLower(trim(name));
+        std::size_t n_c = 0;
+        while (n_c < sizeof(names)/sizeof(names[0]) && name != names[n_c]) {
+            ++n_c;
+        }
+        if (n_c == sizeof(names)/sizeof(names[0])) {
+            throw std::runtime_error("Unknown result: " + name);
+        }
+        columns |= (1u << n_c);
+    }
+    return columns;
+}
+
+// Receives the results of each file in order of completion.
+class ResultWriter {
+public:
+    virtual ~ResultWriter() {}
+    virtual void Write(std::size_t index, const std::string& fName, const stfnum::Table& table) = 0;
+};
+
+class CSVWriter : public ResultWriter {
+public:
+    explicit CSVWriter(std::ostream& out_) : out(out_), header(false) {}
+
+    void Write(std::size_t index, const std::string& fName, const stfnum::Table& table) {
+        if (!header) {
+            out << "File,Section";
+            for (std::size_t nCol=0; nCol < table.nCols(); ++nCol) {
+                out << "," << quote(table.GetColLabel(nCol));
+            }
+            out << "\n";
+            header = true;
+        }
+        out.precision(10);
+        for (std::size_t nRow=0; nRow < table.nRows(); ++nRow) {
+            out << quote(fName) << "," << quote(table.GetRowLabel(nRow));
+            for (std::size_t nCol=0; nCol < table.nCols(); ++nCol) {
+                out << ",";
+                if (!table.IsEmpty(nRow, nCol)) {
+                    out << table.at(nRow, nCol);
+                }
+            }
+            out << "\n";
+        }
+        out << std::flush;
+    }
+
+private:
+    static std::string quote(const std::string& str) {
+        if (str.find_first_of(",\"\n") == std::string::npos) {
+            return str;
+        }
+        std::string quoted("\"");
+        for (std::size_t n=0; n < str.size(); ++n) {
+            if (str[n] == '"') quoted += '"';
+            quoted += str[n];
+        }
+        return quoted + "\"";
+    }
+
+    std::ostream& out;
+    bool header;
+};
+
+// Writes one group per file containing the results, the column and the
+// section labels; empty cells are written as NaN. Each group is written
+// and flushed as soon as its file has been measured. HDF5 files may be
+// read by other threads in the meantime, so that the writer holds the
+// HDF5 lock of libstfio while it calls into the library.
+class HDF5Writer : public ResultWriter {
+public:
+    explicit HDF5Writer(const std::string& fName_) : fName(fName_), file_id(-1) {
+        stfio::HDF5Guard guard;
+        file_id = H5Fcreate(fName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        if (file_id < 0) {
+            throw std::runtime_error("Couldn't create " + fName);
+        }
+    }
+
+    ~HDF5Writer() {
+        stfio::HDF5Guard guard;
+        H5Fclose(file_id);
+    }
+
+    void Write(std::size_t index, const std::string& fName, const stfnum::Table& table) {
+        stfio::HDF5Guard guard;
+        writeTable(file_id, index, fName, table);
+        H5Fflush(file_id, H5F_SCOPE_LOCAL);
+    }
+
+private:
+    static void writeTable(hid_t file_id, std::size_t index, const std::string& fName,
+                           const stfnum::Table& table)
+    {
+        std::ostringstream path;
+        path << "/file" << index;
+        hid_t group = H5Gcreate2(file_id, path.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (group < 0) {
+            std::cerr << "stfbatch: Couldn't create " << path.str() << std::endl;
+            return;
+        }
+        H5LTset_attribute_string(file_id, path.str().c_str(), "filename", fName.c_str());
+
+        std::vector<std::string> colLabels(table.nCols()), rowLabels(table.nRows());
+        Vector_double values(table.nRows()*table.nCols(), NAN);
+        for (std::size_t nRow=0; nRow < table.nRows(); ++nRow) {
+            rowLabels[nRow] = table.GetRowLabel(nRow);
+            for (std::size_t nCol=0; nCol < table.nCols(); ++nCol) {
+                if (!table.IsEmpty(nRow, nCol)) {
+                    values[nRow*table.nCols()+nCol] = table.at(nRow, nCol);
+                }
+            }
+        }
+        for (std::size_t nCol=0; nCol < table.nCols(); ++nCol) {
+            colLabels[nCol] = table.GetColLabel(nCol);
+        }
+        if (!values.empty()) {
+            hsize_t dims[2] = { table.nRows(), table.nCols() };
+            H5LTmake_dataset_double(group, "results", 2, dims, &values[0]);
+        }
+        writeStrings(group, "columns", colLabels);
+        writeStrings(group, "sections", rowLabels);
+        H5Gclose(group);
+    }
+
+    static void writeStrings(hid_t group, const char* name, const std::vector<std::string>& strings) {
+        if (strings.empty()) {
+            return;
+        }
+        std::size_t length = 1;
+        for (std::size_t n=0; n < strings.size(); ++n) {
+            if (strings[n].length() > length) length = strings[n].length();
+        }
+        std::vector<char> data(strings.size()*length, '\0');
+        for (std::size_t n=0; n < strings.size(); ++n) {
+            std::copy(strings[n].begin(), strings[n].end(), data.begin()+n*length);
+        }
+        hid_t string_type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(string_type, length);
+        hsize_t dims[1] = { strings.size() };
+        H5LTmake_dataset(group, name, 1, dims, string_type, &data[0]);
+        H5Tclose(string_type);
+    }
+
+    std::string fName;
+    hid_t file_id;
+};
+
+struct Options {
+    Options() : channel(0), reference(-1), average(false), storage(stfio::float64),
+                max_bytes(0), n_threads(0), verbose(false) {}
+    std::size_t channel;
+    int reference;
+    bool average;
+    stfio::storagetype storage;
+    std::size_t max_bytes;
+    int n_threads;
+    bool verbose;
+};
+
+// The sections of a channel, or their average, which is stored in avgChannel:
+static const Channel& sectionsToMeasure(const Recording& rec, std::size_t n_c, bool average,
+                                        Channel& avgChannel)
+{
+    const Channel& channel = rec.at(n_c);
+    if (!average) {
+        return channel;
+    }
+    std::size_t average_size = channel.at(0).size();
+    std::vector<std::size_t> sections(channel.size());
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        sections[n_s] = n_s;
+        if (channel[n_s].size() < average_size) {
+            average_size = channel[n_s].size();
+        }
+    }
+    Section avg(average_size, "Average"), sig(average_size);
+    rec.MakeAverage(avg, sig, n_c, sections, false, std::vector<int>(sections.size(), 0));
+    avgChannel = Channel(avg);
+    return avgChannel;
+}
+
+static stfnum::Table measureRecording(const Recording& rec, const std::string& fName,
+                                      const stfnum::BatchSettings& settings, const Options& opts)
+{
+    if (rec.size() == 0 || rec.at(opts.channel).size() == 0) {
+        throw std::out_of_range("No data in channel");
+    }
+
+    Channel average, refAverage;
+    const Channel& channel = sectionsToMeasure(rec, opts.channel, opts.average, average);
+    const Channel* refChannel = NULL;
+    if (opts.reference >= 0) {
+        refChannel = &sectionsToMeasure(rec, opts.reference, opts.average, refAverage);
+    }
+    std::vector<std::size_t> sections(channel.size());
+    for (std::size_t n_s=0; n_s < sections.size(); ++n_s) {
+        sections[n_s] = n_s;
+    }
+
+    std::vector<stfnum::BatchResult> results;
+    stfnum::Table table = stfnum::measureBatch(channel, sections, rec.GetXScale(), settings,
+                                               refChannel, &results, opts.n_threads);
+    for (std::size_t n_s=0; n_s < results.size(); ++n_s) {
+        if (table.GetRowLabel(n_s).empty()) {
+            std::ostringstream label;
+            label << "Section #" << n_s+1;
+            table.SetRowLabel(n_s, label.str());
+        }
+        if (!results[n_s].error.empty()) {
+            std::cerr << "stfbatch: " << fName << ", " << table.GetRowLabel(n_s)
+                      << ": " << results[n_s].error << std::endl;
+        }
+    }
+    return table;
+}
+
+// Measures each recording as soon as stfio::importFiles() has read it
+// and writes the results. Calls are made from one thread at a time.
+class BatchReceiver : public stfio::ImportReceiver {
+public:
+    BatchReceiver(const std::vector<std::string>& files_, const stfnum::BatchSettings& settings_,
+                  const Options& opts_, ResultWriter& writer_)
+        : files(files_), settings(settings_), opts(opts_), writer(writer_), n_done(0), n_failed(0) {}
+
+    bool Receive(std::size_t index, Recording& data, const std::string& importError) {
+        std::string error(importError);
+        if (error.empty()) {
+            try {
+                writer.Write(index, files[index], measureRecording(data, files[index], settings, opts));
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+        ++n_done;
+        if (!error.empty()) {
+            ++n_failed;
+            std::cerr << "stfbatch: " << files[index] << ": " << error << std::endl;
+        }
+        if (opts.verbose) {
+            std::cerr << "stfbatch: " << n_done << " of " << files.size()
+                      << " files done" << std::endl;
+        }
+        return true;
+    }
+
+    std::size_t Failed() const { return n_failed; }
+
+private:
+    const std::vector<std::string>& files;
+    const stfnum::BatchSettings& settings;
+    const Options& opts;
+    ResultWriter& writer;
+    std::size_t n_done, n_failed;
+};
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    stfnum::BatchSettings settings;
+    std::string outName, columns("base,peakbase,rtlohi,t50");
+    std::vector<std::string> args;
+    int fselect = -1;
+    double crossingThreshold = 0.0;
+    bool countCrossings = false;
+
+    try {
+        for (int n_a=1; n_a < argc; ++n_a) {
+            std::string arg(argv[n_a]);
+            if (arg == "--storage") {
+                arg = "-s";
+            } else if (arg == "--max-memory") {
+                arg = "-M";
+            }
+            if (arg.size() != 2 || arg[0] != '-') {
+                args.push_back(arg);
+                continue;
+            }
+            if (arg == "-a") { opts.average = true; continue; }
+            if (arg == "-v") { opts.verbose = true; continue; }
+            if (arg == "-l") {
+                for (std::size_t n_f=0; n_f < stfnum::GetFuncCount(); ++n_f) {
+                    std::cout << n_f << ": " << stfnum::GetFunc(n_f).name << std::endl;
+                }
+                return EXIT_SUCCESS;
+            }
+            if (arg == "-h") {
+                usage();
+                return EXIT_SUCCESS;
+            }
+            if (n_a+1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            std::string value(argv[++n_a]);
+            if (arg == "-o") outName = value;
+            else if (arg == "-c") opts.channel = atoi(value.c_str());
+            else if (arg == "-r") opts.reference = atoi(value.c_str());
+            else if (arg == "-m") columns = value;
+            else if (arg == "-f") fselect = atoi(value.c_str());
+            else if (arg == "-t") { crossingThreshold = atof(value.c_str()); countCrossings = true; }
+            else if (arg == "-j") opts.n_threads = atoi(value.c_str());
+            else if (arg == "-s") opts.storage = parseStorage(value);
+            else if (arg == "-M") opts.max_bytes = parseBytes(value);
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+#ifndef _OPENMP
+        if (opts.n_threads > 1) {
+            throw std::runtime_error("-j needs a build with OpenMP support");
+        }
+#endif
+        if (args.size() < 2) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        readCursorConf(args[0], settings);
+        settings.columns = parseColumns(columns);
+        if (fselect >= 0) {
+            if (fselect >= (int)stfnum::GetFuncCount()) {
+                throw std::out_of_range("Fit function index out of range");
+            }
+            settings.fitFunc = &stfnum::GetFunc(fselect);
+            settings.columns |= stfnum::colFit;
+        }
+        if (countCrossings) {
+            settings.crossingThreshold = crossingThreshold;
+            settings.columns |= stfnum::colCrossings;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "stfbatch: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream outFile;
+    ResultWriter* writer = NULL;
+    try {
+        if (outName.empty()) {
+            writer = new CSVWriter(std::cout);
+        } else if (toLower(outName.substr(outName.rfind('.')+1)) == "h5") {
+            writer = new HDF5Writer(outName);
+        } else {
+            outFile.open(outName.c_str());
+            if (!outFile) {
+                throw std::runtime_error("Couldn't create " + outName);
+            }
+            writer = new CSVWriter(outFile);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "stfbatch: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<std::string> files(args.begin()+1, args.end());
+#ifdef _OPENMP
+    if (opts.n_threads <= 0) {
+        opts.n_threads = omp_get_num_procs();
+    }
+    // The worker that has read a recording measures its sections on all
+    // threads while the other workers go on reading files:
+    omp_set_nested(1);
+#endif
+    BatchReceiver receiver(files, settings, opts, *writer);
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importFiles(files, stfio::none, receiver, stfio::txtImportSettings(), progDlg,
+                       opts.n_threads, opts.max_bytes, opts.storage);
+
+    delete writer;
+    return (receiver.Failed() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -159,6 +159,10 @@ bool wxStfApp::OnInit(void)
     // Config:
     config.reset(new wxFileConfig(wxT("Stimfit")));
 
+    // FFTW planning mode and wisdom from previous sessions:
+    stfnum::fftwSetMeasure(wxGetProfileInt(wxT("Settings"), wxT("FFTWMeasure"), 0) != 0);
+    stfnum::fftwImportWisdom(std::string(GetFFTWWisdomFile().mb_str()));
+
     //// Create a document manager
     wxDocManager* docManager = new wxDocManager;
     //// Create a template relating drawing documents to their views
@@ -357,6 +361,8 @@ int wxStfApp::OnExit()
     GetDocManager()->FileHistorySave(*config);
 #endif // wxUSE_CONFIG
 
+    stfnum::fftwExportWisdom(std::string(GetFFTWWisdomFile().mb_str()));
+
     delete GetDocManager();
 
 #ifdef WITH_PYTHON
@@ -366,6 +372,11 @@ int wxStfApp::OnExit()
     return wxApp::OnExit();
 }
 
+wxString wxStfApp::GetFFTWWisdomFile() const {
+    // stored next to the configuration file:
+    return wxFileConfig::GetLocalFileName(wxT("Stimfit.fftw-wisdom"));
+}
+
 // "Fake" registry
 void wxStfApp::wxWriteProfileInt(const wxString& main, const wxString& sub, int value) const {
     // create a wxConfig-compatible path:
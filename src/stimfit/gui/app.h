@@ -399,6 +399,11 @@ public:
     wxString wxGetProfileString(
             const wxString& main, const wxString& sub, const wxString& default_ ) const;
 
+    //! Retrieves the path of the file that stores FFTW wisdom between sessions.
+    /*! \return The path to the wisdom file in the configuration directory.
+     */
+    wxString GetFFTWWisdomFile() const;
+
     //! Creates a new child window showing a new document.
     /*! \param NewData The new data to be shown in the new window.
      *  \param Sender The document that was at the origin of this new window.
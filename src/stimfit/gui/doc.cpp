@@ -44,7 +44,9 @@
 #include "./../../libstfnum/fit.h"
 #include "./../../libstfnum/funclib.h"
 #include "./../../libstfnum/measure.h"
+#include "./../../libstfnum/batch.h"
 #include "./../../libstfio/stfio.h"
+#include "./../../libstfio/hdf5/hdf5lib.h"
 #ifdef WITH_PYTHON
 #include "./../../pystfio/pystfio.h"
 #endif
@@ -720,11 +722,27 @@ bool wxStfDoc::OnCloseDocument() {
     //Note that the base class version will delete all the document's data
 }
 
+// Sections of large hdf5 files are read from the file for as long as it
+// is open, so that they are copied into memory before it is overwritten:
+static void releaseFile(Recording& rec, const wxString& filename) {
+    if (!stfio::isHDF5FileOpen(stf::wx2std(filename))) {
+        return;
+    }
+    for (std::size_t n_c=0; n_c < rec.size(); ++n_c) {
+        for (std::size_t n_s=0; n_s < rec[n_c].size(); ++n_s) {
+            if (rec[n_c][n_s].IsStored()) {
+                rec[n_c][n_s].get();
+            }
+        }
+    }
+}
+
 bool wxStfDoc::SaveAs() {
     // Override file save dialog to display only writeable
     // file types
     wxString filters;
     filters += wxT("hdf5 file (*.h5)|*.h5|");
+    filters += wxT("hdf5 file, one dataset per channel (*.h5)|*.h5|");
     filters += wxT("CED filing system (*.dat;*.cfs)|*.dat;*.cfs|");
     filters += wxT("Axon text file (*.atf)|*.atf|");
     filters += wxT("Igor binary wave (*.ibw)|*.ibw|");
@@ -738,6 +756,7 @@ bool wxStfDoc::SaveAs() {
             wxFD_SAVE | wxFD_OVERWRITE_PROMPT | wxFD_PREVIEW );
     if(SelectFileDialog.ShowModal()==wxID_OK) {
         wxString filename = SelectFileDialog.GetPath();
+        releaseFile(*this, filename);
         Recording writeRec(ReorderChannels());
         if (writeRec.size() == 0) return false;
         try {
@@ -745,11 +764,15 @@ bool wxStfDoc::SaveAs() {
 			stfio::filetype type;
             switch (SelectFileDialog.GetFilterIndex()) {
             case 0: type=stfio::hdf5; break;
-            case 1: type=stfio::cfs; break;
-            case 2: type=stfio::atf; break;
-            case 3: type=stfio::igor; break;
-            case 4: type=stfio::tdms; break;
-            case 5: type=stfio::ascii; break;
+            case 1:
+                // faster for many sections, but can't be read by older versions:
+                return stfio::exportHDF5File(stf::wx2std(filename), writeRec, progDlg,
+                                             stfio::hdf5_channels);
+            case 2: type=stfio::cfs; break;
+            case 3: type=stfio::atf; break;
+            case 4: type=stfio::igor; break;
+            case 5: type=stfio::tdms; break;
+            case 6: type=stfio::ascii; break;
 #if (defined(WITH_BIOSIG) || defined(WITH_BIOSIG2))
             default: type=stfio::biosig;
 #else
@@ -805,6 +828,7 @@ Recording wxStfDoc::ReorderChannels() {
 
 #ifndef TEST_MINIMAL
 bool wxStfDoc::DoSaveDocument(const wxString& filename) {
+    releaseFile(*this, filename);
     Recording writeRec(ReorderChannels());
     if (writeRec.size() == 0) return false;
     try {
@@ -972,6 +996,7 @@ void wxStfDoc::Select() {
         return;
     }
 
+    UpdateAverage();
     Focus();
 }
 
@@ -985,6 +1010,7 @@ void wxStfDoc::Remove() {
         wxGetApp().ErrorMsg(wxT("Trace is not selected"));
     }
 
+    UpdateAverage();
     Focus();
 
 }
@@ -1166,6 +1192,8 @@ void wxStfDoc::CreateAverage(
         n_c++;
     }
     Average.CopyAttributes(*this);
+    // The running average can't follow the alignment of new traces:
+    SetTrackAverage(!align);
 
     wxString title;
     title << GetFilename() << wxT(", average of ") << (int)GetSelectedSections().size() << wxT(" traces");
@@ -1208,7 +1236,7 @@ void wxStfDoc::FitDecay(wxCommandEvent& WXUNUSED(event)) {
         std::size_t fitSize = GetFitEnd() - GetFitBeg();
         Vector_double x( fitSize );
         //fill array:
-        std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+fitSize], &x[0]);
+        cursec().Read(GetFitBeg(), fitSize, &x[0]);
         if (params.size() != n_params) {
             throw std::runtime_error("Wrong size of params in wxStfDoc::lmFit()");
         }
@@ -1266,7 +1294,7 @@ void wxStfDoc::LFit(wxCommandEvent& WXUNUSED(event)) {
 
     //fill array:
     Vector_double x(n_points);
-    std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+n_points], &x[0]);
+    cursec().Read(GetFitBeg(), n_points, &x[0]);
     Vector_double t(x.size());
     for (std::size_t n_t=0;n_t<x.size();++n_t) t[n_t]=n_t*GetXScale();
 
@@ -1377,15 +1405,21 @@ bool wxStfDoc::SubtractBase( ) {
         wxGetApp().ErrorMsg(wxT("Select traces first"));
         return false;
     }
-    Channel TempChannel(GetSelectedSections().size(), get()[GetCurChIndex()][GetSelectedSections()[0]].size());
+    Channel TempChannel(GetSelectedSections().size());
     std::size_t n = 0;
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        Section TempSection(stfio::vec_scal_minus(get()[GetCurChIndex()][*cit].get(), GetSelectBase()[n]));
+        const Section& source = get()[GetCurChIndex()][*cit];
+        Section TempSection(source.size());
+        if (TempSection.size() > 0) {
+            Vector_double& data = TempSection.get_w();
+            source.Read(0, data.size(), &data[0]);
+            stfio::vec_affine(data, 1.0, -GetSelectBase()[n]);
+        }
         TempSection.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
         TempSection.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
                                            ", baseline subtracted");
         try {
-            TempChannel.InsertSection(TempSection,n);
+            TempChannel.AdoptSection(TempSection,n);
         }
         catch (const std::out_of_range& e) {
             wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
@@ -1408,6 +1442,50 @@ bool wxStfDoc::SubtractBase( ) {
 }
 
 
+// Maps the latency cursor settings of a document to stfnum::measureBatch():
+static stfnum::event_point latencyPoint(stf::latency_mode mode) {
+    switch (mode) {
+     case stf::peakMode:
+         return stfnum::peakPoint;
+     case stf::riseMode:
+         return stfnum::risePoint;
+     case stf::halfMode:
+         return stfnum::halfPoint;
+     case stf::footMode:
+         return stfnum::footPoint;
+     default:
+         return stfnum::manualPoint;
+    }
+}
+
+#ifdef WITH_PSLOPE
+static stfnum::event_point pslopePoint(stf::pslope_mode_beg mode) {
+    switch (mode) {
+     case stf::psBeg_footMode:
+         return stfnum::footPoint;
+     case stf::psBeg_thrMode:
+         return stfnum::thresholdPoint;
+     case stf::psBeg_t50Mode:
+         return stfnum::halfPoint;
+     default:
+         return stfnum::manualPoint;
+    }
+}
+
+static stfnum::event_point pslopePoint(stf::pslope_mode_end mode) {
+    switch (mode) {
+     case stf::psEnd_t50Mode:
+         return stfnum::halfPoint;
+     case stf::psEnd_peakMode:
+         return stfnum::peakPoint;
+     case stf::psEnd_DeltaTMode:
+         return stfnum::deltaPoint;
+     default:
+         return stfnum::manualPoint;
+    }
+}
+#endif
+
 void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
     //	event.Skip();
     if (GetSelectedSections().empty())
@@ -1416,99 +1494,71 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
         return;
     }
 
-    std::size_t section_old=GetCurSecIndex(); //
     wxStfBatchDlg SaveYtDialog(GetDocumentWindow());
     if (SaveYtDialog.ShowModal()!=wxID_OK) return;
-    std::vector<std::string> colTitles;
-    //Write the header of the SaveYt file in a string
-    if (SaveYtDialog.PrintBase()) {
-        colTitles.push_back("Base");
-    }
-    if (SaveYtDialog.PrintBaseSD()) {
-        colTitles.push_back("Base SD");
-    }
-    if (SaveYtDialog.PrintThreshold()) {
-        colTitles.push_back("Slope threshold");
-    }
-    if (SaveYtDialog.PrintSlopeThresholdTime()) {
-        colTitles.push_back("Slope threshold time");
-    }
-    if (SaveYtDialog.PrintPeakZero()) {
-        colTitles.push_back("Peak (from 0)");
-    }
-    if (SaveYtDialog.PrintPeakBase()) {
-        colTitles.push_back("Peak (from baseline)");
-    }
-    if (SaveYtDialog.PrintPeakThreshold()) {
-        colTitles.push_back("Peak (from threshold)");
-    }
-    if (SaveYtDialog.PrintPeakTime()) {
-        colTitles.push_back("Peak time");
-    }
-    if (SaveYtDialog.PrintRTLoHi()) {
-        colTitles.push_back("RT Lo-Hi%");
-    }
-    if (SaveYtDialog.PrintInnerRTLoHi()) {
-        colTitles.push_back("inner Rise Time Lo-Hi%");
-    }
-    if (SaveYtDialog.PrintOuterRTLoHi()) {
-        colTitles.push_back("Outer Rise Time Lo-Hi%");
-    }
-    if (SaveYtDialog.PrintT50()) {
-        colTitles.push_back("duration Amp/2");
-    }
-    if (SaveYtDialog.PrintT50SE()) {
-        colTitles.push_back("start Amp/2");
-        colTitles.push_back("end Amp/2");
-    }
-    if (SaveYtDialog.PrintSlopes()) {
-        colTitles.push_back("Max. slope rise");
-        colTitles.push_back("Max. slope decay");
-    }
-    if (SaveYtDialog.PrintSlopeTimes()) {
-        colTitles.push_back("Time of max. rise");
-        colTitles.push_back("Time of max. decay");
-    }
-    if (SaveYtDialog.PrintLatencies()) {
-        colTitles.push_back("Latency");
-    }
+
+    stfnum::BatchSettings settings;
+    settings.columns = 0;
+    if (SaveYtDialog.PrintBase())
+        settings.columns |= stfnum::colBase;
+    if (SaveYtDialog.PrintBaseSD())
+        settings.columns |= stfnum::colBaseSD;
+    if (SaveYtDialog.PrintThreshold())
+        settings.columns |= stfnum::colThreshold;
+    if (SaveYtDialog.PrintSlopeThresholdTime())
+        settings.columns |= stfnum::colThresholdTime;
+    if (SaveYtDialog.PrintPeakZero())
+        settings.columns |= stfnum::colPeakZero;
+    if (SaveYtDialog.PrintPeakBase())
+        settings.columns |= stfnum::colPeakBase;
+    if (SaveYtDialog.PrintPeakThreshold())
+        settings.columns |= stfnum::colPeakThreshold;
+    if (SaveYtDialog.PrintPeakTime())
+        settings.columns |= stfnum::colPeakTime;
+    if (SaveYtDialog.PrintRTLoHi())
+        settings.columns |= stfnum::colRTLoHi;
+    if (SaveYtDialog.PrintInnerRTLoHi())
+        settings.columns |= stfnum::colInnerRTLoHi;
+    if (SaveYtDialog.PrintOuterRTLoHi())
+        settings.columns |= stfnum::colOuterRTLoHi;
+    if (SaveYtDialog.PrintT50())
+        settings.columns |= stfnum::colT50;
+    if (SaveYtDialog.PrintT50SE())
+        settings.columns |= stfnum::colT50SE;
+    if (SaveYtDialog.PrintSlopes())
+        settings.columns |= stfnum::colSlopes;
+    if (SaveYtDialog.PrintSlopeTimes())
+        settings.columns |= stfnum::colSlopeTimes;
+    if (SaveYtDialog.PrintLatencies())
+        settings.columns |= stfnum::colLatency;
+#ifdef WITH_PSLOPE
+    if (SaveYtDialog.PrintPSlopes())
+        settings.columns |= stfnum::colPSlope;
+#endif
 
     int fselect=-2;
-    std::size_t n_params=0;
     wxStfFitSelDlg FitSelDialog(GetDocumentWindow(), this);
     if (SaveYtDialog.PrintFitResults()) {
         while (fselect<0) {
             FitSelDialog.SetNoInput(true);
             if (FitSelDialog.ShowModal()!=wxID_OK) {
-                SetSection(section_old);
                 return;
             }
             fselect=FitSelDialog.GetFSelect();
         }
         try {
-            n_params=(int)wxGetApp().GetFuncLib().at(fselect).pInfo.size();
+            settings.fitFunc = &wxGetApp().GetFuncLib().at(fselect);
         }
         catch (const std::out_of_range& e) {
             wxString msg(wxT("Error while retrieving function from library:\n"));
             msg += stf::std2wx(e.what());
             wxGetApp().ExceptMsg(msg);
-            SetSection(section_old);
             return;
         }
-        for (std::size_t n_pf=0;n_pf<n_params;++n_pf) {
-            colTitles.push_back( wxGetApp().GetFuncLib()[fselect].pInfo[n_pf].desc);
-        }
-        colTitles.push_back("Fit warning code");
-    }
-#ifdef WITH_PSLOPE
-    if (SaveYtDialog.PrintPSlopes()) {
-        colTitles.push_back("pSlope");
+        settings.fitOpts = FitSelDialog.GetOpts();
+        settings.useScaling = FitSelDialog.UseScaling();
+        settings.columns |= stfnum::colFit;
     }
-#endif
-    if (SaveYtDialog.PrintThr()) {
-        colTitles.push_back("# of thr. crossings");
-    }
-    double threshold=0.0;
     if (SaveYtDialog.PrintThr()) {
         // Get threshold from user:
         std::ostringstream thrS;
@@ -1519,170 +1569,73 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
         if (myDlg.ShowModal()!=wxID_OK) {
             return;
         }
-        threshold=myDlg.readInput()[0];
-    }
-    wxProgressDialog progDlg( wxT("Batch analysis in progress"), wxT("Starting batch analysis"),
-            100, GetDocumentWindow(), wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL );
+        settings.crossingThreshold=myDlg.readInput()[0];
+        settings.columns |= stfnum::colCrossings;
+    }
+
+    // the cursor settings of this document:
+    settings.baseBeg = baseBeg;
+    settings.baseEnd = baseEnd;
+    settings.baselineMethod = baselineMethod;
+    settings.peakBeg = peakBeg;
+    settings.peakEnd = peakEnd;
+    settings.peakAtEnd = peakAtEnd;
+    settings.pM = pM;
+    settings.direction = direction;
+    settings.RTFactor = RTFactor;
+    settings.fromBase = fromBase;
+    settings.slopeForThreshold = slopeForThreshold;
+    settings.latencyStartMode = latencyPoint(latencyStartMode);
+    settings.latencyEndMode = latencyPoint(latencyEndMode);
+    settings.latencyBeg = GetLatencyBeg();
+    settings.latencyEnd = GetLatencyEnd();
+#ifdef WITH_PSLOPE
+    settings.pslopeBegMode = pslopePoint(pslopeBegMode);
+    settings.pslopeEndMode = pslopePoint(pslopeEndMode);
+    settings.pslopeBeg = PSlopeBeg;
+    settings.pslopeEnd = PSlopeEnd;
+    settings.deltaT = DeltaT;
+#endif
+    settings.fitBeg = fitBeg;
+    settings.fitEnd = fitEnd;
+    settings.startFitAtPeak = startFitAtPeak;
+
+    // the latency starts at the event in the second channel:
+    const Channel* reference = (size()>1) ? &get()[GetSecChIndex()] : NULL;
 
-    stfnum::Table table(GetSelectedSections().size(),colTitles.size());
-    for (std::size_t nCol=0;nCol<colTitles.size();++nCol) {
+    stfnum::Table table(0,0);
+    std::vector<stfnum::BatchResult> results;
+    {
+        wxBusyCursor wc;
         try {
-            table.SetColLabel(nCol,colTitles[nCol]);
+            table = stfnum::measureBatch( get()[GetCurChIndex()], GetSelectedSections(),
+                                          GetXScale(), settings, reference, &results );
         }
-        catch (const std::out_of_range& e) {
+        catch (const std::exception& e) {
             wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            SetSection(section_old);
             return;
         }
     }
-    std::size_t n_s = 0;
-    for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        wxString progStr;
-        progStr << wxT("Processing trace # ") << (int)n_s+1 << wxT(" of ") << (int)GetSelectedSections().size();
-        progDlg.Update( (int)((double)n_s/ (double)GetSelectedSections().size()*100.0), progStr );
-        SetSection(*cit);
-        if (peakAtEnd)
-            SetPeakEnd((int)get()[GetCurChIndex()][*cit].size()-1);
-
-        //Calculate all variables for the current settings
-        try {
-            Measure();
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            SetSection(section_old);
-            return;
-        }
-
-        // Set fit start cursor to new peak if necessary:
-        //if (wxGetApp().GetCursorsDialog() != NULL && wxGetApp().GetCursorsDialog()->GetStartFitAtPeak())
-        if ( startFitAtPeak )
-            SetFitBeg(GetMaxT());
-
-        Vector_double params;
-        int fitWarning = 0;
-        if (SaveYtDialog.PrintFitResults()) {
-            try {
-                n_params=(int)wxGetApp().GetFuncLib().at(fselect).pInfo.size();
-            }
-            catch (const std::out_of_range& e) {
-                wxString msg(wxT("Could not retrieve function from library:\n"));
-                msg+=wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(msg);
-                return;
-            }
-            // in this case, initialize parameters from init function,
-            // not from user input:
-            Vector_double x(GetFitEnd()-GetFitBeg());
-            //fill array:
-            std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitEnd()], &x[0]);
-            params.resize(n_params);
-            wxGetApp().GetFuncLib().at(fselect).init( x, GetBase(), GetPeak(), GetRTLoHi(),
-                    GetHalfDuration(), GetXScale(), params );
-
-            std::string fitInfo;
-            try {
-                double chisqr = stfnum::lmFit( x, GetXScale(), wxGetApp().GetFuncLib()[fselect],
-                                            FitSelDialog.GetOpts(), FitSelDialog.UseScaling(),
-                                            params, fitInfo, fitWarning );
-                SetIsFitted( GetCurChIndex(), GetCurSecIndex(), params, wxGetApp().GetFuncLibPtr(fselect),
-                             chisqr, GetFitBeg(), GetFitEnd() );
-            }
 
-            catch (const std::out_of_range& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
-            catch (const std::runtime_error& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
-            catch (const std::exception& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
+    std::string errors;
+    for (std::size_t n_s = 0; n_s < results.size(); ++n_s) {
+        const stfnum::BatchResult& result = results[n_s];
+        if (!result.error.empty()) {
+            if (errors.empty()) {
+                errors = result.error;
             }
+            continue;
         }
-
-        // count number of threshold crossings if needed:
-        std::size_t n_crossings=0;
-        if (SaveYtDialog.PrintThr()) {
-            n_crossings= stfnum::peakIndices( cursec().get(), threshold, 0 ).size();
+        if (settings.fitFunc != NULL) {
+            SetIsFitted( GetCurChIndex(), GetSelectedSections()[n_s], result.params,
+                         wxGetApp().GetFuncLibPtr(fselect), result.chisqr,
+                         result.fitBeg, result.fitEnd );
         }
-        std::size_t nCol=0;
-        //Write the variables of the current channel in a string
-        try {
-            table.SetRowLabel(n_s, cursec().GetSectionDescription());
-
-            if (SaveYtDialog.PrintBase())
-                table.at(n_s,nCol++)=GetBase();
-            if (SaveYtDialog.PrintBaseSD())
-                table.at(n_s,nCol++)=GetBaseSD();
-            if (SaveYtDialog.PrintThreshold())
-                table.at(n_s,nCol++)=GetThreshold();
-            if (SaveYtDialog.PrintSlopeThresholdTime())
-                table.at(n_s,nCol++)=GetThrT()*GetXScale();
-            if (SaveYtDialog.PrintPeakZero())
-                table.at(n_s,nCol++)=GetPeak();
-            if (SaveYtDialog.PrintPeakBase())
-                table.at(n_s,nCol++)=GetPeak()-GetBase();
-            if (SaveYtDialog.PrintPeakThreshold())
-                table.at(n_s,nCol++)=GetPeak()-GetThreshold();
-            if (SaveYtDialog.PrintPeakTime())
-                table.at(n_s,nCol++)=GetPeakTime()*GetXScale();
-            if (SaveYtDialog.PrintRTLoHi())
-                table.at(n_s,nCol++)=GetRTLoHi();
-            if (SaveYtDialog.PrintInnerRTLoHi())
-                table.at(n_s,nCol++)=GetInnerRiseTime();
-            if (SaveYtDialog.PrintOuterRTLoHi())
-                table.at(n_s,nCol++)=GetOuterRiseTime();
-            if (SaveYtDialog.PrintT50())
-                table.at(n_s,nCol++)=GetHalfDuration();
-            if (SaveYtDialog.PrintT50SE()) {
-                table.at(n_s,nCol++)=GetT50LeftReal()*GetXScale();
-                table.at(n_s,nCol++)=GetT50RightReal()*GetXScale();
-            }
-            if (SaveYtDialog.PrintSlopes()) {
-                table.at(n_s,nCol++)=GetMaxRise();
-                table.at(n_s,nCol++)=GetMaxDecay();
-            }
-            if (SaveYtDialog.PrintSlopeTimes()) {
-                table.at(n_s,nCol++)=GetMaxRiseT()*GetXScale();
-                table.at(n_s,nCol++)=GetMaxDecayT()*GetXScale();
-            }
-            if (SaveYtDialog.PrintLatencies()) {
-                table.at(n_s,nCol++)=GetLatency()*GetXScale();
-            }
-            if (SaveYtDialog.PrintFitResults()) {
-                for (std::size_t n_pf=0;n_pf<n_params;++n_pf) {
-                    table.at(n_s,nCol++)=params[n_pf];
-                }
-                if (fitWarning != 0) {
-                    table.at(n_s,nCol++) = (double)fitWarning;
-                } else {
-                    table.SetEmpty(n_s,nCol++);
-                }
-            }
-#ifdef WITH_PSLOPE
-            if (SaveYtDialog.PrintPSlopes()) {
-                table.at(n_s,nCol++)=GetPSlope();
-            }
-#endif
-            if (SaveYtDialog.PrintThr()) {
-                table.at(n_s,nCol++)=n_crossings;
-            }
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            SetSection(section_old);
-            return;
-        }
-        n_s++;
     }
-    progDlg.Update(100,wxT("Finished"));
-    SetSection(section_old);
+    if (!errors.empty()) {
+        wxGetApp().ExceptMsg(wxString( errors.c_str(), wxConvLocal ));
+    }
+
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->ShowTable(table,wxT("Batch analysis results"));
 }
@@ -1835,6 +1788,7 @@ void wxStfDoc::Selectsome(wxCommandEvent &WXUNUSED(event)) {
     }
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->SetSelected(GetSelectedSections().size());
+    UpdateAverage();
     Focus();
 }
 
@@ -1857,6 +1811,7 @@ void wxStfDoc::SelectTracesOfType(wxCommandEvent &WXUNUSED(event)) {
     }
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->SetSelected(GetSelectedSections().size());
+    UpdateAverage();
     Focus();
 }
 
@@ -1879,6 +1834,7 @@ void wxStfDoc::UnselectTracesOfType(wxCommandEvent &WXUNUSED(event)) {
     }
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->SetSelected(GetSelectedSections().size());
+    UpdateAverage();
     Focus();
 }
 
@@ -1906,26 +1862,28 @@ void wxStfDoc::Unselectsome(wxCommandEvent &WXUNUSED(event)) {
     }
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->SetSelected(GetSelectedSections().size());
+    UpdateAverage();
     Focus();
 }
 
-void wxStfDoc::Selectall(wxCommandEvent& event) {
+void wxStfDoc::Selectall(wxCommandEvent& WXUNUSED(event)) {
     //Make sure all traces are unselected prior to selecting them all:
     if ( !GetSelectedSections().empty() )
-        Deleteselected(event);
+        UnselectAll();
     for (int n_s=0; n_s<(int)get()[GetCurChIndex()].size(); ++n_s) {
         SelectTrace(n_s, baseBeg, baseEnd);
     }
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->SetSelected(GetSelectedSections().size());
+    UpdateAverage();
     Focus();
 }
 
 void wxStfDoc::Deleteselected(wxCommandEvent &WXUNUSED(event)) {
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     if( !GetSelectedSections().empty() ) {
-        GetSelectedSectionsW().clear();
-        GetSelectBaseW().clear();
+        UnselectAll();
+        UpdateAverage();
         //Update selected traces string in the trace navigator
         pFrame->SetSelected(GetSelectedSections().size());
     } else {
@@ -1941,6 +1899,32 @@ void wxStfDoc::Deleteselected(wxCommandEvent &WXUNUSED(event)) {
     Focus();
 }
 
+void wxStfDoc::UpdateAverage() {
+    if (!GetTrackAverage() || !GetIsAverage()) {
+        return;
+    }
+    if (GetSelectedSections().empty()) {
+        // nothing left to average:
+        Average.resize(0);
+        SetTrackAverage(false);
+    } else {
+        try {
+            for (std::size_t n_c = 0; n_c < Average.size(); ++n_c) {
+                Average[n_c][0].get_w() = GetSelectAverage(n_c).GetMean();
+            }
+        }
+        catch (const std::out_of_range& e) {
+            Average.resize(0);
+            SetTrackAverage(false);
+            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        }
+    }
+    wxStfView* pView=(wxStfView*)GetFirstView();
+    if (pView != NULL && pView->GetGraph() != NULL) {
+        pView->GetGraph()->Refresh();
+    }
+}
+
 void wxStfDoc::Focus() {
 
     UpdateSelectedButton();
@@ -2113,21 +2097,22 @@ void wxStfDoc::P_over_N(wxCommandEvent& WXUNUSED(event)){
     Channel TempChannel(new_sections);
 
     //read and PoN
+    const Channel& curch = get()[GetCurChIndex()];
     for (int n_section=0; n_section < new_sections; n_section++) {
         //Section loop
-        Section TempSection(get()[GetCurChIndex()][n_section].size());
-        TempSection.SetXScale(get()[GetCurChIndex()][n_section].GetXScale());
-        for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
+        Section TempSection(curch[n_section].size());
+        TempSection.SetXScale(curch[n_section].GetXScale());
+        for (int n_point=0; n_point < (int)curch[n_section].size(); n_point++)
             TempSection[n_point]=0.0;
 
         //Addition of the PoN-values:
         for (int n_PoN=1; n_PoN < PoN+1; n_PoN++)
-            for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
-                TempSection[n_point] += get()[GetCurChIndex()][n_PoN+(n_section*(PoN+1))][n_point];
+            for (int n_point=0; n_point < (int)curch[n_section].size(); n_point++)
+                TempSection[n_point] += curch[n_PoN+(n_section*(PoN+1))][n_point];
 
         //Subtraction from the original values:
-        for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
-            TempSection[n_point] = get()[GetCurChIndex()][n_section*(PoN+1)][n_point]-
+        for (int n_point=0; n_point < (int)curch[n_section].size(); n_point++)
+            TempSection[n_point] = curch[n_section*(PoN+1)][n_point]-
                     TempSection[n_point]*ponDirection;
         std::ostringstream povernLabel;
         povernLabel << GetTitle() << ", #" << n_section << ", P over N";
@@ -2164,10 +2149,12 @@ void wxStfDoc::Plotextraction(stf::extraction_mode mode) {
         Vector_double templateWave(
                 sectionList.at(nTemplate).sec_attr.storeFitEnd -
                 sectionList.at(nTemplate).sec_attr.storeFitBeg);
-        for ( std::size_t n_p=0; n_p < templateWave.size(); n_p++ ) {
-            templateWave[n_p] = sectionList.at(nTemplate).sec_attr.fitFunc->func(
-                n_p*GetXScale(), sectionList.at(nTemplate).sec_attr.bestFitP);
+        if (templateWave.empty()) {
+            throw std::out_of_range("Template is empty");
         }
+        sectionList.at(nTemplate).sec_attr.fitFunc->EvalFunc(
+                0.0, GetXScale(), templateWave.size(),
+                sectionList.at(nTemplate).sec_attr.bestFitP, &templateWave[0]);
         wxBusyCursor wc;
 #undef min
 #undef max
@@ -2175,9 +2162,8 @@ void wxStfDoc::Plotextraction(stf::extraction_mode mode) {
 
         double fmax = *std::max_element(templateWave.begin(), templateWave.end());
         double fmin = *std::min_element(templateWave.begin(), templateWave.end());
-        templateWave = stfio::vec_scal_minus(templateWave, fmax);
         double minim=fabs(fmin);
-        templateWave = stfio::vec_scal_div(templateWave, minim);
+        stfio::vec_affine(templateWave, 1.0/minim, -fmax/minim);
         std::string section_description, window_title;
         Section TempSection(cursec().get().size());
         switch (mode) {
@@ -2256,19 +2242,20 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
         Vector_double templateWave(
                 sectionList.at(nTemplate).sec_attr.storeFitEnd -
                 sectionList.at(nTemplate).sec_attr.storeFitBeg);
-        for ( std::size_t n_p=0; n_p < templateWave.size(); n_p++ ) {
-            templateWave[n_p] = sectionList.at(nTemplate).sec_attr.fitFunc->func(
-                    n_p*GetXScale(), sectionList.at(nTemplate).sec_attr.bestFitP);
+        if (templateWave.empty()) {
+            throw std::out_of_range("Template is empty");
         }
+        sectionList.at(nTemplate).sec_attr.fitFunc->EvalFunc(
+                0.0, GetXScale(), templateWave.size(),
+                sectionList.at(nTemplate).sec_attr.bestFitP, &templateWave[0]);
         wxBusyCursor wc;
 #undef min
 #undef max
         // subtract offset and normalize:
         double fmax = *std::max_element(templateWave.begin(), templateWave.end());
         double fmin = *std::min_element(templateWave.begin(), templateWave.end());
-        templateWave = stfio::vec_scal_minus(templateWave, fmax);
         double minim=fabs(fmin);
-        templateWave = stfio::vec_scal_div(templateWave, minim);
+        stfio::vec_affine(templateWave, 1.0/minim, -fmax/minim);
         Vector_double detect( cursec().get().size() - templateWave.size() );
         switch (MiniDialog.GetMode()) {
          case stf::criterion: {
@@ -2307,6 +2294,7 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
         // erase old events:
         ClearEvents(GetCurChIndex(), GetCurSecIndex());
 
+        const Section& sec = cursec();
         wxStfView* pView = (wxStfView*)GetFirstView();
         wxStfGraph* pGraph = pView->GetGraph();
 
@@ -2321,9 +2309,9 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
                   ++n_mean )
             {
                 if (n_mean < 0) {
-                    baselineMean += cursec().at(0);
+                    baselineMean += sec.at(0);
                 } else {
-                    baselineMean += cursec().at(n_mean);
+                    baselineMean += sec.at(n_mean);
                 }
             }
             baselineMean /= baseline;
@@ -2386,14 +2374,15 @@ void wxStfDoc::Extract( wxCommandEvent& WXUNUSED(event) ) {
                 // add some baseline at the beginning and end:
                 std::size_t eventSize = it->GetEventSize() + 2*baseline;
                 Section TempSection2( eventSize );
+                const Section& sec = cursec();
                 for ( std::size_t n_new = 0; n_new < eventSize; ++n_new ) {
                     // make sure index is not out of range:
                     int index = it->GetEventStartIndex() + n_new - baseline;
                     if (index < 0)
                         index = 0;
-                    if (index >= (int)cursec().size())
-                        index = cursec().size()-1;
-                    TempSection2[n_new] = cursec()[index];
+                    if (index >= (int)sec.size())
+                        index = sec.size()-1;
+                    TempSection2[n_new] = sec[index];
                 }
                 std::ostringstream eventDesc;
                 eventDesc << "Extracted event #" << (int)n_real;
@@ -2448,6 +2437,7 @@ void wxStfDoc::AddEvent( wxCommandEvent& WXUNUSED(event) ) {
         wxStfView* pView = (wxStfView*)GetFirstView();
         wxStfGraph* pGraph = pView->GetGraph();
         int newStartPos = pGraph->get_eventPos();
+        const Section& sec = cursec();
         stf::Event newEvent(newStartPos, 0, GetCurrentSectionAttributes().eventList.at(0).GetEventSize(),
                             new wxCheckBox(pGraph, -1, wxEmptyString));
         // Find peak in this event:
@@ -2457,9 +2447,9 @@ void wxStfDoc::AddEvent( wxCommandEvent& WXUNUSED(event) ) {
               ++n_mean )
         {
             if (n_mean < 0) {
-                baselineMean += cursec().at(0);
+                baselineMean += sec.at(0);
             } else {
-                baselineMean += cursec().at(n_mean);
+                baselineMean += sec.at(n_mean);
             }
         }
         baselineMean /= baseline;
@@ -2553,13 +2543,9 @@ void wxStfDoc::Threshold(wxCommandEvent& WXUNUSED(event)) {
 void wxStfDoc::Measure( )
 {
     double var=0.0;
-    if (cursec().get().size() == 0) return;
-    try {
-        cursec().at(0);
-    }
-    catch (const std::out_of_range&) {
-        return;
-    }
+    // Read-only access, so that stored sections aren't copied into memory:
+    const Section& sec = cursec();
+    if (sec.size() == 0) return;
 
     long windowLength = 1;
     /*
@@ -2580,9 +2566,9 @@ void wxStfDoc::Measure( )
     //Begin peak and base calculation
     //-------------------------------
     try {
-        base=stfnum::base(baselineMethod,var,cursec().get(),baseBeg,baseEnd);
+        base=stfnum::base(baselineMethod,var,sec,baseBeg,baseEnd);
         baseSD=sqrt(var);
-        peak=stfnum::peak(cursec().get(),base,
+        peak=stfnum::peak(sec,base,
                        peakBeg,peakEnd,pM,direction,maxT);
     }
     catch (const std::out_of_range& e) {
@@ -2592,7 +2578,7 @@ void wxStfDoc::Measure( )
         throw e;
     }
     try {
-        threshold = stfnum::threshold( cursec().get(), peakBeg, peakEnd, slopeForThreshold/GetSR(), thrT, windowLength );
+        threshold = stfnum::threshold( sec, peakBeg, peakEnd, slopeForThreshold/GetSR(), thrT, windowLength );
     } catch (const std::out_of_range& e) {
         threshold = 0;
         throw e;
@@ -2616,7 +2602,7 @@ void wxStfDoc::Measure( )
     try {
         // 2008-04-27: changed limits to start from the beginning of the trace
         // 2013-06-16: changed to accept different rise-time proportions
-        rtLoHi=stfnum::risetime2(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
+        rtLoHi=stfnum::risetime2(sec,reference,ampl, (double)0/*(double)baseEnd*/,
                              maxT, factor/*0.2*/, InnerLoRT, InnerHiRT, OuterLoRT, OuterHiRT);
         InnerLoRT/=GetSR();
         InnerHiRT/=GetSR();
@@ -2631,7 +2617,7 @@ void wxStfDoc::Measure( )
     try {
         // 2008-04-27: changed limits to start from the beginning of the trace
         // 2013-06-16: changed to accept different rise-time proportions 
-        rtLoHi=stfnum::risetime(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
+        rtLoHi=stfnum::risetime(sec,reference,ampl, (double)0/*(double)baseEnd*/,
                              maxT, factor/*0.2*/, tLoIndex, tHiIndex, tLoReal);
     }
     catch (const std::out_of_range& e) {
@@ -2647,8 +2633,8 @@ void wxStfDoc::Measure( )
     //t50LeftReal=0.0;
     // 2008-04-27: changed limits to start from the beginning of the trace
     //             and to stop at the end of the trace
-    halfDuration = stfnum::t_half(cursec().get(), reference, ampl, (double)0 /*(double)baseBeg*/,
-            (double)cursec().size()-1 /*(double)peakEnd*/,maxT, t50LeftIndex, t50RightIndex, t50LeftReal);
+    halfDuration = stfnum::t_half(sec, reference, ampl, (double)0 /*(double)baseBeg*/,
+            (double)sec.size()-1 /*(double)peakEnd*/,maxT, t50LeftIndex, t50RightIndex, t50LeftReal);
 
     t50RightReal=t50LeftReal+halfDuration;
     halfDuration/=GetSR();
@@ -2664,10 +2650,10 @@ void wxStfDoc::Measure( )
     //Begin Ratio of slopes rise/decay calculation
     //--------------------------------------------
     double left_rise = peakBeg;
-    maxRise=stfnum::maxRise(cursec().get(),left_rise,maxT,maxRiseT,maxRiseY,windowLength);
+    maxRise=stfnum::maxRise(sec,left_rise,maxT,maxRiseT,maxRiseY,windowLength);
     double t_half_3=t50RightIndex+2.0*(t50RightIndex-t50LeftIndex);
     double right_decay=peakEnd<=t_half_3 ? peakEnd : t_half_3+1;
-    maxDecay=stfnum::maxDecay(cursec().get(),maxT,right_decay,maxDecayT,maxDecayY,windowLength);
+    maxDecay=stfnum::maxDecay(sec,maxT,right_decay,maxDecayT,maxDecayY,windowLength);
 
     //Slope ratio
     if (maxDecay !=0) slopeRatio=maxRise/maxDecay;
@@ -2688,9 +2674,9 @@ void wxStfDoc::Measure( )
         try {
             // in 2012-11-02: use baseline cursors and not arbitrarily 100 points
             //APBase=stfnum::base(APVar,secsec().get(),0,endResting);
-            APBase=stfnum::base(baselineMethod,APVar,secsec().get(), baseBeg, baseEnd ); // use baseline cursors
+            APBase=stfnum::base(baselineMethod,APVar,secsec(), baseBeg, baseEnd ); // use baseline cursors
             //APPeak=stfnum::peak(secsec().get(),APBase,peakBeg,peakEnd,pM,stfnum::up,APMaxT);
-            APPeak=stfnum::peak( secsec().get(),APBase ,peakBeg ,peakEnd ,pM,direction ,APMaxT );
+            APPeak=stfnum::peak( secsec(),APBase ,peakBeg ,peakEnd ,pM,direction ,APMaxT );
         }
         catch (const std::out_of_range& e) {
             APBase=0.0;
@@ -2706,7 +2692,7 @@ void wxStfDoc::Measure( )
         //if (GetLatencyWindowMode() == stf::defaultMode ) {
         left_APRise= APMaxT-searchRange>2.0 ? APMaxT-searchRange : 2.0;
         try {
-            stfnum::maxRise(secsec().get(),left_APRise,APMaxT,APMaxRiseT,APMaxRiseY,windowLength);
+            stfnum::maxRise(secsec(),left_APRise,APMaxT,APMaxRiseT,APMaxRiseY,windowLength);
         }
         catch (const std::out_of_range&) {
             APMaxRiseT=0.0;
@@ -2722,14 +2708,14 @@ void wxStfDoc::Measure( )
         //----------------------------
         //APt50LeftReal=0.0;
         //std::size_t APt50LeftIndex,APt50RightIndex;
-        stfnum::t_half(secsec().get(), APBase, APPeak-APBase, left_APRise,
-                      (double)secsec().get().size(), APMaxT, APt50LeftIndex,
+        stfnum::t_half(secsec(), APBase, APPeak-APBase, left_APRise,
+                      (double)secsec().size(), APMaxT, APt50LeftIndex,
                       APt50RightIndex, APt50LeftReal);
         //End determination of the region of maximal slope in the second channel
         //----------------------------
 
         // Get onset in 2nd channel
-        APrtLoHi=stfnum::risetime(secsec().get(), APBase, APPeak-APBase, (double)0,
+        APrtLoHi=stfnum::risetime(secsec(), APBase, APPeak-APBase, (double)0,
                                   APMaxT, 0.2, APtLoIndex, APtHiIndex, APtLoReal);
         APtHiReal = APtLoReal + APrtLoHi;
         APt0Real = APtLoReal-(APtHiReal-APtLoReal)/3.0;  // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
@@ -2831,7 +2817,7 @@ void wxStfDoc::Measure( )
     SetPSlopeEnd(PSlopeEndVal);
 
     try {
-        PSlope = (stfnum::pslope(cursec().get(), PSlopeBeg, PSlopeEnd))*GetSR();
+        PSlope = (stfnum::pslope(sec, PSlopeBeg, PSlopeEnd))*GetSR();
     }
     catch (const std::out_of_range& e) {
         PSlope = 0.0;
@@ -2951,7 +2937,8 @@ double wxStfDoc::GetMeasValue() {
     if (measCursor>=curch().size()) {
         correctRangeR(measCursor);
     }
-    return cursec().at(measCursor);
+    const Section& sec = cursec();
+    return sec.at(measCursor);
 }
 
 void wxStfDoc::SetBaseBeg(int value) {
@@ -3275,6 +3262,15 @@ void wxStfDoc::InsertChannel(Channel& c_Channel, std::size_t pos) {
     }
 }
 
+void wxStfDoc::AdoptChannel(Channel& c_Channel, std::size_t pos) {
+    Recording::AdoptChannel(c_Channel, pos);
+    yzoom.resize(size());
+    sec_attr.resize(size());
+    for (std::size_t nchannel = 0; nchannel < size(); ++nchannel) {
+        sec_attr[nchannel].resize(at(nchannel).size());
+    }
+}
+
 void wxStfDoc::SetIsFitted( std::size_t nchannel, std::size_t nsection,
                             const Vector_double& bestFitP_, stfnum::storedFunc* fitFunc_,
                             double chisqr, std::size_t fitBeg, std::size_t fitEnd )
@@ -243,12 +243,20 @@ public:
     void UpdateSelectedButton();
 
     //! Creates an average trace from the selected sections
-    /*! \param calcSD Set to true if the standard deviation should be calculated as well, false otherwise
+    /*! Unless the traces are aligned, the average that is shown on top of
+     *  the traces is updated whenever traces are selected or unselected.
+     *  \param calcSD Set to true if the standard deviation should be calculated as well, false otherwise
      *  \param align Set to true if traces should be aligned to the point of steepest rise of the reference channel,
      *         false otherwise.
      */
     void CreateAverage( bool calcSD, bool align );
 
+    //! Updates the average that is shown on top of the traces
+    /*! Has to be called whenever the selection has been changed, unless
+     *  this was done through one of the selection commands of the document.
+     */
+    void UpdateAverage();
+
 #if 0
     //! Applies a user-defined function to the current data set
     /*! \param id The id of the user-defined function
@@ -1010,6 +1018,14 @@ public:
      */
     virtual void InsertChannel(Channel& c_Channel, std::size_t pos);
 
+    //! Move a Channel to a given position without copying its sections.
+    /*! Will throw std::out_of_range if range check fails.
+     *  \param c_Channel On entry, the Channel to be inserted. On exit, the
+     *         channel that was previously stored at \e pos.
+     *  \param pos The position at which to insert the channel (0-based).
+     */
+    virtual void AdoptChannel(Channel& c_Channel, std::size_t pos);
+
     const stf::SectionAttributes& GetSectionAttributes(std::size_t nchannel, std::size_t nsection) const;
     const stf::SectionAttributes& GetCurrentSectionAttributes() const;
     stf::SectionAttributes& GetCurrentSectionAttributesW();
@@ -273,7 +273,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
             //Draw current trace on display
             //For display use point to point drawing
             DC.SetPen(standardPen2);
-            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(), reference);
+            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()], reference);
         } else {	//Draw second channel for print out
             //For print out use polyline tool
             DC.SetPen(standardPrintPen2);
@@ -287,7 +287,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
                 //Draw current trace on display
                 //For display use point to point drawing
                 DC.SetPen(standardPen3);
-                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()].get(), background, n);
+                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()], background, n);
             }
         }
     }		//End plot of the second channel
@@ -298,7 +298,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
 	//Draw current trace on display
         //For display use point to point drawing
         DC.SetPen(standardPen);
-        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()].get());
+        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()]);
     } else {
         //For print out use polyline tool
         DC.SetPen(standardPrintPen);
@@ -376,7 +376,7 @@ void wxStfGraph::PlotSelected(wxDC& DC) {
             //For display use point to point drawing
             PlotTrace(
                       &DC,
-                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]].get()
+                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]]
                       );
         }
     }  //End draw traces on display
@@ -396,7 +396,7 @@ void wxStfGraph::PlotAverage(wxDC& DC) {
     {	//Draw Average on display
         //For display use point to point drawing
         DC.SetPen(averagePen);
-        PlotTrace(&DC,Doc()->GetAverage()[0][0].get());
+        PlotTrace(&DC,Doc()->GetAverage()[0][0]);
     }	//End draw Average on display
     else
     {	//Draw average for print out
@@ -529,12 +529,14 @@ void wxStfGraph::PlotEvents(wxDC& DC) {
         return;
     }
     DC.SetPen(eventPen);
+    // read-only access doesn't copy stored data points into memory:
+    const Section& sec = Doc()->cursec();
     for (c_event_it it = sec_attr.eventList.begin(); it != sec_attr.eventList.end(); ++it) {
         // Create small arrows indicating the start of an event:
         eventArrow(&DC, (int)it->GetEventStartIndex());
         // Create circles indicating the peak of an event:
         try {
-            DrawCircle( &DC, it->GetEventPeakIndex(), Doc()->cursec().at(it->GetEventPeakIndex()), eventPen, eventPen );
+            DrawCircle( &DC, it->GetEventPeakIndex(), sec.at(it->GetEventPeakIndex()), eventPen, eventPen );
         }
         catch (const std::out_of_range& e) {
             wxGetApp().ExceptMsg( wxString( e.what(), wxConvLocal ) );
@@ -661,8 +663,9 @@ double wxStfGraph::get_plot_y2max() const {
     return SPY2()/YZ2();
 }
 
-void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt, int bgno ) {
+void wxStfGraph::PlotTrace( wxDC* pDC, const Section& sec, plottype pt, int bgno ) {
     // speed up drawing by omitting points that are outside the window:
+    int n_points = (int)sec.size();
 
     // find point before left window border:
     // xFormat=toFormat * zoom.xZoom + zoom.startPosX
@@ -670,22 +673,26 @@ void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt,
     // toFormat=-zoom.startPosX/zoom.xZoom
     std::size_t start=0;
     int x0i=int(-SPX()/XZ());
-    if (x0i>=0 && x0i<(int)trace.size()-1) start=x0i;
+    if (x0i>=0 && x0i<n_points-1) start=x0i;
     // find point after right window border:
     // for xFormat==right:
     // toFormat=(right-zoom.startPosX)/zoom.xZoom
-    std::size_t end=trace.size();
+    std::size_t end=sec.size();
     wxRect WindowRect=GetRect();
     if (isPrinted) WindowRect=wxRect(printRect);
     int right=WindowRect.width;
     int xri = int((right-SPX())/XZ())+1;
-    if (xri>=0 && xri<(int)trace.size()-1) end=xri;
+    if (xri>=0 && xri<n_points-1) end=xri;
 
     // apply filter at half the new sampling frequency:
-    DoPlot(pDC, trace, start, end, 1, pt, bgno);
+    DoPlot(pDC, sec, start, end, 1, pt, bgno);
 }
 
-void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int end, int step, plottype pt, int bgno) {
+void wxStfGraph::DoPlot( wxDC* pDC, const Section& sec, int start, int end, int step, plottype pt, int bgno) {
+    // index the section directly rather than through get() so that
+    // memory-mapped sections aren't copied into memory:
+    if (sec.size()==0 || end <= start) return;
+
 #if (__cplusplus < 201103)
     boost::function<int(double)> yFormatFunc;
 #else
@@ -700,12 +707,10 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
          yFormatFunc = std::bind1st( std::mem_fun(&wxStfGraph::yFormatD2), this);
          break;
      case background:
-         Vector_double::const_iterator max_el = std::max_element(trace.begin(), trace.end());
-         Vector_double::const_iterator min_el = std::min_element(trace.begin(), trace.end());
-         double min = *min_el;
+         double min = 0, max = 0;
+         sec.GetExtrema(0, sec.size(), min, max);
          if (min>1.0e12)  min= 1.0e12;
          if (min<-1.0e12) min=-1.0e12;
-         double max = *max_el;
          if (max>1.0e12)  max= 1.0e12;
          if (max<-1.0e12) max=-1.0e12;
          wxRect WindowRect=GetRect();
@@ -716,23 +721,48 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
          break;
     }
 
-    int x_last = xFormat(start);
-    int y_last = yFormatFunc( trace[start] );
-    int x_next = 0;
-    int y_next = 0;
 #ifdef BENCHMARK //def _STFDEBUG
     struct timespec time0, time1;
     current_utc_time(&time0);
-#else
+#endif
+    std::vector<wxPoint> points;
     wxRect WindowRect(GetRect());
     if (end-start < 2*WindowRect.width+2) {
-#endif    
-    for (int n=start; n<end-1; ++n) {
-        x_next = xFormat(n+1);
-        y_next = yFormatFunc( trace[n+1] );
-        pDC->DrawLine( x_last, y_last, x_next, y_next );
-        x_last = x_next;
-        y_last = y_next;
+        // less than two data points per pixel column: connect all of them
+        points.reserve(end-start);
+        for (int n=start; n<end; ++n) {
+            points.push_back( wxPoint(xFormat(n), yFormatFunc(sec[n])) );
+        }
+    } else {
+        // several data points per pixel column: draw the first point, the
+        // extrema and the last point of each column. The extrema are looked
+        // up in the section's min/max pyramid so that the cost only depends
+        // on the number of pixel columns.
+        int x_first = xFormat(start);
+        int x_last = xFormat(end-1);
+        points.reserve(4*(x_last-x_first+1));
+        int col_begin = start;
+        for (int x = x_first; x <= x_last && col_begin < end; ++x) {
+            // first data point that is drawn right of this column
+            // (undo xFormat = (int)(toFormat * XZ() + SPX())):
+            int col_end = (int)(((double)x+1.0-SPX())/XZ());
+            if (col_end <= col_begin) col_end = col_begin+1;
+            if (col_end > end) col_end = end;
+            while (col_end > col_begin+1 && xFormat(col_end-1) > x) --col_end;
+            while (col_end < end && xFormat(col_end) <= x) ++col_end;
+
+            int x_col = xFormat(col_begin);
+            double y_min = 0, y_max = 0;
+            sec.GetExtrema(col_begin, col_end, y_min, y_max);
+            points.push_back( wxPoint(x_col, yFormatFunc(sec[col_begin])) );
+            points.push_back( wxPoint(x_col, yFormatFunc(y_min)) );
+            points.push_back( wxPoint(x_col, yFormatFunc(y_max)) );
+            points.push_back( wxPoint(x_col, yFormatFunc(sec[col_end-1])) );
+            col_begin = col_end;
+        }
+    }
+    if (points.size() > 1) {
+        pDC->DrawLines((int)points.size(), &points[0]);
     }
 #ifdef BENCHMARK //def _STFDEBUG
     current_utc_time(&time1);
@@ -740,43 +770,8 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
     std::string fn_platform = "plt_bench_" + stf::wx2std(wxGetOsDescription()) + ".txt";
     std::ofstream plt_bench;
     plt_bench.open(fn_platform.c_str(), std::ios::out | std::ios::app);
-    plt_bench << end-start << "\t" << accum << "\t";
-    current_utc_time(&time0);
-    x_last = xFormat(start);
-#else
-    } else {
-#endif
-    double y_max = trace[start];
-    double y_min = trace[start];
-    for (int n=start; n<end-1; ++n) {
-        x_next = xFormat(n+1);
-        // if we are still in the same pixel column, find extrema:
-        if (x_next == x_last) {
-            if (trace[n+1] < y_min) {
-                y_min = trace[n+1];
-            }
-            if (trace[n+1] > y_max) {
-                y_max = trace[n+1];
-            }
-        } else {
-            // plot line between extrema of previous column:
-            pDC->DrawLine( x_last, yFormatFunc(y_min), x_last, yFormatFunc(y_max) );
-
-            // plot line between last point of previous and first point of this column:
-            pDC->DrawLine( x_last, yFormatFunc(trace[n]), x_next, yFormatFunc(trace[n+1]) );
-
-            y_min = trace[n+1];
-            y_max = trace[n+1];
-            x_last = x_next;
-        }
-    }
-#ifdef BENCHMARK //def _STFDEBUG
-    current_utc_time(&time1);
-    accum = tdiff(time1, time0)*1e3;
-    plt_bench << accum << std::endl;
+    plt_bench << end-start << "\t" << accum << std::endl;
     plt_bench.close();
-#else
-    }
 #endif
 }
 
@@ -980,38 +975,25 @@ void wxStfGraph::PlotFit( wxDC* pDC, const stf::SectionPointer& Sec ) {
     int lastPixel = xFormat( Sec.sec_attr.storeFitEnd );
     if ( lastPixel > WindowRect.width + 1 ) lastPixel = WindowRect.width + 1;
 
-    if (!isPrinted) {
-        //Draw Fit on display
-        //For display use point to point drawing
-        double fit_time_1 =
-            ( ((double)firstPixel - (double)SPX()) / XZ() -
-                    (double)Sec.sec_attr.storeFitBeg )* Doc()->GetXScale();
-        for ( int n_px = firstPixel; n_px < lastPixel-1; n_px++ ) {
-            // Calculate pixel back to time (GetStoreFitBeg() is t=0)
-            double fit_time_2 =
-                ( ((double)n_px+1.0 - (double)SPX()) / XZ() -
-                        (double)Sec.sec_attr.storeFitBeg )
-                        * Doc()->GetXScale(); // undo xFormat = (int)(toFormat * XZ() + SPX());
-            pDC->DrawLine( n_px,
-                    yFormat(Sec.sec_attr.fitFunc->func( fit_time_1, Sec.sec_attr.bestFitP)),
-                            n_px + 1, yFormat(Sec.sec_attr.fitFunc->func(fit_time_2, Sec.sec_attr.bestFitP))
-            );
-            fit_time_1 = fit_time_2;
-        }
-    } else {    //Draw Fit for print out
-        // For print out use polyline
-        std::vector<wxPoint> f_print( lastPixel - firstPixel );
-        for ( int n_px = firstPixel; n_px < lastPixel; n_px++ ) {
-            // Calculate pixel back to time (GetStoreFitBeg() is t=0)
-            double fit_time =
-                ( ((double)n_px - (double)SPX()) / XZ() -(double)Sec.sec_attr.storeFitBeg )
-                        * Doc()->GetXScale(); // undo xFormat = (int)(toFormat * XZ() + SPX());
-            f_print[n_px-firstPixel].x = n_px;
-            f_print[n_px-firstPixel].y = yFormat( Sec.sec_attr.fitFunc->func(
-                            fit_time, Sec.sec_attr.bestFitP) );
-        }
-        pDC->DrawLines( f_print.size(), &f_print[0] );
-    }   //End if display or print out
+    int n_points = lastPixel - firstPixel;
+    if ( n_points < 2 ) return;
+
+    // Evaluate the whole fit in one call and draw it as a polyline, both on
+    // display and for print out. Pixels are translated back to time
+    // (GetStoreFitBeg() is t=0) by undoing xFormat = (int)(toFormat * XZ() + SPX()):
+    double fit_time_0 =
+        ( ((double)firstPixel - (double)SPX()) / XZ() -
+                (double)Sec.sec_attr.storeFitBeg ) * Doc()->GetXScale();
+    double fit_dt = Doc()->GetXScale() / XZ();
+    Vector_double fit_y( n_points );
+    Sec.sec_attr.fitFunc->EvalFunc( fit_time_0, fit_dt, n_points, Sec.sec_attr.bestFitP, &fit_y[0] );
+
+    std::vector<wxPoint> f_points( n_points );
+    for ( int n_px = 0; n_px < n_points; n_px++ ) {
+        f_points[n_px].x = firstPixel + n_px;
+        f_points[n_px].y = yFormat( fit_y[n_px] );
+    }
+    pDC->DrawLines( f_points.size(), &f_points[0] );
 }
 
 void wxStfGraph::DrawIntegral(wxDC* pDC) {
@@ -1061,10 +1043,11 @@ void wxStfGraph::DrawIntegral(wxDC* pDC) {
     // add trapezoidal integration part if uneven:
     if (!even) {
     // draw a straight line:
+        const Section& sec = Doc()->cursec();
         quadTrace.push_back(
             wxPoint(
                     xFormat(sec_attr.storeIntEnd),
-                    yFormat(Doc()->cursec()[sec_attr.storeIntEnd])
+                    yFormat(sec[sec_attr.storeIntEnd])
                     ));
     }
     quadTrace.push_back(
@@ -156,6 +156,9 @@ def import_hdf5( filename ):
     """
     h5file = tables.openFile( filename, mode='r' )
 
+    if "layout" in h5file.root._v_attrs:
+        return import_hdf5_channels( h5file )
+
     # read global file description
     root_node = h5file.getNode("/", "description")
     date = root_node.col("date")[0]
@@ -214,6 +217,32 @@ def import_hdf5( filename ):
 
     return Recording( channel_list, comment, date, time )
 
+def import_hdf5_channels( h5file ):
+    """
+    Reads a file that stores each channel in a single 2-D dataset
+    (sections x samples), returns a Recording object.
+    """
+    attrs = h5file.root._v_attrs
+    dt = attrs.dt[0]
+    xunits = attrs.xunits
+
+    channel_list = list()
+    for n_c in range(attrs.channels[0]):
+        channel_node = h5file.getNode("/", "ch%d" % n_c)
+        yunits = channel_node._v_attrs.yunits
+        sizes = channel_node.sizes.read()
+        data = channel_node.data.read()
+        section_list = [ Section(data[n_s, :sizes[n_s]], dt, xunits, yunits)
+                         for n_s in range(len(sizes)) ]
+        channel_list.append( Channel(section_list, channel_node._v_attrs.name) )
+
+    comment = attrs.comment
+    date = attrs.date
+    time = attrs.time
+    h5file.close()
+
+    return Recording( channel_list, comment, date, time )
+
 def open_hdf5( filename ):
     """
     Opens and shows an hdf5 file with stimfit
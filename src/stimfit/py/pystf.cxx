@@ -456,6 +456,7 @@ bool select_trace( int trace ) {
     // add trace number to selected numbers, print number of selected traces
     if (!already) {
         actDoc()->SelectTrace(trace, actDoc()->GetBaseBeg(), actDoc()->GetBaseEnd());
+        actDoc()->UpdateAverage();
         //String output in the trace navigator
         wxStfChildFrame* pFrame = (wxStfChildFrame*)actDoc()->GetDocumentWindow();
         if ( !pFrame ) {
@@ -1669,7 +1670,7 @@ PyObject* leastsq( int fselect, bool refresh ) {
 
     std::vector< double > x( pDoc->GetFitEnd() - pDoc->GetFitBeg() );
     //fill array:
-    std::copy(&pDoc->cursec()[pDoc->GetFitBeg()], &pDoc->cursec()[pDoc->GetFitEnd()], &x[0]);
+    pDoc->cursec().Read(pDoc->GetFitBeg(), x.size(), &x[0]);
     
     std::vector< double > params( n_params );            
 
@@ -1755,7 +1756,9 @@ PyObject* get_fit( int trace, int channel ) {
     Vector_double xy_fit(2*size);
     for (unsigned int x = 0; x < size; ++x) {
         xy_fit[x] = (x+sec_attr.storeFitBeg) * actDoc()->GetXScale();
-        xy_fit[x+size] = sec_attr.fitFunc->func(x*actDoc()->GetXScale(), sec_attr.bestFitP);
+    }
+    if (size > 0) {
+        sec_attr.fitFunc->EvalFunc(0.0, actDoc()->GetXScale(), size, sec_attr.bestFitP, &xy_fit[size]);
     }
     
     npy_intp dims[2] = {2, size};
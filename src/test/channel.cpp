@@ -40,3 +40,41 @@ TEST(Channel_test, data_access)
     EXPECT_THROW( ch3.at( ch3.size() ), std::out_of_range );
     EXPECT_THROW( ch3[ch3.size()-1].at(ch3[ch3.size()-1].size()), std::out_of_range );
 }
+
+TEST(Channel_test, adopt_sections)
+{
+    Vector_double values(1000, 2.5);
+    const double* buffer = &values[0];
+    Section sec;
+    sec.get_w().swap(values);
+    sec.SetSectionDescription("adopted");
+
+    // The data points are moved, not copied:
+    Channel ch(3);
+    ch.AdoptSection(sec, 1);
+    EXPECT_EQ( &ch[1].get()[0], buffer );
+    EXPECT_EQ( ch[1].GetSectionDescription(), "adopted" );
+    EXPECT_EQ( sec.size(), 0 );
+    EXPECT_THROW( ch.AdoptSection(sec, 3), std::out_of_range );
+
+    Vector_double& filled = ch.EmplaceSection(2, 500, "in place").get_w();
+    filled[499] = 1.0;
+    EXPECT_EQ( ch[2].size(), 500 );
+    EXPECT_EQ( ch[2][499], 1.0 );
+    EXPECT_EQ( ch[2].GetSectionDescription(), "in place" );
+    EXPECT_THROW( ch.EmplaceSection(3, 10), std::out_of_range );
+
+#if (__cplusplus >= 201103)
+    Vector_double moved(100, 1.0);
+    const double* moved_buffer = &moved[0];
+    ch.InsertSection(Section(std::move(moved)), 0);
+    EXPECT_EQ( &ch[0].get()[0], moved_buffer );
+#endif
+
+    ch.SetChannelName("Vm");
+    Recording rec(2);
+    rec.AdoptChannel(ch, 1);
+    EXPECT_EQ( rec[1].GetChannelName(), "Vm" );
+    EXPECT_EQ( &rec[1][1].get()[0], buffer );
+    EXPECT_EQ( ch.size(), 0 );
+}
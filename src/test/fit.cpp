@@ -922,3 +922,183 @@ TEST(fitlib_test, id_12_fgaussian){
     //data.clear();
 
 }
+
+//=========================================================================
+// Tests fitting a monoexponential function to several traces at once
+// the batch fit must give the same results as individual fits
+//=========================================================================
+TEST(fitlib_test, batch_monoexponential){
+
+    const int n_traces = 16;
+    std::vector<Vector_double> data(n_traces);
+    std::vector<Vector_double> pars(n_traces, Vector_double(3));
+    for (int n=0; n<n_traces; ++n) {
+        Vector_double mypars(3);
+        mypars[0] = 50.0 + n;        /* amplitude */
+        mypars[1] = 10.0 + 0.5*n;    /* time constant */
+        mypars[2] = -20.0;           /* end  */
+        data[n] = fexp_simple(mypars);
+
+        /* Initial parameters guesses */
+        pars[n][0] = 0.0;
+        pars[n][1] = 5.0;
+        pars[n][2] = -35.0;
+    }
+    std::vector<Vector_double> single_pars(pars);
+
+    std::vector<std::string> info;
+    std::vector<int> warning;
+    Vector_double chisqr = stfnum::lmFitBatch(data, dt, funcLib[0], opts,
+        true, /* use_scaling */
+        pars, info, warning );
+
+    EXPECT_EQ(chisqr.size(), (std::size_t)n_traces);
+    for (int n=0; n<n_traces; ++n) {
+        std::string single_info;
+        int single_warning;
+        double single_chisqr = stfnum::lmFit(data[n], dt, funcLib[0], opts,
+            true, single_pars[n], single_info, single_warning );
+        EXPECT_EQ(warning[n], single_warning);
+        EXPECT_DOUBLE_EQ(chisqr[n], single_chisqr);
+        for (std::size_t n_p=0; n_p<pars[n].size(); ++n_p) {
+            EXPECT_DOUBLE_EQ(pars[n][n_p], single_pars[n][n_p]);
+        }
+        par_test(pars[n][1], 10.0 + 0.5*n, tol);  /* Tau_0  */
+    }
+}
+
+//=========================================================================
+// Tests that a reused workspace gives the same results as a new one,
+// also if the data sets and the fitted parameters differ in size
+//=========================================================================
+TEST(fitlib_test, reuse_workspace){
+
+    stfnum::LMWorkspace workspace(true); /* with covariance */
+    for (int n=0; n<4; ++n) {
+        /* the first fit is the largest one */
+        Vector_double mypars(3);
+        mypars[0] = 50.0 + n;        /* amplitude */
+        mypars[1] = 10.0 + 0.5*n;    /* time constant */
+        mypars[2] = -20.0;           /* end  */
+        Vector_double full = fexp_simple(mypars);
+        Vector_double data(full.begin(), full.end() - n*full.size()/8);
+
+        /* alternate between a free and a fixed offset */
+        std::size_t n_func = n % 2;
+        Vector_double pars(3);
+        pars[0] = 35.0;      /* Amp_0 */
+        pars[1] = 5.0;       /* Tau_0 */
+        pars[2] = mypars[2]; /* Offset */
+        Vector_double new_pars(pars);
+        std::size_t n_fitted = (n_func == 0) ? 3 : 2;
+
+        std::string info, new_info;
+        int warning, new_warning;
+        double chisqr = stfnum::lmFit(data, dt, funcLib[n_func], opts,
+            true, /* use_scaling */
+            pars, info, warning, workspace );
+        double new_chisqr = stfnum::lmFit(data, dt, funcLib[n_func], opts,
+            true, /* use_scaling */
+            new_pars, new_info, new_warning );
+
+        EXPECT_EQ(warning, new_warning);
+        EXPECT_DOUBLE_EQ(chisqr, new_chisqr);
+        for (std::size_t n_p=0; n_p<pars.size(); ++n_p) {
+            EXPECT_DOUBLE_EQ(pars[n_p], new_pars[n_p]);
+        }
+        EXPECT_EQ(workspace.covar.size(), n_fitted*n_fitted);
+        EXPECT_GE(workspace.work.size(), (std::size_t)(4*full.size()));
+    }
+}
+
+//=========================================================================
+// Tests that the whole-array evaluation of a function and its Jacobian
+// gives the same values as the point-by-point evaluation
+//=========================================================================
+TEST(fitlib_test, array_evaluation){
+
+    const std::size_t n = 1000;
+    for (std::size_t n_f=0; n_f<funcLib.size(); ++n_f) {
+        const stfnum::storedFunc& f = funcLib[n_f];
+        std::size_t n_par = f.pInfo.size();
+        Vector_double mypars(n_par);
+        for (std::size_t n_p=0; n_p<n_par; ++n_p) {
+            mypars[n_p] = 1.0 + 0.5*n_p;
+        }
+
+        Vector_double y(n), j(n*n_par);
+        f.EvalFunc(0.0, dt, n, mypars, &y[0]);
+        if (f.hasJac) {
+            f.EvalJac(0.0, dt, n, mypars, &j[0]);
+        }
+        for (std::size_t n_x=0; n_x<n; ++n_x) {
+            double x = n_x*(double)dt;
+            double ref = f.func(x, mypars);
+            EXPECT_NEAR(y[n_x], ref, 1e-12*(1.0+fabs(ref))) << f.name;
+            if (!f.hasJac) continue;
+            Vector_double jac_x = f.jac(x, mypars);
+            for (std::size_t n_p=0; n_p<n_par; ++n_p) {
+                EXPECT_NEAR(j[n_x*n_par+n_p], jac_x[n_p], 1e-12*(1.0+fabs(jac_x[n_p]))) << f.name;
+            }
+        }
+    }
+}
+
+//=========================================================================
+// Tests that the Jacobians computed by automatic differentiation agree
+// with central differences of the function
+//=========================================================================
+TEST(fitlib_test, dual_jacobian){
+
+    const double h = 1e-6;
+    for (std::size_t n_f=0; n_f<funcLib.size(); ++n_f) {
+        const stfnum::storedFunc& f = funcLib[n_f];
+        EXPECT_TRUE(f.hasJac) << f.name;
+        std::size_t n_par = f.pInfo.size();
+        Vector_double mypars(n_par);
+        for (std::size_t n_p=0; n_p<n_par; ++n_p) {
+            mypars[n_p] = 1.0 + 0.5*n_p;
+        }
+        /* points after the delay of the delayed functions */
+        for (double x = 2.5; x < 10.0; x += 1.25) {
+            Vector_double jac_x = f.jac(x, mypars);
+            ASSERT_EQ(jac_x.size(), n_par) << f.name;
+            for (std::size_t n_p=0; n_p<n_par; ++n_p) {
+                Vector_double p_hi(mypars), p_lo(mypars);
+                p_hi[n_p] += h;
+                p_lo[n_p] -= h;
+                double diff = (f.func(x, p_hi) - f.func(x, p_lo)) / (2.0*h);
+                EXPECT_NEAR(jac_x[n_p], diff, 1e-6*(1.0+fabs(diff))) << f.name;
+            }
+        }
+    }
+}
+
+//=========================================================================
+// Tests the shared function library
+//=========================================================================
+TEST(fitlib_test, shared_library){
+
+    ASSERT_GE(stfnum::GetFuncCount(), funcLib.size());
+    for (std::size_t n_f=0; n_f<funcLib.size(); ++n_f) {
+        const stfnum::storedFunc& f = stfnum::GetFunc(n_f);
+        EXPECT_EQ(f.name, funcLib[n_f].name);
+        EXPECT_EQ(&f, &stfnum::GetFunc(n_f)); /* stable address */
+        EXPECT_EQ(stfnum::FindFunc(f.name), &f);
+    }
+    EXPECT_TRUE(stfnum::FindFunc("No such function") == NULL);
+    EXPECT_THROW(stfnum::GetFunc(stfnum::GetFuncCount()), std::out_of_range);
+
+    /* register a compiled model */
+    const stfnum::storedFunc* gauss = stfnum::FindFunc("Gaussian");
+    ASSERT_TRUE(gauss != NULL);
+    stfnum::storedFunc custom(*gauss);
+    custom.name = "Gaussian, registered in test";
+    std::size_t n_funcs = stfnum::GetFuncCount();
+    const stfnum::storedFunc& added = stfnum::RegisterFunc(custom);
+    EXPECT_EQ(stfnum::GetFuncCount(), n_funcs+1);
+    EXPECT_EQ(&stfnum::GetFunc(n_funcs), &added);
+    EXPECT_EQ(stfnum::FindFunc(custom.name), &added);
+    EXPECT_EQ(gauss, stfnum::FindFunc("Gaussian"));
+    EXPECT_THROW(stfnum::RegisterFunc(custom), std::runtime_error);
+}
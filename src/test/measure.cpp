@@ -1,5 +1,7 @@
 #include "../stimfit/stf.h"
 #include "../libstfnum/measure.h"
+#include "../libstfnum/batch.h"
+#include "../libstfnum/funclib.h"
 #include <gtest/gtest.h>
 #include <cmath>
 #include <fstream>
@@ -243,6 +245,104 @@ TEST(measlib_test, peak_basic) {
     EXPECT_EQ(maxT, 16385);
 }
 
+//=========================================================================
+// test baseline and peak of sections held as float32 and int16
+//=========================================================================
+TEST(measlib_test, compact_storage) {
+
+    std::vector<double> data(10000);
+    for (std::size_t n=0; n<data.size(); ++n) {
+        data[n] = 5.0*sin(n*dt) + 0.01*(n % 7);
+    }
+    double var_d, var_s, maxT_d, maxT_s;
+    double base_d = stfnum::base(stfnum::mean_sd, var_d, data, 100, 5000);
+    double median_d = stfnum::base(stfnum::median_iqr, var_d, data, 100, 5000);
+    double peak_d = stfnum::peak(data, base_d, 0, data.size()-1, 3, stfnum::both, maxT_d);
+
+    stfio::storagetype types[] = {stfio::float32, stfio::int16};
+    for (int n_t=0; n_t<2; ++n_t) {
+        Section sec(data);
+        sec.SetStorage(types[n_t]);
+        const Section& csec = sec;
+        EXPECT_EQ(csec.GetStorage(), types[n_t]);
+        /* 16 bit quantization of a +-5 range */
+        double tol = 1.0e-4;
+        EXPECT_NEAR(stfnum::base(stfnum::mean_sd, var_s, csec, 100, 5000), base_d, tol);
+        EXPECT_NEAR(stfnum::base(stfnum::median_iqr, var_s, csec, 100, 5000), median_d, tol);
+        EXPECT_NEAR(stfnum::peak(csec, base_d, 0, data.size()-1, 3, stfnum::both, maxT_s), peak_d, tol);
+        EXPECT_EQ(maxT_s, maxT_d);
+        EXPECT_TRUE(csec.IsStored());
+    }
+}
+
+TEST(measlib_test, compact_storage_kinetics) {
+
+    /* a sine wave between 0 and PI */
+    std::vector<double> data = sinwave( long(PI/dt) );
+    std::size_t n_peak = long((PI/2)/dt);
+    std::size_t lo_d, hi_d, lo_s, hi_s;
+    double tLo_d, tLo_s, thrT_d, thrT_s, riseT_d, riseT_s, riseY;
+    double rt_d = stfnum::risetime(data, 0.0, 1.0, 1, n_peak-1, 0.2, lo_d, hi_d, tLo_d);
+    double half_d = stfnum::t_half(data, 0.0, 1.0, 0, data.size()-1, n_peak, lo_d, hi_d, tLo_d);
+    double thr_d = stfnum::threshold(data, 0, n_peak, 0.5*dt, thrT_d, 1);
+    double rise_d = stfnum::maxRise(data, 0, n_peak, riseT_d, riseY, 1);
+
+    Section sec(data);
+    sec.SetStorage(stfio::float32);
+    const Section& csec = sec;
+    double tol = 1.0e-3;
+    EXPECT_NEAR(stfnum::risetime(csec, 0.0, 1.0, 1, n_peak-1, 0.2, lo_s, hi_s, tLo_s), rt_d, tol);
+    EXPECT_NEAR(stfnum::t_half(csec, 0.0, 1.0, 0, data.size()-1, n_peak, lo_s, hi_s, tLo_s), half_d, tol);
+    EXPECT_NEAR(stfnum::threshold(csec, 0, n_peak, 0.5*dt, thrT_s, 1), thr_d, tol);
+    EXPECT_EQ(thrT_s, thrT_d);
+    EXPECT_NEAR(stfnum::maxRise(csec, 0, n_peak, riseT_s, riseY, 1), rise_d, tol);
+    EXPECT_EQ(riseT_s, riseT_d);
+    EXPECT_TRUE(csec.IsStored());
+}
+
+//=========================================================================
+// test median baselines against sorting the data
+//=========================================================================
+TEST(measlib_test, median_baseline) {
+    std::vector<double> data(2000);
+    for (std::size_t n=0; n<data.size(); ++n) {
+        data[n] = sin(n*dt*7.0) + 0.002*n + 0.1*((n*37) % 11);
+    }
+    for (std::size_t len=1; len<60; len+=(len<10 ? 1 : 7)) {
+        std::vector<double> a(data.begin()+100, data.begin()+100+len);
+        std::sort(a.begin(), a.end());
+        std::size_t n = len;
+        double median = (n % 2) ? a[(n-1)/2] : (a[n/2-1] + a[n/2]) / 2;
+        if (n % 2 == 0) n /= 2;
+        double Q32 = a[std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1))] + a[std::max<long>(0l, (long)floor(3*n/4.0-1))];
+        double Q12 = a[std::min<long>((long)(n-1), (long)ceil(  n/4.0-1))] + a[std::max<long>(0l, (long)floor(  n/4.0-1))];
+        double var;
+        EXPECT_EQ(stfnum::base(stfnum::median_iqr, var, data, 100, 100+len-1), median);
+        EXPECT_DOUBLE_EQ(var, (Q32 - Q12) / 2);
+    }
+
+    /* the rolling baseline equals the median of each window */
+    const std::size_t window = 51;
+    Vector_double median, iqr;
+    stfnum::rollingBase(data, window, median, iqr);
+    ASSERT_EQ(median.size(), data.size());
+    for (std::size_t i=0; i<data.size(); i+=13) {
+        std::size_t first = std::min(i > window/2 ? i-window/2 : 0, data.size()-window);
+        double var;
+        EXPECT_EQ(median[i], stfnum::base(stfnum::median_iqr, var, data, first, first+window-1));
+        EXPECT_DOUBLE_EQ(iqr[i], var);
+    }
+    Section sec(data);
+    sec.SetStorage(stfio::float32);
+    Vector_double median_s, iqr_s;
+    stfnum::rollingBase(sec, window, median_s, iqr_s);
+    EXPECT_TRUE(sec.IsStored());
+    for (std::size_t i=0; i<data.size(); ++i) {
+        EXPECT_NEAR(median_s[i], median[i], 1e-6);
+    }
+    EXPECT_THROW(stfnum::rollingBase(data, data.size()+1, median, iqr), std::out_of_range);
+}
+
 //=========================================================================
 // test peak out of range exceptions
 //=========================================================================
@@ -259,6 +359,68 @@ TEST(measlib_test, peak_out_of_range_exceptions) {
         1, stfnum::both, maxT)));
 }
 
+//=========================================================================
+// test the sliding average of the peak against a direct computation
+//=========================================================================
+TEST(measlib_test, peak_sliding_average) {
+    std::vector<double> data(3000);
+    for (std::size_t n=0; n<data.size(); ++n) {
+        data[n] = sin(n*dt*3.0) + 0.3*sin(n*dt*41.0) + ((n/50) % 2 ? 0.5 : 0.0);
+    }
+    const int widths[] = {1, 2, 5, 24};
+    const stfnum::direction dirs[] = {stfnum::up, stfnum::down, stfnum::both};
+    const std::size_t windows[][2] = {{0, 2999}, {3, 40}, {2900, 2999}, {700, 700}};
+    for (int n_w=0; n_w<4; ++n_w) {
+        for (int n_d=0; n_d<3; ++n_d) {
+            for (int n_l=0; n_l<4; ++n_l) {
+                int pM = widths[n_w];
+                std::size_t llp = windows[n_l][0], ulp = windows[n_l][1];
+                double base = 0.1, maxT;
+                double peak = stfnum::peak(data, base, llp, ulp, pM, dirs[n_d], maxT);
+
+                double max = data[llp], maxT_xpted = llp;
+                for (std::size_t i=llp+1; i<=ulp; ++i) {
+                    int start = std::max(0, (int)i-(pM-1)/2);
+                    int end = std::min(start+pM, (int)data.size());
+                    double avg = 0.0;
+                    for (int k=start; k<end; ++k) avg += data[k];
+                    avg /= (end-start);
+                    if (stfnum::peakDistance(avg-base, dirs[n_d]) >
+                        stfnum::peakDistance(max-base, dirs[n_d]) + 1e-12) {
+                        max = avg;
+                        maxT_xpted = i;
+                    }
+                }
+                EXPECT_NEAR(peak, max, 1e-9);
+                EXPECT_EQ(maxT, maxT_xpted);
+            }
+        }
+    }
+
+    /* several sections of a channel in one call */
+    Channel ch(3, data.size());
+    for (std::size_t n_s=0; n_s<ch.size(); ++n_s) {
+        for (std::size_t n=0; n<data.size(); ++n) {
+            ch[n_s][n] = data[n]*(n_s+1.0);
+        }
+    }
+    ch[2].SetStorage(stfio::float32);
+    std::vector<std::size_t> sections(2);
+    sections[0] = 2;
+    sections[1] = 0;
+    Vector_double base(2, 0.0), maxT;
+    Vector_double peaks = stfnum::peak(ch, sections, base, 10, 2000, 5, stfnum::up, maxT);
+    ASSERT_EQ(peaks.size(), 2);
+    for (std::size_t n_s=0; n_s<sections.size(); ++n_s) {
+        double maxT_s;
+        const Section& csec = ch[sections[n_s]];
+        EXPECT_DOUBLE_EQ(peaks[n_s], stfnum::peak(csec, 0.0, 10, 2000, 5, stfnum::up, maxT_s));
+        EXPECT_EQ(maxT[n_s], maxT_s);
+    }
+    sections[1] = 3;
+    EXPECT_THROW(stfnum::peak(ch, sections, base, 10, 2000, 5, stfnum::up, maxT), std::out_of_range);
+}
+
 //=========================================================================
 // test peak direction
 //=========================================================================
@@ -633,6 +795,191 @@ TEST(measlib_test, maxdecay_values){
 
 
 
+//=========================================================================
+// detection criterion with a long template (computed with FFTs)
+// must match the direct summation of Clements & Bekkers (1997)
+//=========================================================================
+TEST(measlib_test, detection_criterion_fft) {
+
+    std::vector<double> mydata = sinwave(2.0, 3.0, 20000);
+    std::vector<double> noise = rand(mydata.size());
+    for (std::size_t i=0; i<mydata.size(); ++i) {
+        mydata[i] += noise[i];
+    }
+    std::vector<double> templ = expwave(-2.0, 400);
+
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double crit = stfnum::detectionCriterion(mydata, templ, progDlg);
+    EXPECT_EQ(crit.size(), mydata.size()-templ.size());
+
+    double st=0.0, stt=0.0;
+    for (std::size_t k=0; k<templ.size(); ++k) {
+        st += templ[k];
+        stt += templ[k]*templ[k];
+    }
+    double M = templ.size();
+    for (std::size_t n=0; n<crit.size(); n+=997) {
+        double sd=0.0, sdd=0.0, std_=0.0;
+        for (std::size_t k=0; k<templ.size(); ++k) {
+            sd += mydata[n+k];
+            sdd += mydata[n+k]*mydata[n+k];
+            std_ += templ[k]*mydata[n+k];
+        }
+        double scale = (std_-st*sd/M)/(stt-st*st/M);
+        double offset = (sd-scale*st)/M;
+        double sse = sdd+scale*scale*stt+M*offset*offset -
+            2.0*(scale*std_+offset*sd-scale*offset*st);
+        double expected = scale/sqrt(sse/(M-1));
+        EXPECT_NEAR(crit[n], expected, fabs(expected)*1e-6+1e-9);
+    }
+}
+
+//=========================================================================
+// linear correlation must match the three-pass computation with
+// the optimally scaled template, also when computed in chunks
+//=========================================================================
+TEST(measlib_test, linear_correlation_stream) {
+
+    std::vector<double> mydata = sinwave(2.0, 3.0, 20000);
+    std::vector<double> noise = rand(mydata.size());
+    for (std::size_t i=0; i<mydata.size(); ++i) {
+        mydata[i] += 1000.0 + noise[i];
+    }
+    std::vector<double> templ = expwave(-2.0, 400);
+
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double corr = stfnum::linCorr(mydata, templ, progDlg);
+    EXPECT_EQ(corr.size(), mydata.size()-templ.size());
+
+    double M = templ.size();
+    double st=0.0, stt=0.0;
+    for (std::size_t k=0; k<templ.size(); ++k) {
+        st += templ[k];
+        stt += templ[k]*templ[k];
+    }
+    for (std::size_t n=0; n<corr.size(); n+=997) {
+        double sd=0.0, std_=0.0;
+        for (std::size_t k=0; k<templ.size(); ++k) {
+            sd += mydata[n+k];
+            std_ += templ[k]*mydata[n+k];
+        }
+        double scale = (std_-st*sd/M)/(stt-st*st/M);
+        double offset = (sd-scale*st)/M;
+        double mean_data = sd/M;
+        double mean_opt = (st*scale+offset*M)/M;
+        double sd_data=0.0, sd_opt=0.0, r=0.0;
+        for (std::size_t k=0; k<templ.size(); ++k) {
+            double opt = templ[k]*scale+offset;
+            sd_data += (mydata[n+k]-mean_data)*(mydata[n+k]-mean_data);
+            sd_opt += (opt-mean_opt)*(opt-mean_opt);
+            r += (mydata[n+k]-mean_data)*(opt-mean_opt);
+        }
+        r /= (M-1)*sqrt(sd_data/M)*sqrt(sd_opt/M);
+        EXPECT_NEAR(corr[n], r, 1e-6);
+    }
+
+    /* feed the data in small, irregular chunks */
+    stfnum::LinCorrStream stream(templ);
+    Vector_double chunkCorr(mydata.size());
+    Vector_double streamed;
+    for (std::size_t n=0, len=1; n<mydata.size(); n+=len, len=(len*7)%1000+1) {
+        len = std::min(len, mydata.size()-n);
+        std::size_t n_new = stream.Push(&mydata[n], len, &chunkCorr[0]);
+        streamed.insert(streamed.end(), chunkCorr.begin(), chunkCorr.begin()+n_new);
+    }
+    EXPECT_EQ(stream.Count(), mydata.size()-templ.size()+1);
+    EXPECT_EQ(streamed.size(), mydata.size()-templ.size()+1);
+    for (std::size_t n=0; n<corr.size(); ++n) {
+        EXPECT_NEAR(streamed[n], corr[n], 1e-9);
+    }
+}
+
+//=========================================================================
+// repeated filtering of equal-sized data reuses cached FFTW plans
+// and must give identical results
+//=========================================================================
+TEST(measlib_test, filter_plan_cache) {
+
+    std::vector<double> mywave = sinwave(1.0, 50.0, 1000);
+    Vector_double a(1, 10.0);
+    Vector_double first = stfnum::filter(mywave, 0, mywave.size()-1, a, 100,
+        stfnum::fgaussColqu, false);
+    Vector_double second = stfnum::filter(mywave, 0, mywave.size()-1, a, 100,
+        stfnum::fgaussColqu, false);
+    EXPECT_EQ(first.size(), mywave.size());
+    for (std::size_t i=0; i<first.size(); ++i) {
+        EXPECT_DOUBLE_EQ(first[i], second[i]);
+        /* the slow sine wave passes the lowpass filter */
+        EXPECT_NEAR(first[i], mywave[i], 0.05);
+    }
+    stfnum::fftwClearCache();
+}
+
+//=========================================================================
+// test batch measurements of several sections
+//=========================================================================
+TEST(measlib_test, batch) {
+
+    const std::size_t n_sec = 8, n_points = 2000;
+    std::deque<Section> sections;
+    for (std::size_t n_s=0; n_s<n_sec; ++n_s) {
+        Vector_double data(n_points, -60.0);
+        /* event with a 1 ms decay at 5 ms, amplitude 1..8 */
+        for (std::size_t n=500; n<n_points; ++n) {
+            data[n] += (n_s+1.0) * exp(-(n-500.0)*dt);
+        }
+        sections.push_back(Section(data));
+    }
+    Channel ch(sections);
+    ch[n_sec-1].SetStorage(stfio::float32);
+
+    std::vector<stfnum::storedFunc> funcLib = stfnum::GetFuncLib();
+    stfnum::BatchSettings settings;
+    settings.baseBeg = 0;
+    settings.baseEnd = 400;
+    settings.peakBeg = 450;
+    settings.peakEnd = 1000;
+    settings.direction = stfnum::up;
+    settings.fitBeg = 501;
+    settings.fitEnd = n_points;
+    settings.fitFunc = &funcLib[0];
+    settings.columns |= stfnum::colPeakTime | stfnum::colFit | stfnum::colCrossings;
+    settings.crossingThreshold = -59.5;
+
+    std::vector<std::size_t> selected;
+    for (std::size_t n_s=0; n_s<n_sec; ++n_s) {
+        selected.push_back(n_s);
+    }
+    std::vector<stfnum::BatchResult> results;
+    stfnum::Table table = stfnum::measureBatch(ch, selected, dt, settings, NULL, &results, 4);
+
+    /* base, peak, rise time, t50, peak time, 3 parameters, warning, crossings */
+    EXPECT_EQ(table.nRows(), n_sec);
+    EXPECT_EQ(table.nCols(), 5 + funcLib[0].pInfo.size() + 2);
+    ASSERT_EQ(results.size(), n_sec);
+    for (std::size_t n_s=0; n_s<n_sec; ++n_s) {
+        EXPECT_TRUE(results[n_s].error.empty());
+        EXPECT_NEAR(table.at(n_s, 0), -60.0, 1e-12);
+        EXPECT_NEAR(table.at(n_s, 1), n_s+1.0, 1e-5);
+        EXPECT_NEAR(table.at(n_s, 2), 500*dt, 1e-12);
+        /* tau of the mono-exponential fit */
+        EXPECT_NEAR(results[n_s].params[1], 1.0, 0.01);
+        EXPECT_EQ(results[n_s].crossings, 1);
+
+        stfnum::BatchResult single = stfnum::measureSection(ch[n_s], dt, settings);
+        EXPECT_EQ(single.peak, results[n_s].peak);
+        EXPECT_EQ(single.halfDuration, results[n_s].halfDuration);
+    }
+    /* stored sections are measured without being copied into memory */
+    EXPECT_TRUE(ch[n_sec-1].IsStored());
+
+    /* cursors out of range only invalidate the affected rows */
+    settings.fitEnd = n_points+1;
+    table = stfnum::measureBatch(ch, selected, dt, settings, NULL, &results);
+    EXPECT_FALSE(results[0].error.empty());
+    EXPECT_TRUE(table.IsEmpty(0, 0));
+}
+
 //=========================================================================
 // test baseline N_MAX random traces
 //=========================================================================
@@ -1,5 +1,12 @@
 #include "../libstfio/stfio.h"
+#include "../libstfio/hdf5/hdf5lib.h"
 #include <gtest/gtest.h>
+#include <hdf5.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <cmath>
 
 TEST(Recording_test, constructors)
 {
@@ -58,3 +65,484 @@ TEST(Recording_test, data_access)
     EXPECT_THROW( rec3[recsize-1].at(chsize), std::out_of_range );
     EXPECT_THROW( rec3[recsize-1][chsize-1].at(secsize), std::out_of_range );
 }
+
+class CountingReceiver : public stfio::ImportReceiver {
+public:
+    CountingReceiver(std::size_t n) : received(n, 0), sizes(n, 0), errors(n) {}
+    bool Receive(std::size_t index, Recording& data, const std::string& error) {
+        ++received[index];
+        sizes[index] = data.size() ? data[0].size() : 0;
+        errors[index] = error;
+        return true;
+    }
+    std::vector<int> received;
+    std::vector<std::size_t> sizes;
+    std::vector<std::string> errors;
+};
+
+TEST(Recording_test, import_files)
+{
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    std::vector<std::string> fNames;
+    for (int n_f = 0; n_f < 6; ++n_f) {
+        Recording rec(1, n_f+1, 1000);
+        rec.SetXScale(0.1);
+        rec[0].SetChannelName("Ch0");
+        rec[0].SetYUnits("mV");
+        std::ostringstream fName;
+        fName << "import_files_test_" << n_f << ".h5";
+        ASSERT_TRUE( stfio::exportFile(fName.str(), stfio::hdf5, rec, progDlg) );
+        fNames.push_back(fName.str());
+    }
+    fNames.push_back("import_files_test_missing.h5");
+
+    CountingReceiver receiver(fNames.size());
+    stfio::txtImportSettings txtImport;
+    std::size_t n_ok = stfio::importFiles(fNames, stfio::none, receiver, txtImport,
+                                          progDlg, 3, 1);
+    EXPECT_EQ( n_ok, fNames.size()-1 );
+    for (std::size_t n_f = 0; n_f < fNames.size()-1; ++n_f) {
+        EXPECT_EQ( receiver.received[n_f], 1 );
+        EXPECT_EQ( receiver.sizes[n_f], n_f+1 );
+        EXPECT_TRUE( receiver.errors[n_f].empty() );
+        std::remove(fNames[n_f].c_str());
+    }
+    EXPECT_EQ( receiver.received.back(), 1 );
+    EXPECT_FALSE( receiver.errors.back().empty() );
+
+    // Errors left on the HDF5 error stack of a worker thread keep the
+    // library from shutting down cleanly at exit:
+    int n_errors = 0;
+#pragma omp parallel num_threads(3) reduction(+:n_errors)
+    n_errors += H5Eget_num(H5E_DEFAULT);
+    EXPECT_EQ( n_errors, 0 );
+}
+
+TEST(Recording_test, import_storage)
+{
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Recording rec(2, 3, 1000);
+    rec.SetXScale(0.1);
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+            for (std::size_t n = 0; n < rec[n_c][n_s].size(); ++n) {
+                rec[n_c][n_s][n] = std::sin(0.01*n) * (n_c+1.0) + (double)n_s;
+            }
+        }
+    }
+    const std::string fName("import_storage_test.h5");
+    ASSERT_TRUE( stfio::exportFile(fName, stfio::hdf5, rec, progDlg) );
+
+    Recording imported;
+    ASSERT_TRUE( stfio::importFile(fName, stfio::hdf5, imported, stfio::txtImportSettings(), progDlg) );
+    EXPECT_EQ( imported[0][0].GetStorage(), stfio::float64 );
+
+    Recording compact;
+    ASSERT_TRUE( stfio::importFile(fName, stfio::hdf5, compact, stfio::txtImportSettings(), progDlg,
+                                   stfio::int16) );
+    std::remove(fName.c_str());
+    ASSERT_EQ( compact.size(), rec.size() );
+    for (std::size_t n_c = 0; n_c < compact.size(); ++n_c) {
+        ASSERT_EQ( compact[n_c].size(), rec[n_c].size() );
+        for (std::size_t n_s = 0; n_s < compact[n_c].size(); ++n_s) {
+            const Section& sec = compact[n_c][n_s];
+            EXPECT_EQ( sec.GetStorage(), stfio::int16 );
+            // 65535 levels across the range of each section:
+            double tol = 2.0*(n_c+1.0)/65535.0;
+            for (std::size_t n = 0; n < sec.size(); ++n) {
+                EXPECT_NEAR( sec[n], rec[n_c][n_s][n], tol );
+            }
+        }
+    }
+}
+
+// Writes an unsigned integer of n_bytes in little-endian byte order:
+static void writeLE(std::ofstream& file, unsigned long value, int n_bytes) {
+    for (int n_b = 0; n_b < n_bytes; ++n_b) {
+        file.put((char)((value >> (8*n_b)) & 0xff));
+    }
+}
+
+// Writes an Intan CLAMP file of auxiliary data with a single ADC channel:
+static void writeIntanAux(const std::string& fName, std::size_t n_points, unsigned int offset) {
+    std::ofstream file(fName.c_str(), std::ios::binary);
+    writeLE(file, 0xf3b1a481, 4); // magic number
+    writeLE(file, 1, 2);          // version
+    writeLE(file, 0, 2);
+    writeLE(file, 1, 2);          // auxiliary data
+    writeLE(file, 1, 2);          // number of ADCs
+    writeLE(file, 30, 2);         // header size
+    const unsigned int date[] = {2017, 3, 11, 12, 0, 0};
+    for (int n_d = 0; n_d < 6; ++n_d) {
+        writeLE(file, date[n_d], 2);
+    }
+    float samplingRate = 10000.0f;
+    unsigned int rawRate = 0;
+    std::memcpy(&rawRate, &samplingRate, 4);
+    writeLE(file, rawRate, 4);
+    for (std::size_t n = 0; n < n_points; ++n) {
+        writeLE(file, n, 4);     // time stamp
+        writeLE(file, 0, 2);     // digital in
+        writeLE(file, 0, 2);     // digital out
+        writeLE(file, (offset+n) & 0xffff, 2);
+    }
+}
+
+TEST(Recording_test, import_reentrant)
+{
+    // Intan files are read without a lock, so that two of them can be
+    // imported at the same time:
+    const std::size_t n_points[] = {300000, 200000};
+    const unsigned int offsets[] = {7, 1234};
+    std::vector<std::string> fNames;
+    for (int n_f = 0; n_f < 2; ++n_f) {
+        std::ostringstream fName;
+        fName << "import_reentrant_test_" << n_f << ".clp";
+        writeIntanAux(fName.str(), n_points[n_f], offsets[n_f]);
+        fNames.push_back(fName.str());
+    }
+
+    Recording recs[2];
+    std::string errors[2];
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(2)
+#endif
+    for (int n_f = 0; n_f < 2; ++n_f) {
+        stfio::StdoutProgressInfo progDlg("", "", 100, false);
+        try {
+            stfio::importFile(fNames[n_f], stfio::intan, recs[n_f], stfio::txtImportSettings(), progDlg);
+        }
+        catch (const std::exception& e) {
+            errors[n_f] = e.what();
+        }
+    }
+    for (int n_f = 0; n_f < 2; ++n_f) {
+        EXPECT_TRUE( errors[n_f].empty() ) << errors[n_f];
+        ASSERT_EQ( recs[n_f].size(), 1 );
+        const Section& sec = recs[n_f][0][0];
+        ASSERT_EQ( sec.size(), n_points[n_f] );
+        for (std::size_t n = 0; n < sec.size(); n += 997) {
+            unsigned int sample = (offsets[n_f]+n) & 0xffff;
+            EXPECT_FLOAT_EQ( sec[n], (float)(sample*0.0003125 - (1<<15)) );
+        }
+    }
+
+    // the same files through importFiles() on two threads:
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    CountingReceiver receiver(fNames.size());
+    std::size_t n_ok = stfio::importFiles(fNames, stfio::none, receiver, stfio::txtImportSettings(),
+                                          progDlg, 2, 0);
+    EXPECT_EQ( n_ok, fNames.size() );
+    for (std::size_t n_f = 0; n_f < fNames.size(); ++n_f) {
+        EXPECT_EQ( receiver.received[n_f], 1 );
+        EXPECT_EQ( receiver.sizes[n_f], 1 );
+        EXPECT_TRUE( receiver.errors[n_f].empty() );
+        std::remove(fNames[n_f].c_str());
+    }
+}
+
+TEST(Recording_test, atf_roundtrip)
+{
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Recording rec(1, 4, 500);
+    for (std::size_t n_s = 0; n_s < rec[0].size(); ++n_s) {
+        for (std::size_t n = 0; n < rec[0][n_s].size(); ++n) {
+            rec[0][n_s][n] = 0.25*n_s - 1.5e-3*n + 0.125*sin(0.05*n);
+        }
+    }
+    rec.SetXScale(0.02);
+    rec[0].SetYUnits("mV");
+    const char* fName = "atf_roundtrip_test.atf";
+    ASSERT_TRUE( stfio::exportFile(fName, stfio::atf, rec, progDlg) );
+    Recording imported;
+    ASSERT_TRUE( stfio::importFile(fName, stfio::atf, imported, stfio::txtImportSettings(), progDlg) );
+    ASSERT_EQ( imported.size(), 1 );
+    ASSERT_EQ( imported[0].size(), rec[0].size() );
+    EXPECT_NEAR( imported.GetXScale(), rec.GetXScale(), 1e-9 );
+    EXPECT_EQ( imported[0].GetYUnits(), "mV" );
+    for (std::size_t n_s = 0; n_s < rec[0].size(); ++n_s) {
+        ASSERT_EQ( imported[0][n_s].size(), rec[0][n_s].size() );
+        for (std::size_t n = 0; n < rec[0][n_s].size(); ++n) {
+            EXPECT_NEAR( imported[0][n_s][n], rec[0][n_s][n], 1e-6 );
+        }
+    }
+
+    // CRLF line endings, empty fields, signs and spaces around the delimiters:
+    std::ofstream output_file(fName, std::ios::binary);
+    output_file << "ATF\t1.0\r\n"
+                << "0\t4\r\n"
+                << "\"Time (ms)\"\t\"Trace #1 (pA)\"\t\"Trace #2 (pA)\"\t\"Trace #3 (pA)\"\r\n"
+                << "0\t+1.5\t-2\t3e2\r\n"
+                << "0.1\t\t +4.25 \t-0.5\r\n"
+                << "0.2 , 7,,\r\n";
+    output_file.close();
+    ASSERT_TRUE( stfio::importFile(fName, stfio::atf, imported, stfio::txtImportSettings(), progDlg) );
+    ASSERT_EQ( imported[0].size(), 3 );
+    EXPECT_NEAR( imported.GetXScale(), 0.1, 1e-9 );
+    EXPECT_EQ( imported[0].GetYUnits(), "pA" );
+    double expected[3][3] = { {1.5, 0.0, 7.0}, {-2.0, 4.25, 0.0}, {300.0, -0.5, 0.0} };
+    for (std::size_t n_s = 0; n_s < 3; ++n_s) {
+        ASSERT_EQ( imported[0][n_s].size(), 3 );
+        for (std::size_t n = 0; n < 3; ++n) {
+            EXPECT_EQ( imported[0][n_s][n], expected[n_s][n] );
+        }
+    }
+    std::remove(fName);
+}
+
+TEST(Recording_test, hdf5_layouts)
+{
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Recording rec(2, 5, 0);
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+            // ragged sections, including an empty one:
+            Section sec(n_s == 3 ? 0 : 70000 + 1000*n_s);
+            for (std::size_t n = 0; n < sec.size(); ++n) {
+                sec[n] = 0.5*n_c + 0.25*sin(0.01*n) + n_s;
+            }
+            // descriptions of different lengths, including an empty one:
+            if (n_s != 1) {
+                std::ostringstream desc;
+                desc << "Sweep " << std::string(n_s, '#') << n_c << n_s;
+                sec.SetSectionDescription(desc.str());
+            }
+            rec[n_c].InsertSection(sec, n_s);
+        }
+    }
+    rec[1][2].SetStorage(stfio::int16);
+    rec.SetXScale(0.05);
+    rec.SetXUnits("s");
+    rec.SetComment("hdf5 test");
+    rec[0].SetChannelName("Vm");
+    rec[1].SetYUnits("pA");
+
+    const char* fName = "hdf5_layouts_test.h5";
+    stfio::hdf5_layout layouts[] = {stfio::hdf5_channels, stfio::hdf5_channels, stfio::hdf5_sections};
+    int compression[] = {0, 4, 0};
+    for (int n_l = 0; n_l < 3; ++n_l) {
+        ASSERT_TRUE( stfio::exportHDF5File(fName, rec, progDlg, layouts[n_l], compression[n_l]) );
+        Recording imported;
+        ASSERT_TRUE( stfio::importFile(fName, stfio::hdf5, imported, stfio::txtImportSettings(), progDlg) );
+        ASSERT_EQ( imported.size(), rec.size() );
+        EXPECT_EQ( imported.GetXScale(), rec.GetXScale() );
+        EXPECT_EQ( imported[0].GetChannelName(), "Vm" );
+        EXPECT_EQ( imported[1].GetYUnits(), "pA" );
+        if (layouts[n_l] == stfio::hdf5_channels) {
+            EXPECT_EQ( imported.GetComment(), rec.GetComment() );
+            EXPECT_EQ( imported.GetXUnits(), "s" );
+        }
+        for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+            ASSERT_EQ( imported[n_c].size(), rec[n_c].size() );
+            for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+                const Section& expected = rec[n_c][n_s];
+                const Section& actual = imported[n_c][n_s];
+                if (layouts[n_l] == stfio::hdf5_channels) {
+                    EXPECT_EQ( actual.GetSectionDescription(), expected.GetSectionDescription() );
+                }
+                ASSERT_EQ( actual.size(), expected.size() );
+                for (std::size_t n = 0; n < actual.size(); n += 97) {
+                    EXPECT_FLOAT_EQ( actual[n], expected[n] );
+                }
+            }
+        }
+    }
+    std::remove(fName);
+}
+
+TEST(Recording_test, hdf5_lazy)
+{
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Recording rec(2, 6, 0);
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+            Section sec(n_s == 4 ? 0 : 20000 + 500*n_s);
+            for (std::size_t n = 0; n < sec.size(); ++n) {
+                sec[n] = n_c - 0.5*cos(0.003*n) + n_s;
+            }
+            rec[n_c].InsertSection(sec, n_s);
+        }
+    }
+    rec.SetXScale(0.1);
+    rec[1].SetYUnits("mV");
+
+    const char* fName = "hdf5_lazy_test.h5";
+    ASSERT_TRUE( stfio::exportHDF5File(fName, rec, progDlg, stfio::hdf5_channels, 1) );
+    {
+        Recording opened;
+        stfio::openHDF5File(fName, opened, progDlg);
+        ASSERT_EQ( opened.size(), rec.size() );
+        EXPECT_EQ( opened.GetXScale(), rec.GetXScale() );
+        EXPECT_EQ( opened[1].GetYUnits(), "mV" );
+        for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+            ASSERT_EQ( opened[n_c].size(), rec[n_c].size() );
+            for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+                EXPECT_EQ( opened[n_c][n_s].size(), rec[n_c][n_s].size() );
+                EXPECT_TRUE( opened[n_c][n_s].IsStored() );
+            }
+        }
+
+        // A window is read without loading the section:
+        const Recording& copened = opened;
+        Vector_double window(1000);
+        copened[1][2].Read(12345, window.size(), &window[0]);
+        for (std::size_t n = 0; n < window.size(); ++n) {
+            EXPECT_FLOAT_EQ( window[n], rec[1][2][12345+n] );
+        }
+        EXPECT_THROW( copened[1][2].Read(21000, 1000, &window[0]), std::out_of_range );
+
+        // The file can't be overwritten while sections read from it:
+        EXPECT_TRUE( stfio::isHDF5FileOpen(fName) );
+        EXPECT_THROW( stfio::exportHDF5File(fName, opened, progDlg), std::runtime_error );
+
+        // Sections can be read from several threads:
+        int n_failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:n_failed)
+#endif
+        for (int n_s = 0; n_s < (int)rec[0].size(); ++n_s) {
+            for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+                const Vector_double& expected = rec[n_c][n_s].get();
+                const Vector_double& actual = copened[n_c][n_s].get();
+                for (std::size_t n = 0; n < expected.size(); ++n) {
+                    if (fabs(actual[n]-expected[n]) > 1e-5) ++n_failed;
+                }
+            }
+        }
+        EXPECT_EQ( n_failed, 0 );
+        EXPECT_FALSE( copened[0][0].IsStored() );
+
+        // but once they have been copied into memory:
+        EXPECT_FALSE( stfio::isHDF5FileOpen(fName) );
+        EXPECT_TRUE( stfio::exportHDF5File(fName, opened, progDlg, stfio::hdf5_channels) );
+    }
+
+    // The legacy layout is still the default and is read at once:
+    ASSERT_TRUE( stfio::exportHDF5File(fName, rec, progDlg) );
+    Recording legacy;
+    stfio::openHDF5File(fName, legacy, progDlg);
+    ASSERT_EQ( legacy.size(), rec.size() );
+    EXPECT_FALSE( legacy[0][1].IsStored() );
+    EXPECT_FLOAT_EQ( legacy[0][1][100], rec[0][1][100] );
+    std::remove(fName);
+}
+
+TEST(Recording_test, make_average)
+{
+    const std::size_t n_sec = 7, n_points = 10000;
+    Recording rec(1, n_sec, n_points);
+    for (std::size_t n_s = 0; n_s < n_sec; ++n_s) {
+        for (std::size_t n = 0; n < n_points; ++n) {
+            rec[0][n_s][n] = 1.0e3 + sin(0.001*n*(n_s+1)) + 0.1*n_s;
+        }
+    }
+    rec[0][n_sec-1].SetStorage(stfio::float32);
+
+    std::vector<std::size_t> sections(n_sec);
+    std::vector<int> shift(n_sec);
+    for (std::size_t n_s = 0; n_s < n_sec; ++n_s) {
+        sections[n_s] = n_s;
+        shift[n_s] = n_s % 3;
+    }
+    Section average(n_points-2), sig(n_points-2);
+    rec.MakeAverage(average, sig, 0, sections, true, shift);
+    EXPECT_TRUE( rec[0][n_sec-1].IsStored() );
+
+    for (std::size_t n = 0; n < average.size(); ++n) {
+        const Recording& crec = rec;
+        double sum = 0.0, sumsq = 0.0;
+        for (std::size_t n_s = 0; n_s < n_sec; ++n_s) {
+            sum += crec[0][n_s][n+shift[n_s]];
+        }
+        double mean = sum/n_sec;
+        for (std::size_t n_s = 0; n_s < n_sec; ++n_s) {
+            sumsq += pow(crec[0][n_s][n+shift[n_s]]-mean, 2);
+        }
+        EXPECT_NEAR( average[n], mean, 1e-9 );
+        EXPECT_NEAR( sig[n], sqrt(sumsq/(n_sec-1)), 1e-9 );
+    }
+
+    std::vector<int> too_far(n_sec, 3);
+    EXPECT_THROW( rec.MakeAverage(average, sig, 0, sections, true, too_far), std::out_of_range );
+}
+
+TEST(Recording_test, running_average)
+{
+    const std::size_t n_sec = 6, n_points = 5000;
+    Recording rec(2, n_sec, n_points);
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        for (std::size_t n_s = 0; n_s < n_sec; ++n_s) {
+            for (std::size_t n = 0; n < n_points; ++n) {
+                rec[n_c][n_s][n] = 1.0e3*n_c + sin(0.002*n*(n_s+1)) + 0.1*n_s;
+            }
+        }
+    }
+    rec[1][2].SetStorage(stfio::int16);
+
+    EXPECT_THROW( rec.GetSelectAverage(0), std::out_of_range );
+    rec.SelectTrace(0, 0, 10);
+    rec.SetTrackAverage(true);
+    for (std::size_t n_s = 1; n_s < n_sec; ++n_s) {
+        rec.SelectTrace(n_s, 0, 10);
+    }
+    EXPECT_TRUE( rec.UnselectTrace(1) );
+    EXPECT_TRUE( rec.UnselectTrace(4) );
+    EXPECT_TRUE( rec[1][2].IsStored() );
+
+    std::vector<int> shift(rec.GetSelectedSections().size(), 0);
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        const RunningAverage& avg = rec.GetSelectAverage(n_c);
+        EXPECT_EQ( avg.GetCount(), rec.GetSelectedSections().size() );
+        Section average(n_points), sig(n_points);
+        rec.MakeAverage(average, sig, n_c, rec.GetSelectedSections(), true, shift);
+        Vector_double sd(avg.GetSD());
+        ASSERT_EQ( avg.size(), n_points );
+        for (std::size_t n = 0; n < n_points; ++n) {
+            EXPECT_NEAR( avg.GetMean()[n], average[n], 1e-9 );
+            EXPECT_NEAR( sd[n], sig[n], 1e-6 );
+        }
+    }
+
+    // shifted sections, a shorter one truncates the average:
+    RunningAverage avg;
+    avg.Add(rec[0][0], 2);
+    avg.Add(rec[0][1], 0);
+    avg.Add(rec[0][3], 5);
+    EXPECT_EQ( avg.size(), n_points-5 );
+    avg.Remove(rec[0][1], 0);
+    const Recording& crec = rec;
+    for (std::size_t n = 0; n < avg.size(); ++n) {
+        EXPECT_NEAR( avg.GetMean()[n], 0.5*(crec[0][0][n+2]+crec[0][3][n+5]), 1e-9 );
+    }
+    EXPECT_THROW( avg.Add(rec[0][0], n_points+1), std::out_of_range );
+
+    rec.UnselectAll();
+    EXPECT_EQ( rec.GetSelectAverage(0).GetCount(), 0 );
+    EXPECT_TRUE( rec.GetSelectAverage(1).GetMean().empty() );
+}
+
+TEST(Recording_test, select_stored)
+{
+    // The baseline of a stored section in the current channel is read
+    // without copying the section into memory:
+    const std::size_t n_points = 200000;
+    Recording rec(1, 2, n_points);
+    for (std::size_t n_s = 0; n_s < 2; ++n_s) {
+        for (std::size_t n = 0; n < n_points; ++n) {
+            rec[0][n_s][n] = sin(0.0001*n) + n_s;
+        }
+    }
+    rec[0][1].SetStorage(stfio::int16);
+    rec.SelectTrace(0, 0, n_points-1);
+    rec.SelectTrace(1, 100, n_points-1);
+    EXPECT_TRUE( rec[0][1].IsStored() );
+    ASSERT_EQ( rec.GetSelectBase().size(), 2 );
+
+    const Recording& crec = rec;
+    double sum = 0.0;
+    for (std::size_t n = 100; n < n_points; ++n) {
+        sum += crec[0][1][n];
+    }
+    EXPECT_NEAR( rec.GetSelectBase()[1], sum/(n_points-100), 1e-9 );
+    EXPECT_NEAR( rec.GetSelectBase()[1]-rec.GetSelectBase()[0], 1.0, 1e-3 );
+}
@@ -1,5 +1,7 @@
 #include "../libstfio/stfio.h"
 #include <gtest/gtest.h>
+#include <fstream>
+#include <cstdio>
 
 TEST(Section_test, constructors) {
     Section sec0;
@@ -22,3 +24,176 @@ TEST(Section_test, data_access) {
     EXPECT_EQ( sec2[sec2.size()-1], 0 );
     EXPECT_THROW( sec2.at( sec2.size() ), std::out_of_range );
 }
+
+TEST(Section_test, extrema) {
+
+    std::size_t n_data = 100003;
+    Section sec(n_data, "Test section");
+    for (std::size_t n=0; n<n_data; ++n) {
+        sec[n] = sin(n*0.001) + 0.1*((n*7919) % 1009);
+    }
+
+    std::size_t ranges[][2] = {
+        {0, 1}, {0, n_data}, {5, 70}, {63, 65}, {64, 128}, {1, n_data-1},
+        {1000, 90000}, {4095, 4097*4}, {n_data-300, n_data}, {12345, 67890}
+    };
+    for (std::size_t n_r=0; n_r<sizeof(ranges)/sizeof(ranges[0]); ++n_r) {
+        std::size_t begin = ranges[n_r][0], end = ranges[n_r][1];
+        double min=0, max=0;
+        sec.GetExtrema(begin, end, min, max);
+        EXPECT_EQ( min, *std::min_element(sec.get().begin()+begin, sec.get().begin()+end) );
+        EXPECT_EQ( max, *std::max_element(sec.get().begin()+begin, sec.get().begin()+end) );
+    }
+
+    // write access has to discard the cached extrema:
+    sec.get_w()[50000] = 1.0e6;
+    double min=0, max=0;
+    sec.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( max, 1.0e6 );
+    sec[60000] = -1.0e6;
+    sec.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( min, -1.0e6 );
+    sec.at(70000) = 2.0e6;
+    sec.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( max, 2.0e6 );
+
+    // reading through a const reference keeps them:
+    const Section& const_sec = sec;
+    EXPECT_EQ( const_sec[70000], 2.0e6 );
+    const_sec.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( min, -1.0e6 );
+
+    EXPECT_THROW( sec.GetExtrema(10, 10, min, max), std::out_of_range );
+    EXPECT_THROW( sec.GetExtrema(0, n_data+1, min, max), std::out_of_range );
+}
+
+TEST(Section_test, mapped_store) {
+
+    // two multiplexed int16 channels behind a 100 byte header:
+    std::size_t n_data = 20000;
+    const char* fname = "section_store_test.dat";
+    std::vector<short> samples(2*n_data);
+    for (std::size_t n=0; n<n_data; ++n) {
+        samples[2*n] = (short)(n % 30011 - 15000);
+        samples[2*n+1] = (short)(n*7);
+    }
+    std::ofstream output_file(fname, std::ios::binary);
+    output_file << std::string(100, ' ');
+    output_file.write((const char*)&samples[0], samples.size()*sizeof(short));
+    output_file.close();
+
+    FileMappingPtr mapping(new FileMapping(fname, 100, samples.size()*sizeof(short)));
+    SectionStorePtr store(new MappedSectionStore(mapping, stfio::int16,
+                                                 0, 2, n_data, 0.5, 1.0));
+    EXPECT_THROW( MappedSectionStore(mapping, stfio::int16, 1, 2, n_data+1),
+                  std::out_of_range );
+    EXPECT_THROW( FileMapping(fname, 100, samples.size()*sizeof(short)+1), std::runtime_error );
+
+    // read through a const reference since write access copies the data into memory:
+    Section stored(store, "Mapped section");
+    const Section& sec = stored;
+    EXPECT_TRUE( sec.IsStored() );
+    EXPECT_EQ( sec.size(), n_data );
+    EXPECT_EQ( sec[123], 0.5*samples[246]+1.0 );
+    EXPECT_THROW( sec.at(n_data), std::out_of_range );
+
+    Vector_double block(100);
+    sec.Read(9000, 100, &block[0]);
+    for (std::size_t n=0; n<block.size(); ++n) {
+        EXPECT_EQ( block[n], 0.5*samples[2*(9000+n)]+1.0 );
+    }
+    EXPECT_THROW( sec.Read(n_data-10, 11, &block[0]), std::out_of_range );
+
+    // the extrema are found without copying the data into memory:
+    double min=0, max=0;
+    sec.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( min, 0.5*-15000+1.0 );
+    EXPECT_EQ( max, 0.5*(n_data-1-15000)+1.0 );
+    EXPECT_TRUE( sec.IsStored() );
+
+    // copies share the store:
+    Section copy(sec);
+    copy[0] = 1.0e6;
+    EXPECT_FALSE( copy.IsStored() );
+    EXPECT_TRUE( sec.IsStored() );
+    EXPECT_EQ( copy[1], sec[1] );
+    EXPECT_EQ( sec[0], 0.5*samples[0]+1.0 );
+    copy.GetExtrema(0, n_data, min, max);
+    EXPECT_EQ( max, 1.0e6 );
+
+    mapping.reset();
+    store.reset();
+    EXPECT_EQ( sec.get()[n_data-1], 0.5*samples[2*(n_data-1)]+1.0 );
+    EXPECT_FALSE( sec.IsStored() );
+    stored[0] = 2.0;
+    EXPECT_EQ( sec[0], 2.0 );
+    std::remove(fname);
+}
+
+TEST(Section_test, storage) {
+
+    std::size_t n_data = 5000;
+    Vector_double data(n_data);
+    for (std::size_t n=0; n<n_data; ++n) {
+        data[n] = 100.0*cos(n*0.01) - 20.0;
+    }
+
+    Section sec(data, "Test section");
+    EXPECT_EQ( sec.GetStorage(), stfio::float64 );
+
+    sec.SetStorage(stfio::float32);
+    EXPECT_EQ( sec.GetStorage(), stfio::float32 );
+    const Section& csec = sec;
+    for (std::size_t n=0; n<n_data; n+=7) {
+        EXPECT_EQ( csec[n], (double)(float)data[n] );
+    }
+
+    // 65535 levels across a range of 200:
+    sec.SetStorage(stfio::int16);
+    EXPECT_EQ( sec.GetStorage(), stfio::int16 );
+    double min=0, max=0;
+    csec.GetExtrema(0, n_data, min, max);
+    EXPECT_NEAR( min, -120.0, 1.0e-2 );
+    EXPECT_NEAR( max, 80.0, 1.0e-2 );
+    Vector_double block(n_data);
+    csec.Read(0, n_data, &block[0]);
+    for (std::size_t n=0; n<n_data; ++n) {
+        EXPECT_NEAR( block[n], data[n], 200.0/65534.0 );
+    }
+
+    // get() converts back to double:
+    EXPECT_NEAR( csec.get()[10], data[10], 200.0/65534.0 );
+    EXPECT_EQ( sec.GetStorage(), stfio::float64 );
+
+    Channel ch(3, 100);
+    ch.SetStorage(stfio::float32);
+    EXPECT_EQ( ch[2].GetStorage(), stfio::float32 );
+    EXPECT_EQ( ch[2].size(), 100 );
+}
+
+TEST(Section_test, affine) {
+    // Large enough to be split into blocks:
+    Vector_double data(300000);
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        data[n] = sin(0.001*n);
+    }
+    Vector_double out(data.size());
+    stfio::vec_affine(&data[0], data.size(), 2.0, -1.5, &out[0]);
+    Vector_double chained = stfio::vec_scal_minus(stfio::vec_scal_mul(data, 2.0), 1.5);
+    // a*x+b may be contracted to a fused multiply-add:
+    for (std::size_t n = 0; n < data.size(); n += 7) {
+        EXPECT_DOUBLE_EQ( out[n], chained[n] );
+    }
+
+    // in place:
+    stfio::vec_affine(data, 2.0, -1.5);
+    ASSERT_EQ( data.size(), out.size() );
+    for (std::size_t n = 0; n < data.size(); n += 7) {
+        EXPECT_DOUBLE_EQ( data[n], out[n] );
+    }
+
+    Vector_double empty;
+    stfio::vec_affine(empty, 2.0, 1.0);
+    EXPECT_TRUE( empty.empty() );
+    EXPECT_TRUE( stfio::vec_scal_div(empty, 2.0).empty() );
+}